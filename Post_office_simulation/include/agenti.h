@@ -0,0 +1,55 @@
+#ifndef AGENTI_H
+#define AGENTI_H
+
+/* * AGENTI.H
+ * Logica degli attori (Erogatore, Operatore, Utente) separata dal loro main()
+ * Così la stessa logica gira in due modi:
+ * 1. Come processo autonomo (bin/erogatore, bin/operatore, bin/utente) -> main() nel file
+ * 2. Come thread dentro il Direttore (--engine=thread) -> i file sono compilati con -DSENZA_MAIN
+ */
+
+#include "common.h"
+#include "traccia.h"
+
+// Risorse e identità di un attore
+// L'identità (tid) sostituisce getpid(): in un processo singolo coincidono,
+// nel motore a thread distingue gli attori che condividono lo stesso PID
+typedef struct {
+    SharedData *shm;
+    int sem_id;
+    int msg_id;
+    Rng rng;                // Flusso casuale privato (FLUSSO_OPERATORE / FLUSSO_UTENTE dell'indice)
+    int indice;             // Posizione dell'attore (operatori: slot statistiche in SHM; utenti: flusso casuale)
+    RingTraccia *traccia;   // Ring della traccia binaria (NULL se disattivata)
+} Agente;
+
+// --- EROGATORE ---
+// Server iterativo dei ticket: ritorna quando la coda viene rimossa (EIDRM)
+void erogatore_esegui(int msg_id);
+
+// --- OPERATORE ---
+// Intero turno dell'operatore: ritorna quando stop_simulation diventa 1
+void operatore_esegui(Agente *a);
+
+// --- UTENTE ---
+// L'utente è una macchina a stati: ogni passo ritorna cosa aspettare prima del successivo
+// Il processo bin/utente dorme fino alla scadenza (dormi_fino), il pool di thread la mette in scheduler
+#define UT_FINE               -1    // Simulazione terminata
+#define UT_ATTENDI_CHIUSURA   -2    // Resta in ufficio finché è aperto
+#define UT_ATTENDI_APERTURA   -3    // Resta a casa finché è chiuso
+
+enum { UT_FASE_AVVIO, UT_FASE_ARRIVO, UT_FASE_IN_UFFICIO, UT_FASE_A_CASA };
+
+typedef struct {
+    Agente ag;
+    int p_serv;             // Probabilità di recarsi in ufficio (P_SERV)
+    int fase;
+} Utente;
+
+// Identità dell'utente indice (ag.shm già impostato): flusso casuale, P_SERV e fase iniziale
+void utente_prepara(Utente *u, int indice);
+
+// Ritorna la scadenza assoluta dell'attesa (ns di CLOCK_MONOTONIC, >= 0) oppure una delle costanti UT_*
+long utente_passo(Utente *u);
+
+#endif
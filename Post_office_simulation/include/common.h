@@ -18,10 +18,16 @@
 #include <sys/sem.h>
 #include <sys/msg.h>
 #include <sys/wait.h>
+#include <sys/prctl.h>
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
 #include <string.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <stdint.h>
 
 // --- CHIAVI IPC ---
 // Scelta progettuale: Chiavi Hardcoded (statiche)
@@ -31,9 +37,34 @@
 #define KEY_SEM 12346
 #define KEY_MSG 12347
 
+// Namespace IPC per esecuzione: il Direttore passa ai figli gli id delle proprie risorse
+// nella variabile d'ambiente POSTA_IPC ("shm:sem:msg"). Con --replications ogni replica crea
+// le sue risorse IPC_PRIVATE (nessuna chiave da cercare, nessuna collisione tra repliche)
+#define ENV_IPC "POSTA_IPC"
+
 // --- COSTANTI DEL SISTEMA ---
-#define NUM_SERVICES 6      // Numero di tipologie di servizio
-#define MAX_SPORTELLI 10    // Numero massimo fisico di sportelli
+// Servizi e sportelli si leggono dal .conf (SERVICE=..., NOF_COUNTERS) e dimensionano
+// la SHM all'avvio: qui ci sono solo i tetti
+#define MAX_SERVIZI 32      // Competenze e servizi attivi sono bitmask a 32 bit
+#define MAX_SPORTELLI 64    // Numero massimo fisico di sportelli
+#define MAX_OPERATORI 256   // Numero massimo di operatori (uno slot statistiche ciascuno)
+#if MAX_SPORTELLI > 64 || MAX_OPERATORI % 64
+#error "Sportelli liberi e operatori in attesa sono bitmask in parole da 64 bit"
+#endif
+#define LUNGHEZZA_NOME 24   // Nome di un servizio, terminatore compreso
+
+// Dati scritti da attori diversi stanno su linee di cache diverse: senza padding
+// ogni incremento di un operatore invaliderebbe la linea a tutti gli altri (false sharing)
+#define LINEA_CACHE 64
+#define ALLINEATO __attribute__((aligned(LINEA_CACHE)))
+
+// --- DURATA DELLA GIORNATA ---
+// Giornata lavorativa e periodo di grazia dopo la chiusura sono in minuti simulati
+// (DAY_MINUTES, CLOSE_MINUTES): in ns reali scalano con NANO_SECS come servizi e pause
+// Il periodo di grazia è solo un tetto: la giornata si chiude appena l'ultimo operatore
+// ha finito il servizio in corso (operatori_in_turno)
+#define MINUTI_GIORNATA_DEFAULT 480     // 8 ore di apertura
+#define MINUTI_CHIUSURA_DEFAULT 120
 
 // --- LAYOUT SEMAFORI ---
 // Ho scelto di usare un UNICO array di semafori per gestire tutte le sincronizzazioni
@@ -42,14 +73,67 @@
 #define SEM_START 1         // Indice 1: Barriera (Rendezvous) per lo start sincronizzato
 #define SEM_QUEUE_BASE 2    // Indice 2+: Semafori contatori per le code dei servizi (Produttore/Consumatore)
 
-// Macro utile per calcolare quanti semafori chiedere al sistema nel main
-#define TOTAL_SEMS (SEM_QUEUE_BASE + NUM_SERVICES)
+// Semafori da chiedere al sistema nel main: uno per coda, quindi dipende dalla Config
+#define TOTAL_SEMS(cfg) (SEM_QUEUE_BASE + (cfg)->num_servizi)
+
+// --- VIE DI EROGAZIONE DEI TICKET ---
+// TICKET_SHM: contatore atomico in SHM, nessuna system call (default)
+// TICKET_MSG: server Erogatore su Message Queue (modalità di compatibilità, --tickets=msg)
+#define TICKET_SHM 0
+#define TICKET_MSG 1
+#define NUM_VIE_TICKET 2
+
+// --- POLITICHE DI FURTO (operatori multi-competenza) ---
+// Un operatore con la coda del proprio sportello vuota può servire un'altra coda
+// tra quelle delle sue competenze (--steal da riga di comando, STEAL_POLICY nel .conf)
+#define FURTO_NESSUNO 0     // Serve solo il servizio dello sportello (modello originale)
+#define FURTO_PIU_LUNGA 1   // Ruba dalla coda compatibile più lunga
+#define FURTO_CASUALE 2     // Ruba da una coda compatibile non vuota a caso
+
+// Politiche di apertura mattutina degli sportelli (ALLOC_POLICY nel .conf, --alloc da riga di comando)
+#define ALLOC_CASUALE 0     // Ogni sportello aperto al 70% con un servizio a caso (modello originale)
+#define ALLOC_CARICO 1      // Sportelli ai servizi con più domanda attesa (vedi sportelli.c)
+
+// --- MODELLI DI ARRIVO (ARRIVALS nel .conf, --arrivals da riga di comando) ---
+// Con gli agenti ogni utente è un processo (o un task del pool) con il suo P_SERV fisso:
+// gli arrivi sono limitati dal numero di attori. Gli altri modelli li genera il Direttore
+// su una popolazione di NOF_USERS utenti in memoria privata (popolazione.c), senza attori
+#define ARRIVI_AGENTI 0     // Un attore per utente, P_SERV fisso (modello originale)
+#define ARRIVI_PSERV 1      // Stessa regola P_SERV sulla popolazione del Direttore
+#define ARRIVI_POISSON 2    // Sistema aperto: Poisson di intensità ARRIVAL_RATE al minuto
+#define ARRIVI_FASCE 3      // Poisson non omogeneo: ARRIVAL_RATE x peso della fascia (ARRIVAL_PROFILE)
+#define MAX_FASCE 48        // Fasce della giornata in ARRIVAL_PROFILE
+#define MINUTI_ARRIVO 30    // Modello P_SERV: arrivo entro i primi 30 minuti dall'apertura
+
+// Statistiche degli operatori scaricate in SHM a lotti (STATS_BATCH nel .conf, --stats-batch)
+#define LOTTO_DEFAULT 32    // Clienti per lotto (1 = pubblicazione a ogni cliente)
+#define LOTTO_MAX 256       // Campioni di latenza che un operatore tiene in sospeso
+
+// Capienza di ogni coda ticket in SHM (potenza di 2: l'indice si calcola con una AND)
+#define CAPIENZA_CODA 4096
+
+// --- ISTOGRAMMI DI LATENZA (stile HDR) ---
+// Bucket logaritmici: ogni potenza di 2 è divisa in 2^ISTO_SUB_BITS sotto-bucket lineari,
+// quindi l'errore relativo di un percentile è al più 1/16 (6.25%) su tutta la scala
+// Oltre 2^ISTO_MAX_BITS ns (circa 78 ore) i valori finiscono nell'ultimo bucket
+#define ISTO_SUB_BITS 4
+#define ISTO_SUB (1 << ISTO_SUB_BITS)
+#define ISTO_MAX_BITS 48
+#define ISTO_BUCKET ((ISTO_MAX_BITS - ISTO_SUB_BITS + 1) * ISTO_SUB)
+
+// Un servizio dell'ufficio: nome e durata media in minuti simulati
+typedef struct {
+    char nome[LUNGHEZZA_NOME];
+    int minuti;
+} Servizio;
 
-// Dati statici per la logica di simulazione
+// Servizi dell'ufficio originale, usati se il .conf non ne dichiara (nessuna riga SERVICE=)
 // (Static const permette di includerli in ogni file senza errori di link)
-static const int SERVICE_TIMES_MINUTES[] = {10, 8, 6, 8, 20, 20};
-static const char *SERVICE_NAMES[] = {
-    "Spedizioni", "Posta", "Bancoposta", "Bollettini", "Prodotti Fin.", "Orologi"
+#define NUM_SERVIZI_DEFAULT 6
+#define NUM_SPORTELLI_DEFAULT 10
+static const Servizio SERVIZI_DEFAULT[NUM_SERVIZI_DEFAULT] = {
+    {"Spedizioni", 10}, {"Posta", 8}, {"Bancoposta", 6},
+    {"Bollettini", 8}, {"Prodotti Fin.", 20}, {"Orologi", 20}
 };
 
 // Struttura Configuration:
@@ -63,39 +147,249 @@ typedef struct {
     int nof_pause;          
     int p_serv_min;         
     int p_serv_max;
+    int modalita_ticket;    // TICKET_SHM o TICKET_MSG (da riga di comando)
+    int nof_skills;         // Servizi che ogni operatore sa erogare (1 = mono-competenza)
+    int politica_furto;     // FURTO_* (STEAL_POLICY / --steal)
+    int politica_sportelli; // ALLOC_* (ALLOC_POLICY / --alloc)
+    int lotto_statistiche;  // Clienti per scarico delle statistiche operatore (STATS_BATCH / --stats-batch)
+    int traccia;            // 1 se il Direttore registra la traccia binaria (--trace)
+    unsigned long seme;     // SEED: seme master da cui derivano i flussi casuali di tutti gli attori
+    int num_servizi;        // Righe SERVICE=Nome,minuti (default: i 6 servizi originali)
+    int num_sportelli;      // NOF_COUNTERS
+    int minuti_giornata;    // DAY_MINUTES: durata dell'apertura
+    int minuti_chiusura;    // CLOSE_MINUTES: dopo la chiusura si smaltisce la coda al più per tanto
+    int arrivi;             // ARRIVI_* (ARRIVALS / --arrivals)
+    double tasso_arrivi;    // ARRIVAL_RATE: arrivi per minuto simulato (Poisson e fasce)
+    int num_fasce;          // ARRIVAL_PROFILE=p1,p2,...: la giornata divisa in fasce uguali
+    float fasce[MAX_FASCE]; // Peso di ogni fascia (moltiplica ARRIVAL_RATE)
+    Servizio servizi[MAX_SERVIZI];
 } Config;
 
+// Durate in ns reali della giornata e del periodo di grazia
+static inline long giornata_ns(const Config *cfg) {
+    return (long)cfg->minuti_giornata * cfg->nano_secs_per_min;
+}
+
+static inline long grazia_ns(const Config *cfg) {
+    return (long)cfg->minuti_chiusura * cfg->nano_secs_per_min;
+}
+
+// Utenti che sono attori (processi o task del pool): nessuno se gli arrivi li genera il Direttore
+static inline int utenti_agenti(const Config *cfg) {
+    return cfg->arrivi == ARRIVI_AGENTI ? cfg->nof_users : 0;
+}
+
+// Intensità degli arrivi (al minuto) al minuto m della giornata, modelli Poisson e fasce
+static inline double intensita_arrivi(const Config *cfg, double m) {
+    if (cfg->arrivi != ARRIVI_FASCE || cfg->num_fasce < 1) return cfg->tasso_arrivi;
+    int f = (int)(m * cfg->num_fasce / cfg->minuti_giornata);
+    return cfg->tasso_arrivi * cfg->fasce[f < cfg->num_fasce ? f : cfg->num_fasce - 1];
+}
+
+// Arrivi attesi in una giornata (stima a priori della politica a carico degli sportelli)
+static inline double arrivi_attesi(const Config *cfg) {
+    if (cfg->arrivi == ARRIVI_AGENTI || cfg->arrivi == ARRIVI_PSERV)
+        return cfg->nof_users * (cfg->p_serv_min + cfg->p_serv_max) / 200.0;
+    if (cfg->arrivi == ARRIVI_POISSON || cfg->num_fasce < 1) return cfg->tasso_arrivi * cfg->minuti_giornata;
+    double pesi = 0; // Fasce di durata uguale: conta il peso medio
+    for (int f = 0; f < cfg->num_fasce; f++) pesi += cfg->fasce[f];
+    return cfg->tasso_arrivi * cfg->minuti_giornata * pesi / cfg->num_fasce;
+}
+
 // Struttura Statistiche:
 // Raccoglie i dati richiesti. È duplicata in SHM: una istanza per il giorno corrente, una per i totali
+// Tutti contatori a 64 bit: su simulazioni lunghe i cumulativi supererebbero INT_MAX
 typedef struct {
-    int utenti_serviti;
-    int servizi_erogati[NUM_SERVICES];
-    int servizi_non_erogati; 
+    long utenti_serviti;
+    long servizi_erogati[MAX_SERVIZI];
+    long servizi_non_erogati; 
     long tempo_attesa_totale;   
     long tempo_servizio_totale; 
-    int pause_effettuate;
-    int operatori_attivi;
+    long pause_effettuate;
+    long operatori_attivi;
 } Stats;
 
-// --- MEMORIA CONDIVISA (SHM) ---
-// Struttura Monolitica: Raggruppa TUTTO lo stato del sistema
-// Vantaggio: Con un solo shmid ho accesso a flag, code, sportelli e statistiche
+// Precisione delle attese a scadenza assoluta (dormi_fino): quante, quanto si è chiesto
+// di dormire e quanto dopo la scadenza ci si è svegliati (totale e massimo)
+// Se il ritardo è una frazione grande di un minuto simulato, NANO_SECS è troppo piccolo
 typedef struct {
+    long attese;
+    long ns_richiesti;
+    long ns_ritardo;
+    long ritardo_max;
+} Deriva;
+
+// Slot statistiche di un operatore: l'operatore è l'UNICO scrittore, il Direttore legge
+// I contatori sono cumulativi (mai azzerati): il Direttore ricava il giorno per differenza,
+// così nessuno scrive nello slot altrui e non serve alcun mutex
+// Allineato alla linea di cache: slot vicini non si contendono la stessa linea
+typedef struct ALLINEATO {
+    unsigned int seq;       // Seqlock: dispari = aggiornamento in corso
+    Stats stats;
+    unsigned int competenze;    // Bitmask dei servizi che sa erogare (scritta all'avvio)
+    long ns_servizio;           // Tempo passato a servire clienti
+    long ns_al_posto;           // Tempo passato seduto allo sportello (utilizzo = servizio / al posto)
+    long rubati;                // Clienti serviti da code diverse da quella dello sportello
+    long scarichi;              // Lotti pubblicati (sezioni seqlock scritte)
+    long in_lotto;              // Serviti nel lotto non ancora scaricato (solo per le metriche live)
+    long in_lotto_servizio[MAX_SERVIZI];    // ... per servizio; azzerati dallo scarico
+    Deriva deriva;              // Servizi e pause dormiti a scadenza assoluta
+    int posto;                  // Parola futex dell'attesa di uno sportello: POSTO_* oppure
+                                // sportello consegnato da un collega + 1 (vedi operatore.c)
+} SlotOperatore;
+
+#define POSTO_NESSUNO 0         // Non aspetto uno sportello
+#define POSTO_IN_ATTESA -1      // Iscritto tra gli operatori in attesa, dormo sul futex
+
+// Istogramma di latenze in ns: conteggio per bucket più il massimo esatto
+typedef struct {
+    long conteggio[ISTO_BUCKET];
+    long max;
+} Istogramma;
+
+// Contatori di contesa sulla sincronizzazione (per misurare i colli di bottiglia)
+typedef struct ALLINEATO {
+    long mutex_acquisizioni;    // P su SEM_MUTEX
+    long mutex_contese;         // ... di cui trovate già occupate
+    long cas_falliti;           // Sportelli persi contro un collega arrivato prima
+    long seqlock_ritentativi;   // Letture dello snapshot ripetute dal Direttore
+    long attese_posto;          // Volte in cui un operatore ha dormito in attesa di uno sportello
+    long consegne_posto;        // Sportelli passati direttamente da chi si alza a chi aspetta
+    long operazioni_ipc;        // semop/msgsnd/msgrcv dei wrapper qui sotto, tentativi falliti compresi
+} Contesa;
+
+// Metriche live: fotografia dell'ufficio pubblicata dal Direttore a ogni tick
+// Un solo scrittore (il Direttore) e seqlock: bin/monitor legge da un attach in sola lettura,
+// senza lock e senza scrivere nulla, quindi non può alterare i tempi della simulazione
+typedef struct {
+    unsigned long versione;             // Numero progressivo dello snapshot
+    long t_ns;                          // Istante di pubblicazione (CLOCK_MONOTONIC)
+    int giorno;
+    int ufficio_aperto;
+    int fine;                           // 1: simulazione terminata, ultimo snapshot
+    int nof_workers, nof_users, sim_duration;
+    int num_servizi, num_sportelli;     // Elementi validi degli array qui sotto
+    int code[MAX_SERVIZI];              // in_attesa (in coda o allo sportello)
+    int sportelli_mapping[MAX_SPORTELLI];
+    int sportelli_occupati[MAX_SPORTELLI];  // 1 se c'è un operatore seduto
+    long serviti;                       // Cumulativi dall'inizio della simulazione
+    long serviti_servizio[MAX_SERVIZI];
+    long non_erogati;                   // Dei giorni già chiusi (residui + respinti)
+    long respinti;                      // Coda piena, cumulativo (anche del giorno in corso)
+    long ticket;                        // Ticket emessi (tutte le vie)
+    double serviti_al_secondo;          // Throughput misurato sull'ultimo tick
+} SnapshotLive;
+
+typedef struct {
+    unsigned int seq;                   // Seqlock: dispari = pubblicazione in corso
+    SnapshotLive s;
+} MetricheLive;
+
+// Coda dei ticket di un servizio: ring buffer MPMC lock-free (schema di Vyukov)
+// Ogni slot ha un numero di sequenza che dice a produttori e consumatori se è
+// libero (seq == pos) o pubblicato (seq == pos + 1): niente mutex, solo CAS sugli indici
+// Insieme al ticket viaggia l'istante di accodamento: l'operatore misura l'attesa vera
+typedef struct {
+    unsigned int seq;
+    int ticket;
+    long t_ingresso;        // CLOCK_MONOTONIC in ns (orologio comune a tutti i processi)
+} SlotTicket;
+
+// Indici su linee separate: utenti e operatori non si rubano la linea a ogni CAS
+typedef struct {
+    unsigned int coda ALLINEATO;        // Prossima posizione da scrivere (Utenti)
+    unsigned int testa ALLINEATO;       // Prossima posizione da leggere (Operatori)
+    SlotTicket slot[CAPIENZA_CODA] ALLINEATO;
+} CodaTicket;
+
+// Dati di un servizio in SHM (uno per servizio del .conf, nella coda del segmento)
+typedef struct {
+    // Coda "virtuale": quanta gente c'è (per le statistiche, l'explode e il furto)
+    // La sincronizzazione reale avviene su semafori e CodaTicket, questo è un dato di appoggio
+    int in_attesa ALLINEATO;
+    CodaTicket coda;                    // Ticket in attesa, qualunque sia la via di emissione
+    // Sportelli del servizio aperti e liberi (bit i = sportello i) e operatori che sanno
+    // erogarlo e aspettano un posto (bit j = operatore j): trovare un posto è un ctz, non una scansione
+    unsigned long sportelli_liberi ALLINEATO;
+    unsigned long operatori_in_attesa[MAX_OPERATORI / 64];
+    // Latenze: cumulative (scritte dagli operatori con incrementi atomici) e del giorno,
+    // ricavate dal Direttore per differenza a fine giornata
+    Istogramma attesa ALLINEATO;
+    Istogramma servizio;
+    Istogramma attesa_giorno ALLINEATO;
+    Istogramma servizio_giorno;
+} ServizioCondiviso;
+
+// Uno sportello: una linea di cache ciascuno, le CAS su sportelli vicini non si disturbano
+typedef struct ALLINEATO {
+    int servizio;           // ID servizio offerto oggi (-1 se chiuso)
+    int occupato;           // PID dell'operatore seduto (0 se libero)
+    long libero_da;         // Istante in cui si è liberato (ns, 0 = dall'apertura)
+    long ns_libero;         // Tempo passato aperto ma vuoto oggi
+} Sportello;
+
+// --- MEMORIA CONDIVISA (SHM) ---
+// Un solo segmento con TUTTO lo stato del sistema: con un solo shmid ho accesso
+// a flag, code, sportelli e statistiche. La dimensione si decide all'avvio:
+// [SharedData][num_servizi x ServizioCondiviso][num_sportelli x Sportello]
+// e le due parti variabili si raggiungono con shm_servizio() e shm_sportello()
+typedef struct ALLINEATO {
     int ufficio_aperto;                 // Flag di Stato: 1=Aperto, 0=Chiuso
     int stop_simulation;                // Flag di Terminazione Globale
+
+    // Contatore di generazione (parola futex): il Direttore lo incrementa a ogni cambio
+    // di ufficio_aperto / stop_simulation e sveglia chi ci dorme sopra
+    unsigned int generazione_stato;
+
+    // Posizione delle parti variabili (offset in byte dall'inizio del segmento)
+    size_t off_servizi, off_sportelli;
+
+    // Barriera di prontezza (parola futex): ogni processo figlio la incrementa dopo
+    // l'attach alle risorse IPC; il Direttore apre SEM_START solo quando vale
+    // NOF_WORKERS + NOF_USERS, invece di dormire un secondo "sperando"
+    unsigned int processi_pronti ALLINEATO;
+    unsigned int attori;                // Figli attesi alla barriera (con --scenarios: i massimi)
+
+    // Scenari in serie (--scenarios): generazione dello scenario in corso (parola futex),
+    // attori fermi alla fine dello scenario e se dopo stop_simulation ne segue un altro
+    unsigned int scenario;
+    unsigned int attori_fermi;
+    int altri_scenari;
+
+    // Operatori nel turno di oggi (parola futex): entrano all'apertura ed escono dopo
+    // l'ultimo servizio; a ufficio chiuso il Direttore chiude la giornata quando torna a 0
+    unsigned int operatori_in_turno;
+
+    // Bitmask dei servizi offerti oggi (bit i = almeno uno sportello per il servizio i)
+    // Scritta dal Direttore a ufficio chiuso: gli utenti la leggono senza lock
+    unsigned int servizi_attivi ALLINEATO;
+    int sportelli_aperti;               // Sportelli aperti oggi
+    long sportelli_giorni;              // Somma degli sportelli aperti su tutti i giorni
+    long apertura_ns, chiusura_ns;      // Orari di oggi (chiusura < apertura: ufficio aperto)
+    long ns_liberi_totale;              // Tempo sportelli aperti ma vuoti, su tutti i giorni
+    long ns_aperti_totale;              // Tempo sportelli aperti (sportelli x durata della giornata)
+    int giorno_ripresa;                 // Giorno del checkpoint da cui si è ripartiti (0 = dal giorno 1)
     
-    // Code "Virtuali": contatori per sapere quanta gente c'è (per le statistiche e l'explode)
-    // La sincronizzazione reale avviene sui semafori, questi sono dati di appoggio
-    int utenti_in_attesa[NUM_SERVICES]; 
-    
-    // Mapping Sportelli:
-    // mapping: ID servizio offerto dallo sportello i-esimo (-1 se chiuso)
-    // occupati: PID dell'operatore seduto (0 se libero)
-    int sportelli_mapping[MAX_SPORTELLI]; 
-    int sportelli_occupati[MAX_SPORTELLI]; 
-    
-    Stats stats_giornaliere;            // Reset a inizio giornata
+    Stats stats_giornaliere ALLINEATO;  // Calcolate dal Direttore a fine giornata
     Stats stats_totali;                 // Accumulatore persistente
+
+    // Contributi degli operatori (cumulativi, protetti da seqlock)
+    SlotOperatore slot_operatori[MAX_OPERATORI];
+    long utenti_respinti ALLINEATO;     // Utenti rinunciatari per coda piena (cumulativo, atomico)
+    Contesa contesa;
+
+    // Distributore di ticket: il contatore serve la via TICKET_SHM
+    unsigned int prossimo_ticket ALLINEATO;
+
+    // Throughput per via di erogazione: ticket emessi e ns spesi dagli utenti per ottenerli
+    long ticket_emessi[NUM_VIE_TICKET] ALLINEATO;
+    long ticket_ns[NUM_VIE_TICKET];
+
+    // Precisione delle attese: utenti (atomica, una registrazione per arrivo) e Direttore
+    Deriva deriva_utenti ALLINEATO;
+    Deriva deriva_direttore;
+
+    MetricheLive live ALLINEATO;        // Snapshot per bin/monitor (scrive solo il Direttore)
     
     Config cfg;                         // Configurazione in sola lettura per i figli
 } SharedData;
@@ -109,27 +403,607 @@ typedef struct {
     int numero_ticket;      // Risposta
 } MsgTicket;
 
+// --- HELPER LAYOUT SHM ---
+// sizeof di SharedData, ServizioCondiviso e Sportello è multiplo di LINEA_CACHE (sono
+// allineati): le parti variabili, una dopo l'altra, restano allineate senza calcoli
+
+static inline size_t shm_dimensione(const Config *cfg) {
+    return sizeof(SharedData) + (size_t)cfg->num_servizi * sizeof(ServizioCondiviso)
+                              + (size_t)cfg->num_sportelli * sizeof(Sportello);
+}
+
+// Direttore, sul segmento appena azzerato: registra dove stanno le parti variabili
+static inline void shm_layout(SharedData *shm, const Config *cfg) {
+    shm->off_servizi = sizeof(SharedData);
+    shm->off_sportelli = shm->off_servizi + (size_t)cfg->num_servizi * sizeof(ServizioCondiviso);
+}
+
+static inline ServizioCondiviso *shm_servizio(const SharedData *shm, int s) {
+    return (ServizioCondiviso *)((char *)shm + shm->off_servizi) + s;
+}
+
+static inline Sportello *shm_sportello(const SharedData *shm, int i) {
+    return (Sportello *)((char *)shm + shm->off_sportelli) + i;
+}
+
+// --- HELPER NAMESPACE IPC ---
+// Figli: id delle risorse del Direttore che li ha lanciati (ENV_IPC), oppure le chiavi
+// fisse se la variabile manca (figlio lanciato a mano). Ritorna -1 se la SHM non c'è
+static inline int ipc_ids(int *shm_id, int *sem_id, int *msg_id) {
+    const char *env = getenv(ENV_IPC);
+    if (env && sscanf(env, "%d:%d:%d", shm_id, sem_id, msg_id) == 3) return 0;
+    *shm_id = shmget(KEY_SHM, 0, 0666);
+    *sem_id = semget(KEY_SEM, 0, 0666);
+    *msg_id = msgget(KEY_MSG, 0666);
+    return *shm_id < 0 ? -1 : 0;
+}
+
+// Orologio comune (CLOCK_MONOTONIC, ns): latenze, scadenze, profilo IPC
+static inline long adesso_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+// --- PROFILO IPC (build strumentata: make profilo, cioè -DPROFILO_IPC) ---
+// Ogni wrapper IPC qui sotto riceve il proprio sito di chiamata (file:riga del chiamante,
+// SITO_IPC) e nella build strumentata registra chiamate, fallimenti, tempo e istogramma
+// log2 dell'attesa nella sezione del proprio attore, in un segmento SHM dedicato.
+// Il Direttore somma le sezioni e stampa il report alla fine (profilo.c)
+// Nella build normale SITO_IPC è NULL e il wrapper fa la sola chiamata di sistema
+#define ENV_PROFILO "POSTA_PROFILO"
+#define PROFILO_SITI 16         // Siti per sezione (oltre: contati in fuori_tabella)
+#define PROFILO_BUCKET 40       // Bucket k = attese in [2^k, 2^(k+1)) ns, l'ultimo prende il resto
+#define SEZIONI_UTENTI 16       // Sezioni condivise dagli utenti (come RING_UTENTI della traccia)
+
+enum { PR_P, PR_V, PR_TENTATIVO, PR_LOCK, PR_MSGSND, PR_MSGRCV, PR_POLLING, NUM_PR };   // Operazione
+enum { PRR_MUTEX, PRR_START, PRR_CODE, PRR_MSG, PRR_POLLING, NUM_PRR };                // Risorsa
+enum { PR_DIRETTORE, PR_EROGATORE, PR_OPERATORE, PR_UTENTE, NUM_RUOLI };               // Attore
+
+#define PRR_SEMAFORO(index) ((index) == SEM_MUTEX ? PRR_MUTEX : (index) == SEM_START ? PRR_START : PRR_CODE)
+
+// Sito di chiamata: statico nel chiamante, chiave (file, riga) calcolata alla prima chiamata
+typedef struct {
+    const char *file;
+    int riga;
+    long chiave;
+} SitoIpc;
+
+// Contatori di un sito in una sezione. Gli utenti condividono le sezioni: aggiornamenti atomici
+typedef struct {
+    long chiave;                // 0 = posto libero; stessa chiave in ogni eseguibile
+    char file[20];              // Nome del sorgente (senza cartella)
+    int riga;
+    int tipo;                   // PR_*
+    int risorsa;                // PRR_*
+    long chiamate;
+    long fallite;               // Esito -1 (EAGAIN di un tentativo, mutex trovato conteso)
+    long ns_totali, ns_max;
+    long isto[PROFILO_BUCKET];
+} SitoProfilo;
+
+typedef struct ALLINEATO {
+    int ruolo;                  // PR_DIRETTORE...
+    long fuori_tabella;
+    SitoProfilo siti[PROFILO_SITI];
+} SezioneProfilo;
+
+// Segmento del profilo: [0] Direttore, [1] Erogatore, poi operatori, poi SEZIONI_UTENTI
+typedef struct {
+    int n_sezioni, n_operatori;
+    SezioneProfilo sezioni[];
+} Profilo;
+
+#ifdef PROFILO_IPC
+#define SITO_IPC ({ static SitoIpc sito_ = {__FILE__, __LINE__, 0}; &sito_; })
+
+// profilo.c: sezione dell'attore che gira su questo thread (NULL = non si registra)
+extern __thread SezioneProfilo *profilo_sezione;
+void profilo_attach(void);                  // Figli: segmento dall'ambiente (ENV_PROFILO)
+void profilo_usa(int ruolo, int indice);    // Da qui le chiamate di questo thread vanno all'attore
+
+// Posto del sito nella sezione: cerco la sua chiave, o ne prenoto uno libero con una CAS
+static inline SitoProfilo *profilo_posto(SezioneProfilo *z, SitoIpc *sito, int tipo, int risorsa) {
+    if (!sito->chiave) {
+        unsigned long h = 5381;
+        for (const char *c = sito->file; *c; c++) h = h * 33 + (unsigned char)*c;
+        sito->chiave = (long)((h << 16 | (unsigned int)sito->riga) & LONG_MAX) | 1;
+    }
+    for (int k = 0; k < PROFILO_SITI; k++) {
+        SitoProfilo *p = &z->siti[(sito->chiave + k) % PROFILO_SITI];
+        long c = __atomic_load_n(&p->chiave, __ATOMIC_ACQUIRE);
+        if (!c && __atomic_compare_exchange_n(&p->chiave, &c, sito->chiave, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            // Chi ha prenotato scrive la descrizione (letta dal Direttore a simulazione ferma)
+            const char *nome = strrchr(sito->file, '/');
+            snprintf(p->file, sizeof(p->file), "%s", nome ? nome + 1 : sito->file);
+            p->riga = sito->riga;
+            p->tipo = tipo;
+            p->risorsa = risorsa;
+            return p;
+        }
+        if (c == sito->chiave) return p;
+    }
+    return NULL;
+}
+
+static inline void profilo_registra(SitoIpc *sito, int tipo, int risorsa, long ns, int fallita) {
+    SezioneProfilo *z = profilo_sezione;
+    if (!z || !sito) return;
+    SitoProfilo *p = profilo_posto(z, sito, tipo, risorsa);
+    if (!p) { __atomic_fetch_add(&z->fuori_tabella, 1, __ATOMIC_RELAXED); return; }
+    __atomic_fetch_add(&p->chiamate, 1, __ATOMIC_RELAXED);
+    if (fallita) __atomic_fetch_add(&p->fallite, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->ns_totali, ns, __ATOMIC_RELAXED);
+    long max = __atomic_load_n(&p->ns_max, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&p->ns_max, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    int k = ns > 0 ? 63 - __builtin_clzl((unsigned long)ns) : 0;
+    __atomic_fetch_add(&p->isto[k < PROFILO_BUCKET ? k : PROFILO_BUCKET - 1], 1, __ATOMIC_RELAXED);
+}
+
+// Chiamata IPC misurata: preserva errno (lo leggono i chiamanti dei tentativi)
+#define PROFILA(sito, tipo, risorsa, chiamata) ({                                   \
+    long t0_ = adesso_ns();                                                         \
+    long r_ = (chiamata);                                                           \
+    int errno_ = errno;                                                             \
+    profilo_registra(sito, tipo, risorsa, adesso_ns() - t0_, r_ < 0);               \
+    errno = errno_;                                                                 \
+    r_; })
+#else
+#define SITO_IPC NULL
+#define PROFILA(sito, tipo, risorsa, chiamata) ((void)(sito), (chiamata))
+#define profilo_attach() ((void)0)
+#define profilo_usa(ruolo, indice) ((void)0)
+#endif
+
+// --- CONTEGGIO DELLE OPERAZIONI IPC ---
+// Ogni chiamata dei wrapper qui sotto (anche una sem_nowait a coda vuota: è una syscall
+// come le altre) incrementa contesa.operazioni_ipc, il numero che make bench divide per il tempo
+// ipc_contatore è definito in profilo.c (linkato da tutti gli attori) e punta al contatore
+// dopo l'attach alla SHM; NULL, ad esempio nei microbenchmark, vuol dire non contare
+extern long *ipc_contatore;
+
+static inline void conta_ipc(void) {
+    long *c = ipc_contatore;
+    if (c) __atomic_fetch_add(c, 1, __ATOMIC_RELAXED);
+}
+
 // --- HELPER FUNCTIONS SEMAFORI ---
 // Definite 'static inline' per efficienza (evitano overhead chiamata funzione)
 // e per includerle nell'header senza creare conflitti di simboli multipli
+// Le macro sem_op, sem_nowait, P, V passano il sito di chiamata (profilo IPC)
 
 // Wrapper per semop BLOCCANTE (Standard P/V)
 // Ritorna int per permettere il controllo errori
-static inline int sem_op(int semid, int index, int op) {
+static inline int sem_op_sito(SitoIpc *sito, int semid, int index, int op) {
     struct sembuf s = {index, op, 0};
-    return semop(semid, &s, 1);
+    conta_ipc();
+    return PROFILA(sito, op < 0 ? PR_P : PR_V, PRR_SEMAFORO(index), semop(semid, &s, 1));
 }
 
 // Wrapper per semop NON BLOCCANTE (IPC_NOWAIT)
 // Cruciale per l'operatore: permette di controllare la coda senza bloccarsi se vuota
 // Ritorna -1 con errno=EAGAIN se la risorsa non è disponibile
-static inline int sem_nowait(int semid, int index, int op) {
+static inline int sem_nowait_sito(SitoIpc *sito, int semid, int index, int op) {
     struct sembuf s = {index, op, IPC_NOWAIT};
-    return semop(semid, &s, 1);
+    conta_ipc();
+    return PROFILA(sito, PR_TENTATIVO, PRR_SEMAFORO(index), semop(semid, &s, 1));
 }
 
+#define sem_op(id, idx, op) sem_op_sito(SITO_IPC, id, idx, op)
+#define sem_nowait(id, idx, op) sem_nowait_sito(SITO_IPC, id, idx, op)
+
 // Macro per leggibilità (P=Wait/Down, V=Signal/Up)
 #define P(id, idx) sem_op(id, idx, -1)
 #define V(id, idx) sem_op(id, idx, 1)
 
+// --- HELPER CODA DI MESSAGGI ---
+// msgsnd/msgrcv dei ticket (--tickets=msg), con il sito di chiamata per il profilo IPC
+static inline int msg_invia_sito(SitoIpc *sito, int msg_id, const void *m, size_t n, int flag) {
+    conta_ipc();
+    return PROFILA(sito, PR_MSGSND, PRR_MSG, msgsnd(msg_id, m, n, flag));
+}
+
+static inline ssize_t msg_ricevi_sito(SitoIpc *sito, int msg_id, void *m, size_t n, long tipo, int flag) {
+    conta_ipc();
+    return PROFILA(sito, PR_MSGRCV, PRR_MSG, msgrcv(msg_id, m, n, tipo, flag));
+}
+
+#define msg_invia(id, m, n, flag) msg_invia_sito(SITO_IPC, id, m, n, flag)
+#define msg_ricevi(id, m, n, tipo, flag) msg_ricevi_sito(SITO_IPC, id, m, n, tipo, flag)
+
+// Attesa di polling (coda vuota): nel profilo conta come tempo bloccato, non come lavoro
+static inline void polling_sito(SitoIpc *sito, useconds_t us) {
+    (void)PROFILA(sito, PR_POLLING, PRR_POLLING, usleep(us));
+}
+
+#define attendi_polling(us) polling_sito(SITO_IPC, us)
+
+// Sleep dell'operatore seduto a coda vuota (operatore.c): a ogni risveglio tira anche la pausa,
+// quindi il DES ne riproduce il ritmo con EV_POLLING (in minuti simulati tramite NANO_SECS)
+#define POLLING_OPERATORE_US 1000
+
+// --- HELPER STATO UFFICIO (futex) ---
+// Sostituiscono i loop di polling (usleep/sleep) su ufficio_aperto:
+// chi aspetta dorme nel kernel finché il Direttore non pubblica un nuovo stato
+// Uso FUTEX_WAIT/FUTEX_WAKE "condivisi" (non _PRIVATE) perché la parola sta in SHM
+
+static inline long futex(unsigned int *uaddr, int op, unsigned int val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+// FUTEX_WAIT con timeout relativo (NULL = senza limite)
+static inline long futex_attendi(unsigned int *uaddr, unsigned int val, const struct timespec *timeout) {
+    return syscall(SYS_futex, uaddr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+// Figlio: attach completato. Solo l'ultimo sveglia il Direttore (una system call in tutto)
+static inline void segnala_pronto(SharedData *shm) {
+    unsigned int attesi = shm->attori;
+    if (__atomic_add_fetch(&shm->processi_pronti, 1, __ATOMIC_RELEASE) == attesi)
+        futex(&shm->processi_pronti, FUTEX_WAKE, INT_MAX);
+}
+
+// Direttore: da chiamare DOPO aver modificato ufficio_aperto o stop_simulation
+static inline void stato_pubblica(SharedData *shm) {
+    __atomic_add_fetch(&shm->generazione_stato, 1, __ATOMIC_RELEASE);
+    futex(&shm->generazione_stato, FUTEX_WAKE, INT_MAX);
+}
+
+// Attende che ufficio_aperto valga "aperto" (o che la simulazione finisca)
+// Prevenzione Lost Wakeup: leggo la generazione PRIMA di controllare lo stato;
+// se il Direttore la cambia nel frattempo, FUTEX_WAIT ritorna subito (EAGAIN)
+static inline void attendi_stato(SharedData *shm, int aperto) {
+    for (;;) {
+        unsigned int gen = __atomic_load_n(&shm->generazione_stato, __ATOMIC_ACQUIRE);
+        if (shm->stop_simulation || shm->ufficio_aperto == aperto) return;
+        futex(&shm->generazione_stato, FUTEX_WAIT, gen);
+    }
+}
+
+// --- HELPER SCENARI (--scenarios) ---
+// Più scenari di fila sugli stessi attori: a fine scenario il Direttore alza stop_simulation
+// con altri_scenari = 1, gli attori escono dai loro loop, si contano in attori_fermi e
+// dormono sul futex "scenario" finché la SHM non è pronta per il prossimo
+
+// Attore senza lavoro in questo scenario (indice oltre NOF_WORKERS o NOF_USERS): aspetta la fine
+static inline void attendi_fine(SharedData *shm) {
+    for (;;) {
+        unsigned int gen = __atomic_load_n(&shm->generazione_stato, __ATOMIC_ACQUIRE);
+        if (shm->stop_simulation) return;
+        futex(&shm->generazione_stato, FUTEX_WAIT, gen);
+    }
+}
+
+// Dopo stop_simulation: 0 se la simulazione è finita, 1 quando il prossimo scenario è pronto
+// (Config nuova in SHM). Mentre riazzera il segmento il Direttore lascia "scenario" a zero
+// per un istante, quindi aspetto proprio visto + 1 e non un valore qualsiasi diverso da visto
+// Mi conto in attori_fermi anche a fine simulazione: il Direttore smonta tutto appena ci
+// siamo tutti, senza aspettare a occhio che i figli abbiano letto il flag
+static inline int attendi_scenario(SharedData *shm, unsigned int *visto) {
+    int altri = __atomic_load_n(&shm->altri_scenari, __ATOMIC_ACQUIRE);
+    unsigned int attesi = shm->attori; // Letto prima di contarmi: poi il segmento non è più mio
+    if (__atomic_add_fetch(&shm->attori_fermi, 1, __ATOMIC_RELEASE) == attesi)
+        futex(&shm->attori_fermi, FUTEX_WAKE, INT_MAX);
+    if (!altri) return 0;
+    unsigned int atteso = *visto + 1, ora;
+    while ((ora = __atomic_load_n(&shm->scenario, __ATOMIC_ACQUIRE)) != atteso)
+        futex(&shm->scenario, FUTEX_WAIT, ora);
+    *visto = atteso;
+    return 1;
+}
+
+// --- HELPER SINCRONIZZAZIONE FINE ---
+
+// P su SEM_MUTEX che conta le acquisizioni e quelle trovate contese
+// Nel profilo IPC è una sola operazione PR_LOCK del chiamante (fallita = trovato conteso)
+static inline int mutex_lock_sito(SitoIpc *sito, SharedData *shm, int semid) {
+#ifdef PROFILO_IPC
+    long t0 = adesso_ns();
+#endif
+    int conteso = 0, r = 0;
+    __atomic_fetch_add(&shm->contesa.mutex_acquisizioni, 1, __ATOMIC_RELAXED);
+    if (sem_nowait_sito(NULL, semid, SEM_MUTEX, -1) < 0) {
+        __atomic_fetch_add(&shm->contesa.mutex_contese, 1, __ATOMIC_RELAXED);
+        conteso = 1;
+        r = sem_op_sito(NULL, semid, SEM_MUTEX, -1);
+    }
+#ifdef PROFILO_IPC
+    profilo_registra(sito, PR_LOCK, PRR_MUTEX, adesso_ns() - t0, conteso);
+#else
+    (void)sito;
+    (void)conteso;
+#endif
+    return r;
+}
+
+#define mutex_lock(shm, semid) mutex_lock_sito(SITO_IPC, shm, semid)
+
+// --- HELPER SPORTELLI LIBERI ---
+// Ogni servizio ha la bitmask dei suoi sportelli liberi: chi azzera il bit con una
+// fetch_and possiede lo sportello, chi lo rimette lo restituisce. Il Direttore le
+// ricostruisce ogni mattina (assegna_sportelli) e le svuota a fine giornata (chiudi_giornata)
+
+// Tempo libero di uno sportello da "dal" a "ora", contato solo mentre l'ufficio è aperto
+static inline long periodo_libero(const SharedData *shm, long dal, long ora) {
+    long inizio = dal > shm->apertura_ns ? dal : shm->apertura_ns;
+    long fine = shm->chiusura_ns > shm->apertura_ns && shm->chiusura_ns < ora ? shm->chiusura_ns : ora;
+    return fine > inizio ? fine - inizio : 0;
+}
+
+// Occupa lo sportello libero di indice più basso tra quelli dei servizi indicati
+// Ritorna lo sportello (occupato = chi) oppure -1 se non ce n'è nessuno
+static inline int sportello_prendi(SharedData *shm, unsigned int servizi, pid_t chi, long ora) {
+    for (;;) {
+        unsigned long liberi = 0;
+        for (unsigned int m = servizi; m; m &= m - 1)
+            liberi |= __atomic_load_n(&shm_servizio(shm, __builtin_ctz(m))->sportelli_liberi, __ATOMIC_ACQUIRE);
+        if (!liberi) return -1;
+        int seat = __builtin_ctzl(liberi);
+        unsigned long bit = 1UL << seat;
+        Sportello *sp = shm_sportello(shm, seat);
+        if (__atomic_fetch_and(&shm_servizio(shm, sp->servizio)->sportelli_liberi, ~bit, __ATOMIC_SEQ_CST) & bit) {
+            __atomic_fetch_add(&sp->ns_libero, periodo_libero(shm, sp->libero_da, ora), __ATOMIC_RELAXED);
+            __atomic_store_n(&sp->occupato, chi, __ATOMIC_RELAXED);
+            return seat;
+        }
+        __atomic_fetch_add(&shm->contesa.cas_falliti, 1, __ATOMIC_RELAXED); // Preso da un collega
+    }
+}
+
+// Rioccupa uno sportello preciso (ritorno dalla pausa): 1 se era ancora libero
+static inline int sportello_riprendi(SharedData *shm, int seat, pid_t chi, long ora) {
+    unsigned long bit = 1UL << seat;
+    Sportello *sp = shm_sportello(shm, seat);
+    if (!(__atomic_fetch_and(&shm_servizio(shm, sp->servizio)->sportelli_liberi, ~bit, __ATOMIC_SEQ_CST) & bit))
+        return 0;
+    __atomic_fetch_add(&sp->ns_libero, periodo_libero(shm, sp->libero_da, ora), __ATOMIC_RELAXED);
+    __atomic_store_n(&sp->occupato, chi, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// Rimette tra i liberi uno sportello già lasciato (occupato = 0)
+// SEQ_CST: chi libera pubblica il posto PRIMA di guardare gli operatori in attesa,
+// chi aspetta si iscrive PRIMA di ricontrollare i liberi (vedi operatore.c)
+static inline void sportello_pubblica(SharedData *shm, int seat, long ora) {
+    Sportello *sp = shm_sportello(shm, seat);
+    sp->libero_da = ora;
+    __atomic_fetch_or(&shm_servizio(shm, sp->servizio)->sportelli_liberi, 1UL << seat, __ATOMIC_SEQ_CST);
+}
+
+// Direttore, a ogni cambio di stato: sveglia chi dorme in attesa di uno sportello
+// (POSTO_IN_ATTESA -> POSTO_NESSUNO), così a ufficio chiuso nessuno resta appeso al futex
+static inline void sveglia_attese_posto(SharedData *shm) {
+    for (int i = 0; i < shm->cfg.nof_workers; i++) {
+        int atteso = POSTO_IN_ATTESA;
+        int *posto = &shm->slot_operatori[i].posto;
+        if (__atomic_compare_exchange_n(posto, &atteso, POSTO_NESSUNO, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            futex((unsigned int *)posto, FUTEX_WAKE, 1);
+    }
+}
+
+static inline int servizio_attivo(SharedData *shm, int servizio) {
+    return (__atomic_load_n(&shm->servizi_attivi, __ATOMIC_ACQUIRE) >> servizio) & 1;
+}
+
+// Seqlock lato scrittore (uno solo per slot): seq dispari durante l'aggiornamento
+static inline void seqlock_scrivi_inizio(unsigned int *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_scrivi_fine(unsigned int *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+// Lettore delle metriche live: copia finché seq è pari e invariato tra inizio e fine
+// Ritorna i tentativi falliti (0 = copia al primo colpo). Solo letture: va bene su SHM_RDONLY
+static inline int metriche_leggi(const MetricheLive *m, SnapshotLive *out) {
+    for (int ritentativi = 0;; ritentativi++) {
+        unsigned int inizio = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        if (!(inizio & 1)) {
+            memcpy(out, (const void *)&m->s, sizeof(SnapshotLive));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) == inizio) return ritentativi;
+        }
+        sched_yield();
+    }
+}
+
+// --- GENERATORE CASUALE (xoshiro256**) ---
+// Ogni attore ha il suo flusso, derivato dal seme master (SEED) e da un identificativo
+// stabile (tipo + indice dell'attore, MAI il PID o l'ora): stesso seme = stesse estrazioni.
+// Lo stato è privato dell'attore: niente lock interno di rand() tra thread, pochi ns a estrazione
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+#define FLUSSO_SPORTELLI        0x100000000UL           // Direttore: sportelli_mapping
+#define FLUSSO_OPERATORE(i)     (0x200000000UL + (i))
+#define FLUSSO_UTENTE(i)        (0x300000000UL + (i))
+#define FLUSSO_POPOLAZIONE      0x400000000UL           // Direttore: arrivi della popolazione
+#define FLUSSO_RETE             0x500000000UL           // Coordinatore della rete: zone degli utenti
+// Dopo una ripresa da checkpoint gli attori reali ricavano l'identità (competenze, P_SERV)
+// dal flusso originale, poi passano a un flusso nuovo: i giorni ripresi non ripetono
+// le estrazioni del giorno 1
+#define FLUSSO_RIPRESA(flusso, giorno) ((flusso) ^ ((unsigned long)(giorno) << 40))
+
+static inline uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Il seme viene prima rimescolato: semi vicini (repliche seme, seme+1...) danno flussi scorrelati
+static inline void rng_init(Rng *r, unsigned long seme, unsigned long flusso) {
+    uint64_t x = seme;
+    x = splitmix64(&x) ^ flusso;
+    for (int i = 0; i < 4; i++) r->s[i] = splitmix64(&x);
+}
+
+static inline uint64_t rng_next(Rng *r) {
+    uint64_t *s = r->s;
+    uint64_t x = s[1] * 5, risultato = ((x << 7) | (x >> 57)) * 9, t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return risultato;
+}
+
+// Intero uniforme in [0, n): moltiplicazione dei 32 bit alti (Lemire), niente divisione
+static inline int rng_intero(Rng *r, int n) {
+    return (int)(((rng_next(r) >> 32) * (uint64_t)n) >> 32);
+}
+
+// P_SERV di un utente: prima estrazione del suo flusso, identica in tutti i motori
+static inline int p_serv_casuale(const Config *cfg, Rng *r) {
+    return cfg->p_serv_min + rng_intero(r, cfg->p_serv_max - cfg->p_serv_min + 1);
+}
+
+// --- HELPER COMPETENZE E FURTO ---
+
+// Competenze: la principale più altri n-1 servizi distinti estratti a caso tra gli n_servizi
+static inline unsigned int competenze_casuali(int principale, int n, int n_servizi, Rng *rng) {
+    unsigned int c = 1u << principale;
+    if (n > n_servizi) n = n_servizi;
+    for (int k = 1; k < n; k++) {
+        int s;
+        do s = rng_intero(rng, n_servizi); while ((c >> s) & 1);
+        c |= 1u << s;
+    }
+    return c;
+}
+
+// Coda da cui rubare tra i servizi "candidati" (bitmask) secondo la politica:
+// lunghezze[] sono le code correnti degli n servizi (lette senza lock, è solo un'euristica)
+// Ritorna -1 se nessuna coda candidata ha clienti
+static inline int scegli_coda(const int *lunghezze, int n, unsigned int candidati, int politica, Rng *rng) {
+    int scelta = -1, visti = 0, piu_lunga = 0;
+    for (int s = 0; s < n; s++) {
+        if (!((candidati >> s) & 1)) continue;
+        int l = lunghezze[s];
+        if (l <= 0) continue;
+        if (politica == FURTO_PIU_LUNGA) {
+            if (l > piu_lunga) { piu_lunga = l; scelta = s; }
+        } else if (politica == FURTO_CASUALE) {
+            if (rng_intero(rng, ++visti) == 0) scelta = s;  // Reservoir sampling su un elemento
+        }
+    }
+    return scelta;
+}
+
+// --- TEMPORIZZAZIONE A SCADENZE ASSOLUTE ---
+// Servizi, pause, arrivi e giornata si dormono fino a un istante assoluto di CLOCK_MONOTONIC
+// con clock_nanosleep(TIMER_ABSTIME): niente arrotondamento ai microsecondi di usleep, e
+// il ritardo di un risveglio non sposta le scadenze successive (non si accumula)
+
+// Timer slack al minimo (1 ns invece di 50 us): ereditato da fork e thread creati dopo
+static inline void timer_preciso(void) {
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+}
+
+// Dorme fino all'istante scadenza (ns); ritorna il ritardo del risveglio (>= 0)
+static inline long dormi_fino(long scadenza) {
+    struct timespec ts = {scadenza / 1000000000L, scadenza % 1000000000L};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    long ritardo = adesso_ns() - scadenza;
+    return ritardo > 0 ? ritardo : 0;
+}
+
+// Registra un'attesa in contatori privati (un solo scrittore)
+static inline void deriva_registra(Deriva *d, long richiesto, long ritardo) {
+    d->attese++;
+    d->ns_richiesti += richiesto > 0 ? richiesto : 0;
+    d->ns_ritardo += ritardo;
+    if (ritardo > d->ritardo_max) d->ritardo_max = ritardo;
+}
+
+// Registra un'attesa in contatori condivisi da più attori (utenti)
+static inline void deriva_registra_condivisa(Deriva *d, long richiesto, long ritardo) {
+    __atomic_fetch_add(&d->attese, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&d->ns_richiesti, richiesto > 0 ? richiesto : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&d->ns_ritardo, ritardo, __ATOMIC_RELAXED);
+    long max = __atomic_load_n(&d->ritardo_max, __ATOMIC_RELAXED);
+    while (ritardo > max && !__atomic_compare_exchange_n(&d->ritardo_max, &max, ritardo, 1,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// --- HELPER ISTOGRAMMI ---
+
+// Bucket del valore v: i primi ISTO_SUB valori sono esatti, poi ISTO_SUB bucket per ottava
+static inline int isto_indice(long v) {
+    if (v < ISTO_SUB) return v < 0 ? 0 : (int)v;
+    int m = 63 - __builtin_clzl((unsigned long)v);     // Bit più significativo (>= ISTO_SUB_BITS)
+    if (m >= ISTO_MAX_BITS) return ISTO_BUCKET - 1;
+    int sotto = (int)(v >> (m - ISTO_SUB_BITS)) & (ISTO_SUB - 1);
+    return (m - ISTO_SUB_BITS + 1) * ISTO_SUB + sotto;
+}
+
+// Valore più alto che finisce nel bucket i (come highestEquivalentValue di HdrHistogram)
+static inline long isto_valore(int i) {
+    if (i < ISTO_SUB) return i;
+    int m = i / ISTO_SUB + ISTO_SUB_BITS - 1;
+    long base = (long)(ISTO_SUB + i % ISTO_SUB) << (m - ISTO_SUB_BITS);
+    return base + (1L << (m - ISTO_SUB_BITS)) - 1;
+}
+
+// Registrazione concorrente (più operatori sullo stesso servizio): solo atomiche relaxed
+static inline void isto_registra(Istogramma *h, long v) {
+    __atomic_fetch_add(&h->conteggio[isto_indice(v)], 1, __ATOMIC_RELAXED);
+    long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->max, &max, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// --- HELPER CODE TICKET (lock-free) ---
+// Usano i builtin __atomic di GCC: funzionano su campi int normali della SHM
+
+// Chiamata dal Direttore sulla SHM azzerata: lo slot i è libero per la posizione i
+static inline void coda_init(CodaTicket *c) {
+    c->coda = c->testa = 0;
+    for (unsigned int i = 0; i < CAPIENZA_CODA; i++) c->slot[i].seq = i;
+}
+
+// Produttore: ritorna 0 se la coda è piena
+static inline int coda_push(CodaTicket *c, int ticket, long t_ingresso) {
+    unsigned int pos = __atomic_load_n(&c->coda, __ATOMIC_RELAXED);
+    for (;;) {
+        SlotTicket *s = &c->slot[pos & (CAPIENZA_CODA - 1)];
+        int diff = (int)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            // Slot libero: provo a prenotarlo avanzando l'indice di coda
+            if (__atomic_compare_exchange_n(&c->coda, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                s->ticket = ticket;
+                s->t_ingresso = t_ingresso;
+                __atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE); // Pubblico
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0; // Lo slot contiene ancora un ticket di un giro precedente
+        } else {
+            pos = __atomic_load_n(&c->coda, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Consumatore: ritorna 0 se non c'è un ticket pubblicato in testa
+static inline int coda_pop(CodaTicket *c, int *ticket, long *t_ingresso) {
+    unsigned int pos = __atomic_load_n(&c->testa, __ATOMIC_RELAXED);
+    for (;;) {
+        SlotTicket *s = &c->slot[pos & (CAPIENZA_CODA - 1)];
+        int diff = (int)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&c->testa, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *ticket = s->ticket;
+                *t_ingresso = s->t_ingresso;
+                __atomic_store_n(&s->seq, pos + CAPIENZA_CODA, __ATOMIC_RELEASE); // Libero per il giro dopo
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&c->testa, __ATOMIC_RELAXED);
+        }
+    }
+}
+
 #endif
\ No newline at end of file
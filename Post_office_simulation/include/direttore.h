@@ -0,0 +1,213 @@
+#ifndef DIRETTORE_H
+#define DIRETTORE_H
+
+/* * DIRETTORE.H
+ * Funzioni del Direttore condivise tra i suoi moduli:
+ * - main.c: motore "ipc" (processi reali + System V) e logica di giornata
+ * - des.c:  motore a eventi discreti (orologio virtuale, nessun processo figlio)
+ * - repliche.c: esecuzioni Monte Carlo parallele e loro aggregazione
+ * - sportelli.c: politiche di apertura mattutina degli sportelli
+ * - checkpoint.c: fotografia di fine giornata e ripresa (--checkpoint, --resume)
+ * - scenari.c: più configurazioni in serie sulle stesse risorse (--scenarios)
+ * - popolazione.c: arrivi generati dal Direttore su una popolazione in memoria (ARRIVALS)
+ * - rete.c: più uffici in processi separati e coordinatore degli arrivi (--offices)
+ */
+
+#include "common.h"
+#include "traccia.h"
+
+// Memoria della politica a carico tra una mattina e l'altra (sportelli.c)
+// Vive nel Direttore, non in SHM: finisce nel checkpoint insieme al segmento
+typedef struct {
+    double arrivi_stimati[MAX_SERVIZI];  // Arrivi giornalieri attesi per servizio
+    int coda_ieri[MAX_SERVIZI];          // in_attesa all'apertura di ieri
+    unsigned int attivi_ieri;
+    int giorni_visti;
+} MemoriaSportelli;
+
+// --- checkpoint.c ---
+// Fotografia di fine giornata in un solo file, a sezioni allineate alla pagina:
+// [TestataCheckpoint][immagine del segmento (shm_dimensione)][stato privato del motore]
+// L'immagine è la SHM così com'è (nessun puntatore, solo offset): alla ripresa il file
+// si mappa con mmap e si copia nel segmento nuovo, senza parsing
+#define CHECKPOINT_MAGIC "UPCKPT03"   // 03: modello di arrivo nella Config
+#define CHECKPOINT_DEFAULT "simulazione.ckpt"
+
+typedef struct {
+    char magic[8];
+    char engine[8];             // Motore che l'ha scritto (ipc e thread sono intercambiabili)
+    int giorno;                 // Ultimo giorno completato
+    long t_ns;                  // CLOCK_MONOTONIC alla scrittura (per ribasare i ticket in coda)
+    size_t off_shm, dim_shm;
+    size_t off_motore, dim_motore;
+    Rng rng_sportelli;          // Flusso del Direttore per la mappa degli sportelli
+    MemoriaSportelli memoria;
+    Config cfg;
+} TestataCheckpoint;
+
+// Checkpoint mappato in sola lettura
+typedef struct {
+    const TestataCheckpoint *t;
+    const SharedData *shm;      // Immagine del segmento dentro la mappatura
+    const char *motore;         // dim_motore byte di stato del motore (DES), NULL se assenti
+    size_t dim_mappa;
+} Checkpoint;
+
+// Esito di una simulazione, inviato dalla replica al processo che le coordina
+typedef struct {
+    int giorni;                 // Giorni effettivamente simulati (meno di SIM_DURATION se Explode)
+    Stats totali;
+    long sportelli_giorni;      // Somma degli sportelli aperti sui giorni simulati
+    long ns_sportelli_liberi, ns_sportelli_aperti;  // Tempo libero / tempo di apertura degli sportelli
+    long attesa_p50, attesa_p90, attesa_p99;    // ns, su tutti i servizi
+} Risultato;
+
+// Una configurazione del file --scenarios e il suo esito
+typedef struct {
+    char nome[LUNGHEZZA_NOME];
+    Config cfg;
+    Risultato esito;
+    double ms_preparazione;     // Primo scenario: avvio di risorse e attori; poi: cambio di scenario
+    double secondi;             // Durata delle sue giornate
+} Scenario;
+
+// Opzioni di esecuzione da riga di comando (quelle che non finiscono nella Config)
+typedef struct {
+    const char *engine;
+    long n_thread;              // Thread del pool utenti (--engine=thread)
+    int zygote;                 // Avvio degli utenti (motore ipc)
+    const char *file_traccia;   // --trace=FILE: traccia binaria degli eventi
+    const char *file_checkpoint;    // --checkpoint=FILE: fotografia a fine giornata (NULL = spenta)
+    int ogni_giorni;                // --checkpoint-every=N: una fotografia ogni N giorni
+    const Checkpoint *ripresa;      // --resume: checkpoint da cui ripartire (NULL = dal giorno 1)
+    Scenario *scenari;              // --scenarios: da eseguire in serie (NULL = la sola Config data)
+    int n_scenari;
+    const char *rete;               // --offices=K o pesi delle zone (NULL = un solo ufficio)
+    int instradamento;              // --routing: INSTRADA_*
+    int ufficio;                    // Nella rete: indice dell'ufficio simulato da questo processo
+    const char *file_esporta;       // --export=FILE: statistiche giornaliere su file (esporta.h)
+    int silenzioso;                 // --quiet: niente report giornaliero a console
+} Opzioni;
+
+// --- main.c ---
+// Simulazione completa (privato=1: risorse IPC_PRIVATE, namespace proprio)
+int simula(Config *cfg, const Opzioni *o, int privato);
+// A fine simulazione: consegna il Risultato alla raccolta delle repliche, se attiva,
+// e lo copia in esito (NULL fuori da --scenarios)
+void pubblica_risultato(SharedData *shm, int giorni, Risultato *esito);
+void load_config(const char *filename, Config *cfg);
+// I pezzi di load_config, per chi legge le chiavi da altri file (scenari.c):
+// valori di default, una riga "CHIAVE=valore" (servizi_letti: SERVICE già letti) e limiti
+void config_default(Config *cfg);
+void config_riga(Config *cfg, const char *riga, int *servizi_letti);
+void config_valida(Config *cfg);
+void print_stats(SharedData *shm, int day, int simulation_end);
+int chiudi_giornata(SharedData *shm);
+// Dopo il ripristino di un checkpoint: "ieri" della contabilità giornaliera = immagine ripristinata
+void riprendi_contabilita(SharedData *shm);
+
+// --- des.c ---
+// Esegue l'intera simulazione sul tempo simulato e stampa le stesse statistiche
+int des_esegui(const Config *cfg, const Opzioni *o);
+
+// --- sportelli.c ---
+// Apre gli sportelli del giorno secondo cfg.politica_sportelli (ALLOC_*) e pubblica
+// servizi_attivi; va chiamata a ufficio chiuso, prima di azzerare le stats giornaliere
+void assegna_sportelli(SharedData *shm, Rng *rng);
+extern MemoriaSportelli memoria_sportelli;
+
+// --- checkpoint.c ---
+// Scrive il checkpoint di fine giornata (file temporaneo + rename: un'interruzione durante
+// la scrittura lascia intatto quello precedente). Ritorna 0, oppure -1 dopo aver stampato l'errore
+int checkpoint_scrivi(const char *file, const char *engine, int giorno, const SharedData *shm,
+                      const Rng *rng_sportelli, const void *motore, size_t dim_motore);
+// Mappa e valida un checkpoint: 0 se è utilizzabile, -1 dopo aver stampato il motivo
+int checkpoint_apri(const char *file, Checkpoint *c);
+void checkpoint_chiudi(Checkpoint *c);
+// Copia l'immagine nel segmento (già dimensionato e impaginato con la stessa Config),
+// riporta l'ufficio a chiuso e ripristina lo stato del Direttore. Ritorna il primo giorno da simulare
+int checkpoint_ripristina(SharedData *shm, const Checkpoint *c, Rng *rng_sportelli);
+
+// --- repliche.c ---
+// --replications: n simulazioni indipendenti (SEED, SEED+1, ...), jobs alla volta,
+// ognuna in un processo figlio; stampa medie e intervalli di confidenza al 95%
+int repliche_esegui(Config *cfg, const Opzioni *o, int n, int jobs);
+// Nella replica: descrittore su cui scrivere il Risultato (-1 fuori dalle repliche)
+extern int fd_risultato;
+// Fork di una simulazione completa (repliche e uffici della rete): process group proprio,
+// stdout su /dev/null, affinità cpu (NULL = ereditata). Ritorna il pid e in *fd il lato
+// lettura della pipe su cui il figlio consegna il Risultato
+pid_t simula_figlio(const Config *cfg, const Opzioni *o, const cpu_set_t *cpu, int *fd);
+// CTRL+C del padre delle simulazioni figlie: alza interrotto senza SA_RESTART,
+// il padre lo gira con kill(SIGINT) ai figli che stanno nel loro process group
+extern volatile sig_atomic_t interrotto;
+void intercetta_interruzione(void);
+// Metriche di un Risultato (tabella delle repliche e confronto degli scenari):
+// le prime NUM_METRICHE_FISSE, poi una per servizio della Config
+#define NUM_METRICHE_FISSE 10
+const char *metrica_nome(const Config *cfg, int k);
+double metrica_valore(const Risultato *r, int k);
+
+// --- profilo.c (profilo IPC: funzioni vuote se la build non è -DPROFILO_IPC) ---
+// Crea il segmento dei contatori, dimensionato sugli attori di dim: va chiamata prima di
+// avviare i figli, che lo trovano con l'ambiente di profilo_env() (NULL se spento)
+void profilo_avvia(const Config *dim);
+const char *profilo_env(void);
+// Report di contesa a simulazione ferma (shm: tempo di servizio degli operatori)
+void profilo_report(SharedData *shm);
+// Rimozione del segmento (idempotente, anche dalla cleanup)
+void profilo_termina(void);
+
+// --- popolazione.c ---
+// Arrivi di una finestra, in ordine di tempo
+typedef struct {
+    int n, cap;
+    double *minuto;             // Minuti simulati dall'apertura
+    int *utente;
+    unsigned char *servizio;
+} LottoArrivi;
+
+// Esito di un arrivo generato
+enum { ARRIVO_IN_CODA, ARRIVO_SERVIZIO_CHIUSO, ARRIVO_CODA_PIENA, ARRIVO_UFFICIO_CHIUSO, NUM_ESITI_ARRIVO };
+
+typedef struct Popolazione Popolazione;
+Popolazione *popolazione_crea(const Config *cfg);
+void popolazione_libera(Popolazione *p);
+void lotto_libera(LottoArrivi *l);
+// Genera in l gli arrivi a partire dal minuto da; ritorna il minuto in cui inizia il prossimo
+// lotto (minuti_giornata: giornata completa)
+double popolazione_lotto(Popolazione *p, double da, LottoArrivi *l);
+// Registra l'esito dell'arrivo dell'utente u (t: ns, ticket -1 se non l'ha preso)
+void popolazione_esito(Popolazione *p, int u, int esito, int servizio, int ticket, long t);
+// Ticket e ingresso nella coda del servizio di shm, come un utente: ritorna 1 se è in coda
+// (la V sul semaforo della coda resta al chiamante, che le raggruppa)
+int popolazione_accoda(Popolazione *p, SharedData *shm, RingTraccia *ring, int u, int servizio, long t);
+void popolazione_rientro(Popolazione *p);
+void popolazione_report(const Popolazione *p);
+// Motori ipc e thread: thread del Direttore che consegna gli arrivi alle code della SHM
+// giorno per giorno, fino a popolazione_ferma o a stop_simulation
+void popolazione_avvia(Popolazione *p, SharedData *shm, int sem_id, RingTraccia *ring);
+void popolazione_ferma(Popolazione *p);
+
+// --- rete.c ---
+#define MAX_UFFICI 64
+enum { INSTRADA_VICINO, INSTRADA_CODA, INSTRADA_ATTESA };
+// Avvia gli uffici di o->rete, ognuno una simula() in un processo figlio con le sue CPU,
+// instrada gli arrivi della popolazione e stampa il confronto tra gli uffici e la rete
+int rete_esegui(Config *cfg, const Opzioni *o);
+// Lato ufficio: risorse IPC da comunicare al coordinatore, barriera prima di aprire ogni
+// giorno (0 se il coordinatore ha chiuso la rete) e fine delle giornate
+void rete_registra(int ufficio, int shm_id, int sem_id);
+int rete_attendi_giorno(int ufficio, int giorno);
+void rete_fine(int ufficio);
+
+// --- scenari.c ---
+// Legge il file --scenarios: righe CHIAVE=valore comuni, poi una sezione [nome] per scenario
+// Ritorna il numero di scenari (esce con un errore se non ce ne sono)
+int scenari_carica(const char *file, Scenario **scenari);
+// Esegue o->scenari in serie e stampa il confronto (motore ipc: non ritorna, come simula)
+int scenari_esegui(const Opzioni *o);
+// Tabella finale: una colonna per scenario, una riga per metrica
+void scenari_confronto(const Opzioni *o);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ESPORTA_H
+#define ESPORTA_H
+
+/* * ESPORTA.H
+ * Esportazione delle statistiche giornaliere (--export=FILE) e formato letto da bin/aggrega
+ * * Una riga per giornata chiusa, tutti valori a 64 bit, con colonne fisse:
+ * - Stats del giorno, respinti per coda piena, sportelli aperti
+ * - per servizio: erogati e residui in coda alla chiusura
+ * - per sportello: servizio assegnato quel giorno (-1 se chiuso), cioè la mappa degli sportelli
+ * * Due formati, scelti dall'estensione del file:
+ * - .csv: intestazione con i nomi delle colonne, una riga di testo per giorno
+ * - altrimenti binario a colonne: [TestataEsporta][nomi delle colonne] poi blocchi di al più
+ *   RIGHE_BLOCCO giorni, ognuno [n_righe][colonna 0 x n][colonna 1 x n]... Chi legge tiene in
+ *   memoria un blocco alla volta e una colonna è contigua (niente parsing, si legge a fread)
+ */
+
+#include "common.h"
+
+#define ESPORTA_MAGIC "UPSTAT01"
+#define RIGHE_BLOCCO 256            // Giorni per blocco (e per scrittura su file)
+#define LUNGHEZZA_COLONNA 48
+
+// Colonne fisse prima di quelle per servizio e per sportello
+enum {
+    COL_GIORNO, COL_SERVITI, COL_NON_EROGATI, COL_ATTESA_NS, COL_SERVIZIO_NS, COL_PAUSE,
+    COL_OPERATORI, COL_RESPINTI, COL_SPORTELLI_APERTI, NUM_COL_FISSE
+};
+
+static const char *NOMI_COL[NUM_COL_FISSE] = {
+    "giorno", "serviti", "non_erogati", "attesa_ns", "servizio_ns", "pause",
+    "operatori", "respinti", "sportelli_aperti"
+};
+
+typedef struct {
+    char magic[8];
+    int n_colonne;
+    int righe_blocco;
+    Config cfg;
+} TestataEsporta;
+
+// Colonne della Config: fisse, erogati e residui per servizio, una per sportello
+static inline int esporta_colonne(const Config *cfg) {
+    return NUM_COL_FISSE + 2 * cfg->num_servizi + cfg->num_sportelli;
+}
+
+// Nome della colonna k (i nomi dei servizi diventano identificatori: "Prodotti Fin." -> Prodotti_Fin_)
+static inline void esporta_nome(const Config *cfg, int k, char *nome) {
+    if (k < NUM_COL_FISSE) { snprintf(nome, LUNGHEZZA_COLONNA, "%s", NOMI_COL[k]); return; }
+    k -= NUM_COL_FISSE;
+    if (k >= 2 * cfg->num_servizi) { snprintf(nome, LUNGHEZZA_COLONNA, "sportello_%d", k - 2 * cfg->num_servizi); return; }
+    snprintf(nome, LUNGHEZZA_COLONNA, "%s_%s", k < cfg->num_servizi ? "erogati" : "residui",
+             cfg->servizi[k % cfg->num_servizi].nome);
+    for (char *c = nome; *c; c++)
+        if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) *c = '_';
+}
+
+// --- DIRETTORE (esporta.c) ---
+// Apre il file e avvia il thread di scrittura: ritorna -1 (dopo aver stampato l'errore) se fallisce
+int esporta_avvia(const char *file, const Config *cfg);
+// Riga della giornata appena chiusa (dopo chiudi_giornata): la copia in un blocco in memoria,
+// il file lo scrive il thread quando il blocco è pieno. No-op senza --export
+void esporta_giornata(SharedData *shm, int giorno);
+// Ultimo blocco, chiusura del file (idempotente, anche dalla cleanup fuori dal gestore di SIGINT)
+// Ritorna -1 (dopo aver stampato l'errore) se una scrittura o la chiusura sono fallite
+int esporta_termina(void);
+
+#endif
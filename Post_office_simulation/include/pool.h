@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* * POOL.H
+ * Motore "thread" (--engine=thread): niente fork/execve, tutti gli attori girano nel Direttore
+ * - Erogatore e Operatori: un pthread ciascuno (sono pochi e passano il tempo dormendo)
+ * - Utenti: macchine a stati (utente_passo) eseguite da un pool FISSO di thread
+ *   Un utente che dorme o aspetta l'apertura non occupa alcun thread, quindi
+ *   il numero di utenti non è più limitato dalla tabella dei processi
+ * Le risorse IPC (SHM, semafori, coda ticket) restano le stesse del motore a processi
+ */
+
+#include "common.h"
+#include "traccia.h"
+
+typedef struct Pool Pool;
+
+// Avvia Erogatore, Operatori e il pool degli Utenti (P_SERV dal flusso casuale di ciascuno)
+// traccia: segmento della traccia binaria, NULL se disattivata
+Pool *pool_avvia(SharedData *shm, int sem_id, int msg_id, int n_thread, Traccia *traccia);
+
+// Il Direttore ha cambiato ufficio_aperto o stop_simulation: risveglio gli utenti parcheggiati
+void pool_notifica(Pool *p);
+
+// Attende la fine di tutti gli utenti e degli operatori (dopo stop_simulation = 1)
+void pool_termina(Pool *p);
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef TRACCIA_H
+#define TRACCIA_H
+
+/* * TRACCIA.H
+ * Traccia binaria degli eventi (--trace=FILE): record a dimensione fissa scritti dagli attori
+ * in ring buffer lock-free in un segmento SHM dedicato, e riversati su file dal Direttore
+ * * Scelte di design:
+ * - Un ring per ogni operatore e uno per il Direttore (un solo produttore ciascuno);
+ *   gli utenti (anche 10000 processi) condividono RING_UTENTI ring scelti per PID
+ * - Stesso schema di Vyukov della coda ticket: il produttore prenota la posizione con una CAS
+ *   e pubblica lo slot con il numero di sequenza, il Direttore è l'unico consumatore
+ * - Ring pieno = record perso e contato, MAI attesa: la traccia non deve alterare i tempi
+ * - Senza --trace il segmento non esiste e ogni scrittura è un confronto con NULL
+ * - Segmento IPC_PRIVATE come le altre risorse: l'id arriva ai figli nell'ambiente
+ *   (ENV_TRACCIA), quindi due esecuzioni con --trace non si scrivono addosso
+ */
+
+#include "common.h"
+
+#define ENV_TRACCIA "POSTA_TRACCIA"
+#define CAPIENZA_TRACCIA 4096   // Record per ring (potenza di 2)
+#define RING_UTENTI 16          // Ring condivisi dagli utenti
+#define TRACCIA_MAGIC "UPTRACE3"   // 3: Config con il modello di arrivo
+
+// --- TIPI DI EVENTO ---
+enum {
+    TR_APERTURA,        // Direttore: ticket = giorno
+    TR_CHIUSURA,        // Direttore: ticket = giorno
+    TR_FINE_GIORNATA,   // Direttore: statistiche raccolte, ticket = giorno, valore = rimasti in coda
+    TR_TICKET,          // Utente: ticket ottenuto, valore = ns spesi per ottenerlo
+    TR_ACCODA,          // Utente: ticket depositato nella coda del servizio
+    TR_RESPINTO,        // Utente: coda piena, rinuncia
+    TR_PRELIEVO,        // Operatore: cliente chiamato allo sportello, valore = attesa in ns
+    TR_FINE_SERVIZIO,   // Operatore: valore = durata del servizio in ns
+    TR_PAUSA_INIZIO,    // Operatore: si alza per la pausa
+    TR_PAUSA_FINE,      // Operatore: valore = 1 se ha ripreso lo sportello, 0 se l'ha perso
+    TR_SEDUTO,          // Operatore: ha occupato lo sportello (inizio turno)
+    TR_ALZATO,          // Operatore: fine turno, sportello liberato
+    NUM_TR
+};
+
+// Record su file (40 byte): i campi non pertinenti valgono -1
+typedef struct {
+    long t;             // CLOCK_MONOTONIC in ns
+    long valore;        // Dipende dal tipo (vedi sopra)
+    int tipo;
+    int attore;         // Operatore: indice; Utente: TID; Direttore: 0
+    int servizio;
+    int sportello;
+    int ticket;         // Numero del ticket, o giorno per gli eventi del Direttore
+    int riservato;
+} RecordTraccia;
+
+typedef struct {
+    unsigned int seq;
+    RecordTraccia r;
+} SlotTraccia;
+
+typedef struct {
+    unsigned int coda;      // Produttori
+    unsigned int testa;     // Consumatore (Direttore)
+    long persi;             // Record scartati a ring pieno
+    SlotTraccia slot[CAPIENZA_TRACCIA];
+} RingTraccia;
+
+// Segmento SHM della traccia: ring[0] Direttore, poi operatori, poi utenti
+typedef struct {
+    int n_ring;
+    int n_operatori;
+    RingTraccia ring[];
+} Traccia;
+
+// Testata del file, seguita dai record nell'ordine in cui il Direttore li raccoglie
+// (ordinati per ring, non globalmente: bin/analyze li riordina per tempo)
+typedef struct {
+    char magic[8];
+    int dimensione_record;
+    int n_ring;
+    Config cfg;
+} TestataTraccia;
+
+static inline size_t traccia_dimensione(int n_ring) {
+    return sizeof(Traccia) + (size_t)n_ring * sizeof(RingTraccia);
+}
+
+// Ring del Direttore, dell'operatore i e dell'utente con identità id
+static inline RingTraccia *traccia_ring_direttore(Traccia *t) {
+    return t ? &t->ring[0] : NULL;
+}
+
+static inline RingTraccia *traccia_ring_operatore(Traccia *t, int i) {
+    return t ? &t->ring[1 + i] : NULL;
+}
+
+static inline RingTraccia *traccia_ring_utente(Traccia *t, pid_t id) {
+    return t ? &t->ring[1 + t->n_operatori + (unsigned int)id % RING_UTENTI] : NULL;
+}
+
+// Figli: attach al segmento creato dal Direttore (NULL se la traccia è disattivata)
+static inline Traccia *traccia_attach(const Config *cfg) {
+    const char *v = getenv(ENV_TRACCIA);
+    if (!cfg->traccia || !v) return NULL;
+    Traccia *t = shmat(atoi(v), NULL, 0);
+    return t == (void *)-1 ? NULL : t;
+}
+
+// Produttore: mai bloccante, a ring pieno il record viene contato come perso
+static inline void traccia_scrivi(RingTraccia *r, int tipo, int attore, int servizio,
+                                  int sportello, int ticket, long valore) {
+    if (!r) return;
+    unsigned int pos = __atomic_load_n(&r->coda, __ATOMIC_RELAXED);
+    for (;;) {
+        SlotTraccia *s = &r->slot[pos & (CAPIENZA_TRACCIA - 1)];
+        int diff = (int)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&r->coda, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                s->r = (RecordTraccia){adesso_ns(), valore, tipo, attore, servizio, sportello, ticket, 0};
+                __atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+                return;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&r->persi, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&r->coda, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Consumatore (unico): ritorna 0 se non c'è un record pubblicato in testa
+static inline int traccia_leggi(RingTraccia *r, RecordTraccia *out) {
+    unsigned int pos = r->testa;
+    SlotTraccia *s = &r->slot[pos & (CAPIENZA_TRACCIA - 1)];
+    if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != pos + 1) return 0;
+    *out = s->r;
+    __atomic_store_n(&s->seq, pos + CAPIENZA_TRACCIA, __ATOMIC_RELEASE);
+    r->testa = pos + 1;
+    return 1;
+}
+
+// --- DIRETTORE (traccia.c) ---
+// Crea il segmento e avvia il thread che riversa i ring su file ogni millisecondo
+Traccia *traccia_avvia(const char *file, const Config *cfg);
+// Ultimo svuotamento, chiusura del file e rimozione del segmento (idempotente)
+void traccia_termina(void);
+// Solo la rimozione del segmento, senza join né stdio: per la cleanup dal gestore di SIGINT
+void traccia_rimuovi(void);
+// "ENV_TRACCIA=id" per l'ambiente dei figli, NULL senza --trace
+const char *traccia_env(void);
+
+#endif
@@ -0,0 +1,223 @@
+#include <math.h>
+#include "common.h"
+#include "esporta.h"
+
+/*
+ * AGGREGA.C (Riepilogo offline delle statistiche esportate con --export)
+ * * Uso: ./bin/aggrega statistiche.bin|statistiche.csv [--finestra=W]
+ * Legge il file in streaming (un blocco del formato a colonne o una riga di CSV alla volta),
+ * quindi la memoria non dipende dal numero di giornate: 10^5 giorni si riassumono come 10
+ * 1. Per ogni colonna numerica: media, deviazione standard (Welford), minimo e massimo col
+ *    giorno in cui sono stati toccati, totale
+ * 2. Medie mobili su W giorni (default 7) delle metriche principali: la finestra migliore,
+ *    la peggiore e l'ultima. Servono a vedere derive e giornate anomale su run lunghi
+ * Le colonne sportello_* (servizio assegnato) sono categoriali e non vengono riassunte
+ */
+
+#define MAX_COLONNE (NUM_COL_FISSE + 2 * MAX_SERVIZI + MAX_SPORTELLI)
+
+// --- LETTURA IN STREAMING ---
+typedef struct {
+    FILE *f;
+    int csv;
+    int n_colonne;
+    char nomi[MAX_COLONNE][LUNGHEZZA_COLONNA];
+    TestataEsporta h;       // Solo per il formato binario
+    // Binario: blocco corrente a colonne
+    long *blocco;
+    int righe, riga;
+    // CSV: una riga di testo alla volta
+    char *linea;
+    size_t cap_linea;
+} Lettore;
+
+static int apri(Lettore *l, const char *file) {
+    memset(l, 0, sizeof(*l));
+    l->f = fopen(file, "rb");
+    if (!l->f) { perror("Apertura file"); return -1; }
+
+    if (fread(&l->h, sizeof(l->h), 1, l->f) == 1 && !memcmp(l->h.magic, ESPORTA_MAGIC, sizeof(l->h.magic))) {
+        if (l->h.n_colonne < 1 || l->h.n_colonne > MAX_COLONNE || l->h.righe_blocco < 1) return -1;
+        l->n_colonne = l->h.n_colonne;
+        for (int c = 0; c < l->n_colonne; c++)
+            if (fread(l->nomi[c], LUNGHEZZA_COLONNA, 1, l->f) != 1) return -1;
+        for (int c = 0; c < l->n_colonne; c++) l->nomi[c][LUNGHEZZA_COLONNA - 1] = '\0';
+        l->blocco = malloc((size_t)l->n_colonne * l->h.righe_blocco * sizeof(long));
+        if (!l->blocco) { perror("malloc"); exit(1); }
+        return 0;
+    }
+
+    // Non è binario: CSV con l'intestazione dei nomi
+    rewind(l->f);
+    l->csv = 1;
+    if (getline(&l->linea, &l->cap_linea, l->f) < 0) return -1;
+    for (char *tok = strtok(l->linea, ",\r\n"); tok; tok = strtok(NULL, ",\r\n")) {
+        if (l->n_colonne == MAX_COLONNE) return -1;
+        snprintf(l->nomi[l->n_colonne++], LUNGHEZZA_COLONNA, "%s", tok);
+    }
+    return l->n_colonne > 0 && !strcmp(l->nomi[0], NOMI_COL[COL_GIORNO]) ? 0 : -1;
+}
+
+// Prossima giornata in riga[]: 1 se letta, 0 a fine file (o su un blocco troncato)
+static int leggi(Lettore *l, long *riga) {
+    if (l->csv) {
+        while (getline(&l->linea, &l->cap_linea, l->f) >= 0) {
+            char *p = l->linea, *fine;
+            int c = 0;
+            for (; c < l->n_colonne; c++) {
+                riga[c] = strtol(p, &fine, 10);
+                if (fine == p) break;
+                p = *fine == ',' ? fine + 1 : fine;
+            }
+            if (c == l->n_colonne) return 1; // Righe incomplete (file ancora in scrittura) saltate
+        }
+        return 0;
+    }
+
+    if (l->riga == l->righe) {
+        int n;
+        if (fread(&n, sizeof(int), 1, l->f) != 1 || n < 1 || n > l->h.righe_blocco) return 0;
+        for (int c = 0; c < l->n_colonne; c++)
+            if (fread(&l->blocco[(size_t)c * l->h.righe_blocco], sizeof(long), n, l->f) != (size_t)n) return 0;
+        l->righe = n;
+        l->riga = 0;
+    }
+    for (int c = 0; c < l->n_colonne; c++) riga[c] = l->blocco[(size_t)c * l->h.righe_blocco + l->riga];
+    l->riga++;
+    return 1;
+}
+
+// --- STATISTICHE PER COLONNA ---
+typedef struct {
+    long n;
+    double media, m2;       // Welford: niente somme dei quadrati che perdono precisione
+    long min, max, totale;
+    long giorno_min, giorno_max;
+} Colonna;
+
+static void aggiungi(Colonna *c, long v, long giorno) {
+    c->n++;
+    double delta = v - c->media;
+    c->media += delta / c->n;
+    c->m2 += delta * (v - c->media);
+    if (c->n == 1 || v < c->min) { c->min = v; c->giorno_min = giorno; }
+    if (c->n == 1 || v > c->max) { c->max = v; c->giorno_max = giorno; }
+    c->totale += v;
+}
+
+// --- MEDIE MOBILI ---
+// Per ogni metrica un numeratore e un denominatore per giorno (1 per i conteggi, i serviti per
+// l'attesa media): la media mobile è somma/somma sulla finestra, pesata come il report totale
+enum { MM_SERVITI, MM_NON_EROGATI, MM_RESPINTI, MM_ATTESA, NUM_MM };
+static const char *NOMI_MM[NUM_MM] = {"serviti/giorno", "non erogati/giorno", "respinti/giorno", "attesa media (min)"};
+
+typedef struct {
+    double *num, *den;      // Anelli di W giorni
+    double somma_num, somma_den;
+    double migliore, peggiore, ultima;
+    long giorno_migliore, giorno_peggiore;
+    int valide;             // Finestre complete già viste
+} Mobile;
+
+static void mobile_aggiungi(Mobile *m, int w, long k, double num, double den, long giorno) {
+    int i = k % w;
+    if (k >= w) { m->somma_num -= m->num[i]; m->somma_den -= m->den[i]; }
+    m->num[i] = num;
+    m->den[i] = den;
+    m->somma_num += num;
+    m->somma_den += den;
+    if (k + 1 < w || m->somma_den <= 0) return;
+    double v = m->somma_num / m->somma_den;
+    if (!m->valide || v < m->migliore) { m->migliore = v; m->giorno_migliore = giorno; }
+    if (!m->valide || v > m->peggiore) { m->peggiore = v; m->giorno_peggiore = giorno; }
+    m->ultima = v;
+    m->valide++;
+}
+
+static int cerca_colonna(const Lettore *l, const char *nome) {
+    for (int c = 0; c < l->n_colonne; c++) if (!strcmp(l->nomi[c], nome)) return c;
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL;
+    int w = 7;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--finestra=", 11)) w = atoi(argv[i] + 11);
+        else if (argv[i][0] != '-') file = argv[i];
+        else { fprintf(stderr, "Opzione sconosciuta: %s\n", argv[i]); return 1; }
+    }
+    if (!file || w < 1) {
+        fprintf(stderr, "Uso: %s statistiche.bin|statistiche.csv [--finestra=W]\n", argv[0]);
+        return 1;
+    }
+
+    static Lettore l;
+    if (apri(&l, file) < 0) {
+        fprintf(stderr, "%s: non è un file di --export compatibile\n", file);
+        return 1;
+    }
+
+    // Colonne delle medie mobili (per nome: il CSV può arrivare da una Config qualsiasi)
+    int c_serviti = cerca_colonna(&l, NOMI_COL[COL_SERVITI]);
+    int c_non_erogati = cerca_colonna(&l, NOMI_COL[COL_NON_EROGATI]);
+    int c_respinti = cerca_colonna(&l, NOMI_COL[COL_RESPINTI]);
+    int c_attesa = cerca_colonna(&l, NOMI_COL[COL_ATTESA_NS]);
+    // Attese in minuti simulati se la Config è nella testata, altrimenti (CSV) in ns come il report
+    double ns_minuto = !l.csv && l.h.cfg.nano_secs_per_min > 0 ? l.h.cfg.nano_secs_per_min : 1;
+    if (ns_minuto == 1) NOMI_MM[MM_ATTESA] = "attesa media (ns)";
+
+    static Colonna col[MAX_COLONNE];
+    static long riga[MAX_COLONNE];
+    Mobile mm[NUM_MM];
+    memset(mm, 0, sizeof(mm));
+    for (int m = 0; m < NUM_MM; m++) {
+        mm[m].num = calloc(w, sizeof(double));
+        mm[m].den = calloc(w, sizeof(double));
+        if (!mm[m].num || !mm[m].den) { perror("calloc"); return 1; }
+    }
+
+    long giorni = 0;
+    while (leggi(&l, riga)) {
+        long giorno = riga[COL_GIORNO];
+        for (int c = 0; c < l.n_colonne; c++) aggiungi(&col[c], riga[c], giorno);
+        if (c_serviti >= 0) mobile_aggiungi(&mm[MM_SERVITI], w, giorni, riga[c_serviti], 1, giorno);
+        if (c_non_erogati >= 0) mobile_aggiungi(&mm[MM_NON_EROGATI], w, giorni, riga[c_non_erogati], 1, giorno);
+        if (c_respinti >= 0) mobile_aggiungi(&mm[MM_RESPINTI], w, giorni, riga[c_respinti], 1, giorno);
+        if (c_attesa >= 0 && c_serviti >= 0)
+            mobile_aggiungi(&mm[MM_ATTESA], w, giorni, riga[c_attesa] / ns_minuto, riga[c_serviti], giorno);
+        giorni++;
+    }
+    fclose(l.f);
+
+    printf("[Aggrega] %s: %ld giornate, %d colonne (%s)\n", file, giorni, l.n_colonne,
+           l.csv ? "CSV" : "binario a colonne");
+    if (!l.csv)
+        printf("  Config: %d operatori, %d utenti, %d sportelli, %d servizi, seme %lu\n",
+               l.h.cfg.nof_workers, l.h.cfg.nof_users, l.h.cfg.num_sportelli, l.h.cfg.num_servizi,
+               (unsigned long)l.h.cfg.seme);
+    if (giorni == 0) return 0;
+
+    printf("\n  %-28s %14s %12s %14s %8s %14s %8s %16s\n",
+           "colonna", "media", "dev.std", "min", "giorno", "max", "giorno", "totale");
+    for (int c = 1; c < l.n_colonne; c++) {
+        if (!strncmp(l.nomi[c], "sportello_", 10)) continue;
+        const Colonna *k = &col[c];
+        printf("  %-28s %14.2f %12.2f %14ld %8ld %14ld %8ld %16ld\n", l.nomi[c], k->media,
+               k->n > 1 ? sqrt(k->m2 / (k->n - 1)) : 0.0, k->min, k->giorno_min, k->max, k->giorno_max, k->totale);
+    }
+
+    printf("\n  Medie mobili su %d giorni (giorno = ultimo della finestra)\n", w);
+    printf("  %-22s %12s %8s %12s %8s %12s\n", "metrica", "minima", "giorno", "massima", "giorno", "ultima");
+    for (int m = 0; m < NUM_MM; m++) {
+        if (!mm[m].valide) continue;
+        printf("  %-22s %12.2f %8ld %12.2f %8ld %12.2f\n", NOMI_MM[m], mm[m].migliore, mm[m].giorno_migliore,
+               mm[m].peggiore, mm[m].giorno_peggiore, mm[m].ultima);
+    }
+    if (giorni < w) printf("  (meno di %d giornate: nessuna finestra completa)\n", w);
+
+    for (int m = 0; m < NUM_MM; m++) { free(mm[m].num); free(mm[m].den); }
+    free(l.blocco);
+    free(l.linea);
+    return 0;
+}
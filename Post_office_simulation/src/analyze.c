@@ -0,0 +1,299 @@
+#include "common.h"
+#include "traccia.h"
+
+/*
+ * ANALYZE.C (Analizzatore offline della traccia binaria)
+ * * Uso: ./bin/analyze traccia.bin [--larghezza=W] [--csv=PREFISSO]
+ * Ricostruisce dalla sola traccia (senza rieseguire la simulazione):
+ * 1. Le Stats di ogni giornata, con le stesse regole del Direttore
+ *    (i residui in coda a fine giornata contano come non erogati, anche ogni giorno)
+ * 2. La lunghezza delle code nel tempo (sparkline per servizio)
+ * 3. Il diagramma di Gantt degli operatori ('#' servizio, '.' libero allo sportello, 'P' pausa)
+ * Con --csv scrive anche PREFISSO_code.csv (ogni variazione di coda) e
+ * PREFISSO_gantt.csv (intervalli di stato di ogni operatore)
+ */
+
+// Nomi dei tipi di evento di traccia.h, nello stesso ordine
+static const char *NOMI_TR[NUM_TR] = {
+    "APERTURA", "CHIUSURA", "FINE_GIORNATA", "TICKET", "ACCODA", "RESPINTO",
+    "PRELIEVO", "FINE_SERVIZIO", "PAUSA_INIZIO", "PAUSA_FINE", "SEDUTO", "ALZATO"
+};
+
+enum { ST_FUORI, ST_LIBERO, ST_SERVIZIO, ST_PAUSA };
+static const char SIMBOLI_STATO[] = " .#P";
+static const char *NOMI_STATO[] = {"fuori", "libero", "servizio", "pausa"};
+static const char LIVELLI[] = " .:-=+*#%@";
+
+typedef struct {
+    RecordTraccia r;
+    long ordine;            // Posizione nel file: a parità di tempo conserva l'ordine del ring
+} Evento;
+
+typedef struct {
+    long apertura, chiusura, fine;  // Istanti dei tre eventi del Direttore (0 se assenti)
+} Giornata;
+
+static int confronta(const void *a, const void *b) {
+    const Evento *x = a, *y = b;
+    if (x->r.t != y->r.t) return x->r.t < y->r.t ? -1 : 1;
+    return x->ordine < y->ordine ? -1 : (x->ordine > y->ordine);
+}
+
+// --- STATO CORRENTE DURANTE LA SCANSIONE ---
+typedef struct {
+    int n_op;
+    int *stato;             // Stato di ogni operatore
+    long *dal;              // Da quando è in quello stato (per il CSV del Gantt)
+    const Config *cfg;      // Config della simulazione (dalla testata): servizi e loro nomi
+    int coda[MAX_SERVIZI];  // Lunghezza delle code (ACCODA - PRELIEVO)
+    FILE *csv_code, *csv_gantt;
+    long t0;                // Origine dei tempi nei CSV (prima apertura)
+} Scansione;
+
+static void cambia_stato(Scansione *s, int op, int nuovo, long t) {
+    if (op < 0 || op >= s->n_op || s->stato[op] == nuovo) return;
+    if (s->csv_gantt && s->stato[op] != ST_FUORI)
+        fprintf(s->csv_gantt, "%d,%s,%.3f,%.3f\n", op, NOMI_STATO[s->stato[op]],
+                (s->dal[op] - s->t0) / 1e6, (t - s->t0) / 1e6);
+    s->stato[op] = nuovo;
+    s->dal[op] = t;
+}
+
+static void cambia_coda(Scansione *s, int servizio, int delta, long t) {
+    if (servizio < 0 || servizio >= s->cfg->num_servizi) return;
+    s->coda[servizio] += delta;
+    if (s->csv_code)
+        fprintf(s->csv_code, "%.3f,%d,%d\n", (t - s->t0) / 1e6, servizio, s->coda[servizio]);
+}
+
+// Applica un evento allo stato di operatori e code
+static void applica(Scansione *s, const RecordTraccia *r) {
+    switch (r->tipo) {
+        case TR_ACCODA:        cambia_coda(s, r->servizio, +1, r->t); break;
+        case TR_PRELIEVO:      cambia_coda(s, r->servizio, -1, r->t);
+                               cambia_stato(s, r->attore, ST_SERVIZIO, r->t); break;
+        case TR_FINE_SERVIZIO: cambia_stato(s, r->attore, ST_LIBERO, r->t); break;
+        case TR_SEDUTO:        cambia_stato(s, r->attore, ST_LIBERO, r->t); break;
+        case TR_PAUSA_INIZIO:  cambia_stato(s, r->attore, ST_PAUSA, r->t); break;
+        case TR_PAUSA_FINE:    cambia_stato(s, r->attore, r->valore ? ST_LIBERO : ST_FUORI, r->t); break;
+        case TR_ALZATO:        cambia_stato(s, r->attore, ST_FUORI, r->t); break;
+    }
+}
+
+// --- STATISTICHE DI GIORNATA ---
+// Eventi in (fine di ieri, fine di oggi]: la stessa finestra dello snapshot del Direttore.
+// *prossimo è il primo evento dopo la fine di ieri: ogni evento si legge una volta sola,
+// e code e ultime attese passano da un giorno all'altro in in_coda e ultima_attesa.
+// L'attesa si conta a FINE_SERVIZIO (come fa l'operatore), prendendola dall'ultimo
+// PRELIEVO dello stesso operatore, che può essere avvenuto anche il giorno prima
+static void stats_giornata(const Evento *ev, long n, long *prossimo, long a, Stats *g,
+                           long *in_coda, long *ultima_attesa, int n_op, int n_servizi) {
+    memset(g, 0, sizeof(Stats));
+    long i = *prossimo;
+    for (; i < n && ev[i].r.t <= a; i++) {
+        const RecordTraccia *r = &ev[i].r;
+        int op_valido = r->attore >= 0 && r->attore < n_op;
+        if (r->tipo == TR_PRELIEVO && op_valido) ultima_attesa[r->attore] = r->valore;
+        switch (r->tipo) {
+            case TR_ACCODA:        in_coda[r->servizio]++; break;
+            case TR_RESPINTO:      g->servizi_non_erogati++; break;
+            case TR_FINE_SERVIZIO:
+                g->utenti_serviti++;
+                g->servizi_erogati[r->servizio]++;
+                g->tempo_servizio_totale += r->valore;
+                if (op_valido) g->tempo_attesa_totale += ultima_attesa[r->attore];
+                in_coda[r->servizio]--;
+                break;
+            case TR_PAUSA_INIZIO:  g->pause_effettuate++; break;
+            case TR_SEDUTO:        g->operatori_attivi++; break;
+        }
+    }
+    *prossimo = i;
+    // Residui (in attesa o ancora allo sportello) come nel conteggio di in_attesa
+    for (int s = 0; s < n_servizi; s++) g->servizi_non_erogati += in_coda[s];
+}
+
+static void stampa_stats(const char *titolo, const Stats *s, int div, const Config *cfg) {
+    printf("\n=== %s ===\n", titolo);
+    printf("Utenti serviti: %ld (Media: %.2f)\n", s->utenti_serviti, (double)s->utenti_serviti / div);
+    printf("Servizi NON erogati: %ld (Persi)\n", s->servizi_non_erogati);
+    printf("Tempo medio attesa: %.0f ns\n",
+           s->utenti_serviti ? (double)s->tempo_attesa_totale / s->utenti_serviti : 0);
+    printf("Tempo medio servizio: %.0f ns\n",
+           s->utenti_serviti ? (double)s->tempo_servizio_totale / s->utenti_serviti : 0);
+    printf("Pause effettuate: %ld, operatori attivi: %ld\n", s->pause_effettuate, s->operatori_attivi);
+    printf("-- Dettaglio Servizi --\n");
+    for (int i = 0; i < cfg->num_servizi; i++) printf("  %s: %ld\n", cfg->servizi[i].nome, s->servizi_erogati[i]);
+}
+
+// --- TIMELINE E GANTT DI UNA GIORNATA ---
+// Divido [apertura, fine] in W colonne: per le code tengo il massimo della colonna,
+// per gli operatori lo stato a metà colonna. *cursore avanza sugli eventi già applicati
+static void disegna_giornata(Scansione *s, const Evento *ev, long n, long *cursore,
+                             const Giornata *g, int w) {
+    long inizio = g->apertura, fine = g->fine ? g->fine : ev[n - 1].r.t;
+    if (fine <= inizio) return;
+
+    // Eventi della notte precedente: aggiornano lo stato ma non vengono disegnati
+    while (*cursore < n && ev[*cursore].r.t < inizio) applica(s, &ev[(*cursore)++].r);
+
+    int ns = s->cfg->num_servizi;
+    int *massimi = calloc((size_t)w * ns, sizeof(int));
+    char *gantt = malloc((size_t)w * (s->n_op > 0 ? s->n_op : 1));
+    if (!massimi || !gantt) { perror("malloc"); exit(1); }
+
+    for (int c = 0; c < w; c++) {
+        long meta = inizio + (long)((c + 0.5) * (fine - inizio) / w);
+        long bordo = inizio + (long)((double)(c + 1) * (fine - inizio) / w);
+        for (int k = 0; k < ns; k++) massimi[c * ns + k] = s->coda[k];
+
+        int campionato = 0;
+        while (*cursore < n && ev[*cursore].r.t <= bordo) {
+            if (!campionato && ev[*cursore].r.t > meta) {
+                for (int op = 0; op < s->n_op; op++) gantt[op * w + c] = SIMBOLI_STATO[s->stato[op]];
+                campionato = 1;
+            }
+            applica(s, &ev[(*cursore)++].r);
+            for (int k = 0; k < ns; k++)
+                if (s->coda[k] > massimi[c * ns + k]) massimi[c * ns + k] = s->coda[k];
+        }
+        if (!campionato)
+            for (int op = 0; op < s->n_op; op++) gantt[op * w + c] = SIMBOLI_STATO[s->stato[op]];
+    }
+
+    printf("-- Code (massimo per colonna, %.1f ms ciascuna) --\n", (fine - inizio) / 1e6 / w);
+    for (int k = 0; k < ns; k++) {
+        int picco = 0;
+        for (int c = 0; c < w; c++) if (massimi[c * ns + k] > picco) picco = massimi[c * ns + k];
+        printf("  %-14s |", s->cfg->servizi[k].nome);
+        for (int c = 0; c < w; c++) {
+            int v = massimi[c * ns + k];
+            int livello = v <= 0 ? 0 : (int)(((long)v * (sizeof(LIVELLI) - 2) + picco - 1) / picco);
+            putchar(LIVELLI[livello]);
+        }
+        printf("| picco %d\n", picco);
+    }
+
+    printf("-- Gantt operatori ('#' servizio, '.' libero, 'P' pausa) --\n");
+    for (int op = 0; op < s->n_op; op++) {
+        printf("  [%3d]          |%.*s|\n", op, w, gantt + op * w);
+    }
+    free(massimi);
+    free(gantt);
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL, *prefisso = NULL;
+    int larghezza = 100;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--larghezza=", 12)) larghezza = atoi(argv[i] + 12);
+        else if (!strncmp(argv[i], "--csv=", 6)) prefisso = argv[i] + 6;
+        else if (argv[i][0] != '-') file = argv[i];
+        else { fprintf(stderr, "Opzione sconosciuta: %s\n", argv[i]); return 1; }
+    }
+    if (!file || larghezza < 1) {
+        fprintf(stderr, "Uso: %s traccia.bin [--larghezza=W] [--csv=PREFISSO]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(file, "rb");
+    if (!f) { perror("Apertura traccia"); return 1; }
+    TestataTraccia h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRACCIA_MAGIC, sizeof(h.magic)) ||
+        h.dimensione_record != (int)sizeof(RecordTraccia) ||
+        h.cfg.num_servizi < 1 || h.cfg.num_servizi > MAX_SERVIZI) {
+        fprintf(stderr, "%s: non è una traccia compatibile\n", file);
+        return 1;
+    }
+
+    // Carico tutti i record e li riordino per tempo (sul file sono raggruppati per ring)
+    long n = 0, cap = 1 << 16;
+    Evento *ev = malloc(cap * sizeof(Evento));
+    if (!ev) { perror("malloc"); return 1; }
+    while (fread(&ev[n].r, sizeof(RecordTraccia), 1, f) == 1) {
+        ev[n].ordine = n;
+        if (++n == cap) {
+            cap *= 2;
+            ev = realloc(ev, cap * sizeof(Evento));
+            if (!ev) { perror("realloc"); return 1; }
+        }
+    }
+    fclose(f);
+    if (n == 0) { fprintf(stderr, "%s: traccia vuota\n", file); return 1; }
+    qsort(ev, n, sizeof(Evento), confronta);
+
+    // Confini delle giornate dagli eventi del Direttore
+    int n_giorni = 0;
+    for (long i = 0; i < n; i++)
+        if (ev[i].r.tipo <= TR_FINE_GIORNATA && ev[i].r.ticket > n_giorni) n_giorni = ev[i].r.ticket;
+    Giornata *giorni = calloc(n_giorni + 1, sizeof(Giornata));
+    long conteggi[NUM_TR] = {0};
+    for (long i = 0; i < n; i++) {
+        const RecordTraccia *r = &ev[i].r;
+        if (r->tipo >= 0 && r->tipo < NUM_TR) conteggi[r->tipo]++;
+        if (r->tipo > TR_FINE_GIORNATA || r->ticket < 1) continue;
+        if (r->tipo == TR_APERTURA) giorni[r->ticket].apertura = r->t;
+        else if (r->tipo == TR_CHIUSURA) giorni[r->ticket].chiusura = r->t;
+        else giorni[r->ticket].fine = r->t;
+    }
+
+    printf("[Analyze] %s: %ld record, %d giorni, %d operatori, %d utenti\n",
+           file, n, n_giorni, h.cfg.nof_workers, h.cfg.nof_users);
+    printf("  Eventi:");
+    for (int t = 0; t < NUM_TR; t++) printf(" %s=%ld", NOMI_TR[t], conteggi[t]);
+    printf("\n");
+
+    Scansione s;
+    memset(&s, 0, sizeof(s));
+    s.n_op = h.cfg.nof_workers;
+    s.cfg = &h.cfg;
+    s.stato = calloc(s.n_op > 0 ? s.n_op : 1, sizeof(int));
+    s.dal = calloc(s.n_op > 0 ? s.n_op : 1, sizeof(long));
+    s.t0 = n_giorni >= 1 && giorni[1].apertura ? giorni[1].apertura : ev[0].r.t;
+    if (prefisso) {
+        char nome[512];
+        snprintf(nome, sizeof(nome), "%s_code.csv", prefisso);
+        s.csv_code = fopen(nome, "w");
+        snprintf(nome, sizeof(nome), "%s_gantt.csv", prefisso);
+        s.csv_gantt = fopen(nome, "w");
+        if (!s.csv_code || !s.csv_gantt) { perror("Apertura CSV"); return 1; }
+        fprintf(s.csv_code, "t_ms,servizio,lunghezza\n");
+        fprintf(s.csv_gantt, "operatore,stato,inizio_ms,fine_ms\n");
+    }
+
+    Stats totali;
+    memset(&totali, 0, sizeof(totali));
+    long in_coda[MAX_SERVIZI] = {0};
+    long *ultima_attesa = calloc(s.n_op > 0 ? s.n_op : 1, sizeof(long));
+    long cursore = 0, prossimo = 0;
+    int giorni_completi = 0;
+    for (int d = 1; d <= n_giorni; d++) {
+        if (!giorni[d].apertura) continue;
+        long fine = giorni[d].fine ? giorni[d].fine : ev[n - 1].r.t;
+
+        Stats g;
+        stats_giornata(ev, n, &prossimo, fine, &g, in_coda, ultima_attesa, s.n_op, h.cfg.num_servizi);
+        char titolo[64];
+        snprintf(titolo, sizeof(titolo), "GIORNO %d (dalla traccia)%s", d, giorni[d].fine ? "" : " [incompleto]");
+        stampa_stats(titolo, &g, 1, &h.cfg);
+        disegna_giornata(&s, ev, n, &cursore, &giorni[d], larghezza);
+
+        totali.utenti_serviti += g.utenti_serviti;
+        totali.servizi_non_erogati += g.servizi_non_erogati;
+        totali.tempo_attesa_totale += g.tempo_attesa_totale;
+        totali.tempo_servizio_totale += g.tempo_servizio_totale;
+        totali.pause_effettuate += g.pause_effettuate;
+        totali.operatori_attivi += g.operatori_attivi;
+        for (int k = 0; k < h.cfg.num_servizi; k++) totali.servizi_erogati[k] += g.servizi_erogati[k];
+        giorni_completi++;
+    }
+    if (giorni_completi) stampa_stats("TOTALI (dalla traccia)", &totali, giorni_completi, &h.cfg);
+
+    // Chiudo gli intervalli di Gantt ancora aperti
+    for (int op = 0; op < s.n_op; op++) cambia_stato(&s, op, ST_FUORI, ev[n - 1].r.t);
+    if (s.csv_code) fclose(s.csv_code);
+    if (s.csv_gantt) fclose(s.csv_gantt);
+
+    free(ev); free(giorni); free(s.stato); free(s.dal); free(ultima_attesa);
+    return 0;
+}
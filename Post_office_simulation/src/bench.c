@@ -0,0 +1,251 @@
+#include "common.h"
+#include "agenti.h"
+#include <sys/resource.h>
+
+/*
+ * BENCH.C (Suite di Benchmark, "make bench")
+ * * Due famiglie di misure, stampate come JSON Lines (un oggetto per riga) così i risultati
+ * di commit diversi si confrontano con un diff o con qualunque script:
+ * 1. Microbenchmark delle primitive usate dal simulatore (helper di common.h, round trip
+ *    MsgTicket con l'Erogatore vero in un processo figlio)
+ * 2. Sweep di scalabilità: per ogni combinazione di NOF_USERS x NOF_WORKERS x NANO_SECS
+ *    genero un file .conf, lancio ./bin/direttore e misuro tempo reale, utenti serviti/s,
+ *    CPU (Direttore + tutti i figli) e operazioni IPC/s
+ * * Scelta di design:
+ * Il Direttore a fine simulazione fa kill(0, SIGTERM) sul suo process group:
+ * ogni esecuzione dello sweep parte quindi in un gruppo proprio (setpgid), altrimenti
+ * il primo punto ucciderebbe anche il benchmark
+ */
+
+#define MAX_PUNTI 16
+
+typedef struct {
+    int n;
+    int v[MAX_PUNTI];
+} Lista;
+
+static const char *etichetta = "";      // --tag: di solito l'hash del commit
+
+// "50,200,500" -> lista di interi
+static void leggi_lista(const char *s, Lista *l) {
+    l->n = 0;
+    while (*s && l->n < MAX_PUNTI) {
+        l->v[l->n++] = atoi(s);
+        const char *virgola = strchr(s, ',');
+        if (!virgola) break;
+        s = virgola + 1;
+    }
+}
+
+static void stampa_micro(const char *op, long iterazioni, long ns_totali, int op_per_iterazione) {
+    double ns_op = (double)ns_totali / ((double)iterazioni * op_per_iterazione);
+    printf("{\"tipo\":\"micro\",\"tag\":\"%s\",\"op\":\"%s\",\"iterazioni\":%ld,"
+           "\"ns_op\":%.1f,\"op_s\":%.0f}\n",
+           etichetta, op, iterazioni, ns_op, ns_op > 0 ? 1e9 / ns_op : 0);
+    fflush(stdout);
+}
+
+// --- MICROBENCHMARK ---
+
+static void micro_semafori(long n) {
+    int sem = semget(IPC_PRIVATE, 2, IPC_CREAT | 0600);
+    if (sem < 0) { perror("semget"); exit(1); }
+    semctl(sem, 0, SETVAL, 1);
+    semctl(sem, 1, SETVAL, 0);
+
+    // P + V non contesi: il costo minimo di SEM_MUTEX e delle code dei servizi
+    long t0 = adesso_ns();
+    for (long i = 0; i < n; i++) { P(sem, 0); V(sem, 0); }
+    stampa_micro("sem_op P+V", n, adesso_ns() - t0, 2);
+
+    // sem_nowait riuscita (l'operatore trova un cliente)
+    t0 = adesso_ns();
+    for (long i = 0; i < n; i++) { sem_nowait(sem, 0, -1); V(sem, 0); }
+    stampa_micro("sem_nowait ok + V", n, adesso_ns() - t0, 2);
+
+    // sem_nowait fallita con EAGAIN (l'operatore trova la coda vuota)
+    t0 = adesso_ns();
+    for (long i = 0; i < n; i++) sem_nowait(sem, 1, -1);
+    stampa_micro("sem_nowait EAGAIN", n, adesso_ns() - t0, 1);
+
+    // Ping-pong tra due processi: include risveglio e cambio di contesto
+    semctl(sem, 0, SETVAL, 0);
+    long giri = n / 10 > 0 ? n / 10 : 1;
+    pid_t figlio = fork();
+    if (figlio == 0) {
+        for (long i = 0; i < giri; i++) { P(sem, 0); V(sem, 1); }
+        _exit(0);
+    }
+    t0 = adesso_ns();
+    for (long i = 0; i < giri; i++) { V(sem, 0); P(sem, 1); }
+    stampa_micro("sem ping-pong tra processi", giri, adesso_ns() - t0, 1);
+    waitpid(figlio, NULL, 0);
+
+    semctl(sem, 0, IPC_RMID);
+}
+
+static void micro_msg(long n) {
+    int msg = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    if (msg < 0) { perror("msgget"); exit(1); }
+
+    // Erogatore vero in un processo figlio: termina da solo su EIDRM
+    pid_t figlio = fork();
+    if (figlio == 0) { erogatore_esegui(msg); _exit(0); }
+
+    long giri = n / 10 > 0 ? n / 10 : 1;
+    MsgTicket m;
+    long t0 = adesso_ns();
+    for (long i = 0; i < giri; i++) {
+        m = (MsgTicket){1, getpid(), 0, 0};
+        msgsnd(msg, &m, sizeof(MsgTicket) - sizeof(long), 0);
+        msgrcv(msg, &m, sizeof(MsgTicket) - sizeof(long), getpid(), 0);
+    }
+    stampa_micro("MsgTicket round trip", giri, adesso_ns() - t0, 1);
+
+    msgctl(msg, IPC_RMID, NULL);
+    waitpid(figlio, NULL, 0);
+}
+
+static void micro_lock_free(long n) {
+    // Ticket della via TICKET_SHM
+    unsigned int contatore = 0;
+    long t0 = adesso_ns();
+    for (long i = 0; i < n; i++) __atomic_add_fetch(&contatore, 1, __ATOMIC_RELAXED);
+    stampa_micro("ticket atomico", n, adesso_ns() - t0, 1);
+
+    // Coda ticket di un servizio (utente -> operatore)
+    CodaTicket *c = aligned_alloc(LINEA_CACHE, sizeof(CodaTicket)); // Indici su linee proprie
+    if (!c) { perror("malloc"); exit(1); }
+    coda_init(c);
+    int ticket; long t;
+    t0 = adesso_ns();
+    for (long i = 0; i < n; i++) { coda_push(c, (int)i, i); coda_pop(c, &ticket, &t); }
+    stampa_micro("coda_push + coda_pop", n, adesso_ns() - t0, 2);
+    free(c);
+}
+
+static void micro_rng(long n) {
+    // rand() di glibc (stato globale protetto da lock) contro il flusso privato degli attori
+    volatile int pozzo = 0;
+    long t0 = adesso_ns();
+    for (long i = 0; i < n; i++) pozzo += rand() % 100;
+    stampa_micro("rand() % 100", n, adesso_ns() - t0, 1);
+
+    Rng rng;
+    rng_init(&rng, 42, FLUSSO_UTENTE(0));
+    t0 = adesso_ns();
+    for (long i = 0; i < n; i++) pozzo += rng_intero(&rng, 100);
+    stampa_micro("rng_intero(100) xoshiro256**", n, adesso_ns() - t0, 1);
+    (void)pozzo;
+}
+
+// --- SWEEP DI SCALABILITÀ ---
+
+// Valore intero che segue "chiave" nella riga (0 se assente)
+static long valore_dopo(const char *riga, const char *chiave) {
+    const char *p = strstr(riga, chiave);
+    return p ? atol(p + strlen(chiave)) : 0;
+}
+
+static void punto_sweep(const char *engine, int giorni, int utenti, int operatori, int nano) {
+    char conf[] = "/tmp/bench_XXXXXX.conf";
+    int fd = mkstemps(conf, 5);
+    if (fd < 0) { perror("mkstemps"); exit(1); }
+    FILE *f = fdopen(fd, "w");
+    fprintf(f, "SIM_DURATION=%d\nEXPLODE_THRESHOLD=%d\nNOF_WORKERS=%d\nNOF_USERS=%d\n"
+               "NOF_PAUSE=3\nNANO_SECS=%d\nP_SERV_MIN=20\nP_SERV_MAX=80\n",
+            giorni, INT_MAX, operatori, utenti, nano);
+    fclose(f);
+
+    int tubo[2];
+    if (pipe(tubo) < 0) { perror("pipe"); exit(1); }
+
+    char opt_engine[32];
+    snprintf(opt_engine, sizeof(opt_engine), "--engine=%s", engine);
+
+    long t0 = adesso_ns();
+    pid_t figlio = fork();
+    if (figlio == 0) {
+        setpgid(0, 0);      // Gruppo proprio: il kill(0) del Direttore non mi raggiunge
+        dup2(tubo[1], STDOUT_FILENO);
+        close(tubo[0]); close(tubo[1]);
+        execl("./bin/direttore", "direttore", opt_engine, conf, (char *)NULL);
+        perror("Exec direttore fallita"); _exit(1);
+    }
+    close(tubo[1]);
+
+    // Leggo il report finale del Direttore: mi servono i totali
+    long serviti = 0, ipc_ops = 0;
+    int totali = 0;
+    char riga[256];
+    FILE *out = fdopen(tubo[0], "r");
+    while (fgets(riga, sizeof(riga), out)) {
+        if (strstr(riga, "STATISTICHE TOTALI")) totali = 1;
+        if (!totali) continue;
+        if (strstr(riga, "Utenti serviti:")) serviti = valore_dopo(riga, "Utenti serviti:");
+        else if (strstr(riga, "Operazioni IPC:")) ipc_ops = valore_dopo(riga, "Operazioni IPC:");
+    }
+    fclose(out);
+
+    int stato;
+    struct rusage ru;
+    wait4(figlio, &stato, 0, &ru);
+    double secondi = (adesso_ns() - t0) / 1e9;
+
+    // Su Linux wait4 riporta la CPU del Direttore PIÙ quella dei figli che ha raccolto
+    // (la sua cleanup fa wait su tutti): è la CPU dell'intera simulazione
+    double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    int processi = !strcmp(engine, "ipc") ? 1 + operatori + utenti : 1;
+
+    // Le operazioni IPC le conta la simulazione stessa (contesa.operazioni_ipc): ogni semop,
+    // msgsnd e msgrcv degli attori, compresi i tentativi degli operatori a coda vuota
+
+    unlink(conf);
+    printf("{\"tipo\":\"sweep\",\"tag\":\"%s\",\"engine\":\"%s\",\"giorni\":%d,\"utenti\":%d,"
+           "\"operatori\":%d,\"nano_secs\":%d,\"esito\":%d,\"wall_s\":%.3f,\"serviti\":%ld,"
+           "\"serviti_s\":%.1f,\"cpu_s\":%.3f,\"cpu_s_processo\":%.5f,\"ipc_ops\":%ld,\"ipc_ops_s\":%.1f}\n",
+           etichetta, engine, giorni, utenti, operatori, nano,
+           WIFEXITED(stato) ? WEXITSTATUS(stato) : -1, secondi, serviti,
+           serviti / secondi, cpu, cpu / processi, ipc_ops, ipc_ops / secondi);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    // Griglia di default: piccola, ogni punto "ipc" dura DAY_MINUTES x NANO_SECS per giorno
+    // (48 o 240 ms) più lo smaltimento e l'avvio
+    Lista utenti, operatori, nano;
+    leggi_lista("50,200,500", &utenti);
+    leggi_lista("5,20", &operatori);
+    leggi_lista("100000,500000", &nano);
+    const char *engine = "ipc";
+    int giorni = 1, micro = 1, sweep = 1;
+    long iterazioni = 200000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--users=", 8)) leggi_lista(argv[i] + 8, &utenti);
+        else if (!strncmp(argv[i], "--workers=", 10)) leggi_lista(argv[i] + 10, &operatori);
+        else if (!strncmp(argv[i], "--nanos=", 8)) leggi_lista(argv[i] + 8, &nano);
+        else if (!strncmp(argv[i], "--days=", 7)) giorni = atoi(argv[i] + 7);
+        else if (!strncmp(argv[i], "--engine=", 9)) engine = argv[i] + 9;
+        else if (!strncmp(argv[i], "--iter=", 7)) iterazioni = atol(argv[i] + 7);
+        else if (!strncmp(argv[i], "--tag=", 6)) etichetta = argv[i] + 6;
+        else if (!strcmp(argv[i], "--micro")) sweep = 0;
+        else if (!strcmp(argv[i], "--sweep")) micro = 0;
+        else { fprintf(stderr, "Opzione sconosciuta: %s\n", argv[i]); exit(1); }
+    }
+
+    if (micro) {
+        micro_semafori(iterazioni);
+        micro_msg(iterazioni);
+        micro_lock_free(iterazioni);
+        micro_rng(iterazioni);
+    }
+
+    if (sweep) {
+        for (int u = 0; u < utenti.n; u++)
+            for (int o = 0; o < operatori.n; o++)
+                for (int s = 0; s < nano.n; s++)
+                    punto_sweep(engine, giorni, utenti.v[u], operatori.v[o], nano.v[s]);
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * CHECKPOINT.C (Fotografia di fine giornata e ripresa: --checkpoint=FILE, --resume)
+ * * Tutto lo stato dell'ufficio vive nel segmento SHM, che la cleanup distrugge: senza
+ * checkpoint una simulazione lunga interrotta al giorno 90 riparte dal giorno 1
+ * * A fine giornata (attori fermi a ufficio chiuso, statistiche già raccolte) il Direttore
+ * scrive in un solo file:
+ * - testata: giorno completato, Config, flusso casuale e memoria della politica sportelli
+ * - immagine del segmento: Stats totali, slot operatori, istogrammi, code con i ticket
+ *   rimasti per la notte. È la SHM byte per byte: il layout usa solo offset, niente puntatori
+ * - stato privato del motore (solo DES: orologio, eventi, operatori, utenti, code)
+ * * Le sezioni sono allineate alla pagina e le pagine dell'immagine tutte a zero (code vuote,
+ * bucket mai toccati, slot operatori inutilizzati) non vengono scritte: il file è sparso,
+ * quindi piccolo su disco, ma si mappa lo stesso con mmap. Alla ripresa l'immagine si copia
+ * nel segmento nuovo con una memcpy, senza parsing
+ */
+
+// Scrive n byte (write può essere parziale su file grandi)
+static int scrivi_tutto(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static size_t arrotonda_pagina(size_t n, size_t pagina) {
+    return (n + pagina - 1) / pagina * pagina;
+}
+
+// Scrive l'immagine saltando le pagine a zero (restano buchi del file sparso)
+static int scrivi_sparso(int fd, const char *p, size_t n, size_t pagina) {
+    for (size_t i = 0; i < n; i += pagina) {
+        size_t k = n - i < pagina ? n - i : pagina;
+        size_t j = 0;
+        while (j < k && !p[i + j]) j++;
+        if (j == k) {
+            if (lseek(fd, (off_t)k, SEEK_CUR) < 0) return -1;
+        } else if (scrivi_tutto(fd, p + i, k) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int checkpoint_scrivi(const char *file, const char *engine, int giorno, const SharedData *shm,
+                      const Rng *rng_sportelli, const void *motore, size_t dim_motore) {
+    size_t pagina = (size_t)sysconf(_SC_PAGESIZE);
+    TestataCheckpoint t;
+    memset(&t, 0, sizeof(t));
+    memcpy(t.magic, CHECKPOINT_MAGIC, sizeof(t.magic));
+    snprintf(t.engine, sizeof(t.engine), "%s", engine);
+    t.giorno = giorno;
+    t.t_ns = adesso_ns();
+    t.off_shm = arrotonda_pagina(sizeof(t), pagina);
+    t.dim_shm = shm_dimensione(&shm->cfg);
+    t.off_motore = t.off_shm + arrotonda_pagina(t.dim_shm, pagina);
+    t.dim_motore = dim_motore;
+    t.rng_sportelli = *rng_sportelli;
+    t.memoria = memoria_sportelli;
+    t.cfg = shm->cfg;
+
+    // Scrivo accanto e poi rinomino: chi legge vede il checkpoint vecchio o quello nuovo intero
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { fprintf(stderr, "[Direttore] Checkpoint %s: %s\n", tmp, strerror(errno)); return -1; }
+    int err = scrivi_tutto(fd, &t, sizeof(t)) < 0
+           || lseek(fd, (off_t)t.off_shm, SEEK_SET) < 0
+           || scrivi_sparso(fd, (const char *)shm, t.dim_shm, pagina) < 0
+           || lseek(fd, (off_t)t.off_motore, SEEK_SET) < 0
+           || (dim_motore && scrivi_tutto(fd, motore, dim_motore) < 0)
+           || ftruncate(fd, (off_t)(t.off_motore + dim_motore)) < 0; // Buchi finali compresi
+    if (close(fd) < 0) err = 1;
+    if (err || rename(tmp, file) < 0) {
+        fprintf(stderr, "[Direttore] Checkpoint %s: %s\n", file, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int checkpoint_apri(const char *file, Checkpoint *c) {
+    memset(c, 0, sizeof(*c));
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) { fprintf(stderr, "[Direttore] Checkpoint %s: %s\n", file, strerror(errno)); return -1; }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TestataCheckpoint)) {
+        fprintf(stderr, "[Direttore] Checkpoint %s: file troppo corto\n", file);
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // La mappatura resta valida
+    if (m == MAP_FAILED) { fprintf(stderr, "[Direttore] mmap %s: %s\n", file, strerror(errno)); return -1; }
+    c->dim_mappa = (size_t)st.st_size;
+    c->t = m;
+
+    // Il file deve essere di questa versione e di questa build: l'immagine si copia così com'è
+    const TestataCheckpoint *t = c->t;
+    const char *errore = NULL;
+    if (memcmp(t->magic, CHECKPOINT_MAGIC, sizeof(t->magic))) errore = "formato sconosciuto";
+    else if (t->dim_shm != shm_dimensione(&t->cfg)) errore = "layout della SHM diverso da questa build";
+    else if (t->off_shm + t->dim_shm > c->dim_mappa || t->off_motore + t->dim_motore > c->dim_mappa)
+        errore = "file troncato";
+    else if (t->giorno < 1 || t->giorno >= t->cfg.sim_duration) errore = "giorno fuori dalla simulazione";
+    if (errore) {
+        fprintf(stderr, "[Direttore] Checkpoint %s: %s\n", file, errore);
+        checkpoint_chiudi(c);
+        return -1;
+    }
+    c->shm = (const SharedData *)((const char *)m + t->off_shm);
+    c->motore = t->dim_motore ? (const char *)m + t->off_motore : NULL;
+    return 0;
+}
+
+void checkpoint_chiudi(Checkpoint *c) {
+    if (c->t) munmap((void *)c->t, c->dim_mappa);
+    memset(c, 0, sizeof(*c));
+}
+
+int checkpoint_ripristina(SharedData *shm, const Checkpoint *c, Rng *rng_sportelli) {
+    const TestataCheckpoint *t = c->t;
+    int traccia = shm->cfg.traccia; // La traccia è un'opzione di questa esecuzione
+    memcpy(shm, c->shm, t->dim_shm);
+    shm_layout(shm, &shm->cfg);
+    shm->cfg.traccia = traccia;
+
+    // Ufficio chiuso, nessuno seduto né in attesa di uno sportello: gli attori sono nuovi
+    shm->ufficio_aperto = 0;
+    shm->stop_simulation = 0;
+    shm->generazione_stato = 0;
+    shm->processi_pronti = 0;
+    shm->operatori_in_turno = 0;
+    shm->apertura_ns = shm->chiusura_ns = 0;
+    shm->giorno_ripresa = t->giorno;
+    for (int i = 0; i < MAX_OPERATORI; i++) shm->slot_operatori[i].posto = POSTO_NESSUNO;
+    for (int i = 0; i < shm->cfg.num_sportelli; i++) shm_sportello(shm, i)->occupato = 0;
+
+    // I ticket rimasti in coda portano l'istante di accodamento sull'orologio di chi ha
+    // scritto il checkpoint: li sposto sul mio, come se tra le due esecuzioni non fosse passato tempo
+    long spostamento = adesso_ns() - t->t_ns;
+    for (int s = 0; s < shm->cfg.num_servizi; s++) {
+        ServizioCondiviso *sv = shm_servizio(shm, s);
+        sv->sportelli_liberi = 0;
+        memset(sv->operatori_in_attesa, 0, sizeof(sv->operatori_in_attesa));
+        for (unsigned int pos = sv->coda.testa; pos != sv->coda.coda; pos++)
+            sv->coda.slot[pos & (CAPIENZA_CODA - 1)].t_ingresso += spostamento;
+    }
+
+    *rng_sportelli = t->rng_sportelli;
+    memoria_sportelli = t->memoria;
+    riprendi_contabilita(shm);
+    return t->giorno + 1;
+}
@@ -0,0 +1,645 @@
+#include "common.h"
+#include "direttore.h"
+#include "esporta.h"
+
+/*
+ * DES.C (Motore a Eventi Discreti)
+ * * Alternativa al motore "ipc" (selezionata con --engine=des):
+ * - Gli stessi attori (Direttore, Erogatore, Operatori, Utenti) non sono processi che
+ *   dormono con sleep/usleep, ma stati in memoria guidati da uno scheduler
+ * - Lo scheduler è una coda di priorità (min-heap) di eventi sul tempo SIMULATO in minuti
+ * - Tra un evento e l'altro non passa tempo reale: la simulazione va alla velocità della CPU
+ * * Scelta di design:
+ * Le regole sono quelle dei processi reali (70% sportelli aperti, P_SERV, arrivo entro 30 min,
+ * durata = base +/- base/2, pausa al 5%, code che sopravvivono alla notte, giornata chiusa
+ * quando l'ultimo operatore è uscito). Giornata e grazia sono già in minuti (DAY_MINUTES,
+ * CLOSE_MINUTES) e le statistiche in ns "equivalenti" tramite nano_secs_per_min, per avere
+ * lo stesso output.
+ * * La pausa si tira a ogni giro del loop dell'operatore, come in operatore.c: anche a coda
+ * vuota, dove l'operatore reale dorme POLLING_OPERATORE_US e riprova. Un operatore libero
+ * ha quindi un EV_POLLING ogni POLLING_OPERATORE_US (in minuti simulati) finché ha pause
+ * da fare: senza, a parità di SEED il DES farebbe molte meno pause dei motori reali
+ * * Con ARRIVALS diverso da 0 gli utenti non hanno eventi propri: a ogni apertura parte una
+ * catena di EV_LOTTO, ognuno genera dalla Popolazione gli arrivi della sua finestra e li
+ * mette nell'heap come EV_ARRIVO_POP (id = posizione nel lotto)
+ */
+
+// --- EVENTI ---
+enum { EV_APERTURA, EV_CHIUSURA, EV_FINE_GIORNATA, EV_ARRIVO, EV_FINE_SERVIZIO, EV_FINE_PAUSA,
+       EV_LOTTO, EV_ARRIVO_POP, EV_POLLING };
+
+typedef struct {
+    double t;               // Istante simulato (minuti)
+    unsigned long seq;      // Ordine di inserimento: rende deterministico l'ordine a parità di t
+    int tipo;
+    int id;                 // Utente o Operatore a cui si riferisce
+    unsigned int gen;       // Generazione dell'operatore: eventi con gen vecchia sono annullati
+} Evento;
+
+// Min-heap binario sugli eventi (ordinati per t, poi per seq)
+typedef struct {
+    Evento *v;
+    int n, cap;
+    unsigned long seq;
+} Heap;
+
+static int prima(const Evento *a, const Evento *b) {
+    return a->t < b->t || (a->t == b->t && a->seq < b->seq);
+}
+
+static void heap_push(Heap *h, double t, int tipo, int id, unsigned int gen) {
+    if (h->n == h->cap) {
+        h->cap = h->cap ? h->cap * 2 : 1024;
+        h->v = realloc(h->v, h->cap * sizeof(Evento));
+        if (!h->v) { perror("realloc"); exit(1); }
+    }
+    Evento e = {t, h->seq++, tipo, id, gen};
+    int i = h->n++;
+    while (i > 0 && prima(&e, &h->v[(i - 1) / 2])) {
+        h->v[i] = h->v[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->v[i] = e;
+}
+
+static Evento heap_pop(Heap *h) {
+    Evento top = h->v[0], last = h->v[--h->n];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && prima(&h->v[c + 1], &h->v[c])) c++;
+        if (!prima(&h->v[c], &last)) break;
+        h->v[i] = h->v[c];
+        i = c;
+    }
+    if (h->n > 0) h->v[i] = last;
+    return top;
+}
+
+// --- CODE DEI SERVIZI ---
+// Buffer circolare (crescente) con l'istante di accodamento di ogni ticket
+// Serve per misurare l'attesa vera al momento della chiamata allo sportello
+typedef struct {
+    double *v;
+    int testa, n, cap;
+} Fifo;
+
+static void fifo_cresci(Fifo *f) {
+    int cap = f->cap ? f->cap * 2 : 64;
+    double *v = malloc(cap * sizeof(double));
+    if (!v) { perror("malloc"); exit(1); }
+    for (int i = 0; i < f->n; i++) v[i] = f->v[(f->testa + i) % f->cap];
+    free(f->v);
+    f->v = v; f->cap = cap; f->testa = 0;
+}
+
+static void fifo_push(Fifo *f, double t) {
+    if (f->n == f->cap) fifo_cresci(f);
+    f->v[(f->testa + f->n++) % f->cap] = t;
+}
+
+static double fifo_pop(Fifo *f) {
+    double t = f->v[f->testa];
+    f->testa = (f->testa + 1) % f->cap;
+    f->n--;
+    return t;
+}
+
+// --- ATTORI ---
+enum { OP_FUORI, OP_ATTESA_POSTO, OP_LIBERO, OP_SERVIZIO, OP_PAUSA };
+
+typedef struct {
+    int skill;              // Servizio in cui è specializzato
+    unsigned int competenze;    // Servizi che sa erogare (bitmask, include skill)
+    int servizio;           // Servizio del cliente in corso (diverso da quello dello sportello se rubato)
+    double seduto_da;       // Istante in cui si è seduto (per l'utilizzo)
+    int seat;               // Sportello occupato (-1 se nessuno)
+    int stato;
+    int pause_rimanenti;
+    unsigned int gen;
+    double attesa;          // Attesa (minuti) del cliente in servizio
+    double durata;          // Durata (minuti) del servizio in corso
+    double accodato;        // Istante di accodamento del cliente in servizio
+    double polling;         // Istante dell'EV_POLLING valido (gli altri in coda sono superati)
+    Rng rng;                // Stesso flusso dell'operatore i nei motori reali
+} Operatore;
+
+typedef struct {
+    const Config *cfg;
+    const Opzioni *o;       // --checkpoint: fotografia a fine giornata
+    SharedData *shm;        // Stessa struct del motore ipc, ma in memoria privata
+    Heap heap;
+    Fifo code[MAX_SERVIZI];
+    Operatore *op;
+    int *p_serv;            // Probabilità P_SERV di ogni utente
+    Rng *rng_utenti;        // Flusso di ogni utente (FLUSSO_UTENTE)
+    Popolazione *pop;       // Arrivi generati (ARRIVALS diverso da 0), altrimenti NULL
+    LottoArrivi lotto;      // Lotto corrente: gli EV_ARRIVO_POP in coda puntano qui dentro
+    double apertura;        // Apertura di oggi (minuti): i lotti contano da qui
+    Rng rng_sportelli;      // Flusso del Direttore (FLUSSO_SPORTELLI)
+    double ora;             // Orologio virtuale (minuti)
+    double giornata_min, chiusura_min;
+    double polling_min;     // POLLING_OPERATORE_US in minuti simulati
+    double chiuso_alle;     // Chiusura di oggi (minuti): la grazia scade a chiuso_alle + chiusura_min
+    int fine_programmata;   // EV_FINE_GIORNATA di oggi già in coda
+    int giorno;
+    int ticket;             // Contatore dell'Erogatore
+    long eventi;
+} Des;
+
+// Servizi serviti dall'operatore dal suo sportello (stessa regola di operatore.c)
+static unsigned int servibili(Des *d, int id) {
+    Operatore *o = &d->op[id];
+    unsigned int proprio = 1u << shm_sportello(d->shm, o->seat)->servizio;
+    return d->cfg->politica_furto == FURTO_NESSUNO ? proprio : (o->competenze | proprio);
+}
+
+// Orologio virtuale in ns equivalenti (tempo libero degli sportelli, come nei motori reali)
+static long ora_ns(Des *d) {
+    return (long)(d->ora * d->cfg->nano_secs_per_min);
+}
+
+// Aggiunge allo slot dell'operatore il tempo (in ns equivalenti) passato seduto
+static void alzati(Des *d, int id) {
+    d->shm->slot_operatori[id].ns_al_posto +=
+        (long)((d->ora - d->op[id].seduto_da) * d->shm->cfg.nano_secs_per_min);
+}
+
+// L'operatore cerca uno sportello libero: prima la specializzazione, poi le altre competenze
+// Stesse bitmask dei liberi dei motori reali (nessun PID reale: come occupante uso l'indice + 1)
+static int occupa_posto(Des *d, int id) {
+    SharedData *shm = d->shm;
+    Operatore *o = &d->op[id];
+    int seat = sportello_prendi(shm, 1u << o->skill, id + 1, ora_ns(d));
+    if (seat == -1) seat = sportello_prendi(shm, o->competenze, id + 1, ora_ns(d));
+    if (seat == -1) return 0;
+    shm->stats_giornaliere.operatori_attivi++;
+    o->seat = seat;
+    o->seduto_da = d->ora;
+    o->stato = OP_LIBERO;
+    return 1;
+}
+
+static void lavora(Des *d, int id);
+
+// Libera lo sportello e, se un collega della stessa specializzazione aspetta, glielo passa
+static void libera_posto(Des *d, int seat) {
+    shm_sportello(d->shm, seat)->occupato = 0;
+    sportello_pubblica(d->shm, seat, ora_ns(d));
+    if (!d->shm->ufficio_aperto) return;
+    int servizio = shm_sportello(d->shm, seat)->servizio;
+    for (int j = 0; j < d->cfg->nof_workers; j++) {
+        if (d->op[j].stato == OP_ATTESA_POSTO && ((d->op[j].competenze >> servizio) & 1)) {
+            if (occupa_posto(d, j)) {
+                d->shm->contesa.consegne_posto++;
+                lavora(d, j);
+            }
+            return;
+        }
+    }
+}
+
+// A ufficio chiuso la giornata finisce appena tutti gli operatori sono usciti
+// (come il Direttore dei motori reali che dorme su operatori_in_turno)
+static void forse_fine_giornata(Des *d) {
+    if (d->shm->ufficio_aperto || d->fine_programmata) return;
+    for (int i = 0; i < d->cfg->nof_workers; i++)
+        if (d->op[i].stato != OP_FUORI) return;
+    d->fine_programmata = 1;
+    heap_push(&d->heap, d->ora, EV_FINE_GIORNATA, 0, 0);
+}
+
+static void lascia_ufficio(Des *d, int id) {
+    Operatore *o = &d->op[id];
+    if (o->seat != -1) {
+        int seat = o->seat;
+        alzati(d, id);
+        o->seat = -1;
+        libera_posto(d, seat);
+    }
+    o->stato = OP_FUORI;
+    forse_fine_giornata(d);
+}
+
+// Un giro del loop di lavoro dell'operatore seduto (stessa logica di operatore.c)
+static void lavora(Des *d, int id) {
+    Operatore *o = &d->op[id];
+    SharedData *shm = d->shm;
+
+    // Dopo la chiusura niente pause, e clienti dalla coda residua solo entro la grazia
+    if (!shm->ufficio_aperto && d->ora >= d->chiuso_alle + d->chiusura_min) {
+        lascia_ufficio(d, id);
+        return;
+    }
+
+    // GESTIONE PAUSA: libero la sedia e torno tra 10 minuti
+    if (o->pause_rimanenti > 0 && shm->ufficio_aperto && rng_intero(&o->rng, 100) < 5) {
+        int seat = o->seat;
+        o->stato = OP_PAUSA;
+        o->pause_rimanenti--;
+        shm->stats_giornaliere.pause_effettuate++;
+        alzati(d, id);
+        libera_posto(d, seat);
+        o->seat = seat; // Ricordo lo sportello da cui mi sono alzato
+        heap_push(&d->heap, d->ora + 10, EV_FINE_PAUSA, id, o->gen);
+        return;
+    }
+
+    // PRELIEVO CLIENTE: prima la coda dello sportello, poi (se permesso) il furto
+    int servizio = shm_sportello(shm, o->seat)->servizio;
+    if (d->code[servizio].n == 0 && d->cfg->politica_furto != FURTO_NESSUNO) {
+        int lunghezze[MAX_SERVIZI];
+        for (int s = 0; s < d->cfg->num_servizi; s++) lunghezze[s] = d->code[s].n;
+        int altra = scegli_coda(lunghezze, d->cfg->num_servizi, servibili(d, id) & ~(1u << servizio),
+                                d->cfg->politica_furto, &o->rng);
+        if (altra != -1) servizio = altra;
+    }
+    Fifo *f = &d->code[servizio];
+    if (f->n > 0) {
+        int base = d->cfg->servizi[servizio].minuti;
+        int duration_min = base + rng_intero(&o->rng, base) - (base/2);
+        if (duration_min < 1) duration_min = 1;
+
+        o->servizio = servizio;
+        o->accodato = fifo_pop(f);
+        o->attesa = d->ora - o->accodato;
+        o->durata = duration_min;
+        o->stato = OP_SERVIZIO;
+        heap_push(&d->heap, d->ora + duration_min, EV_FINE_SERVIZIO, id, o->gen);
+        return;
+    }
+
+    // Coda vuota: se l'ufficio è chiuso il turno è finito, altrimenti aspetto un cliente
+    // (e, se ho ancora pause, al prossimo polling ritiro la pausa come l'operatore reale)
+    if (!shm->ufficio_aperto) {
+        lascia_ufficio(d, id);
+        return;
+    }
+    o->stato = OP_LIBERO;
+    if (o->pause_rimanenti > 0) {
+        o->polling = d->ora + d->polling_min;
+        heap_push(&d->heap, o->polling, EV_POLLING, id, o->gen);
+    }
+}
+
+// --- GESTORI DEGLI EVENTI ---
+
+static void ev_apertura(Des *d) {
+    SharedData *shm = d->shm;
+    if (!d->o->silenzioso) printf("\n--- Giorno %d Inizio ---\n", d->giorno);
+
+    assegna_sportelli(shm, &d->rng_sportelli); // Legge ancora le stats di ieri
+    memset(&shm->stats_giornaliere, 0, sizeof(Stats));
+    shm->apertura_ns = ora_ns(d);
+    shm->ufficio_aperto = 1;
+
+    // Gli operatori entrano e competono per gli sportelli
+    for (int i = 0; i < d->cfg->nof_workers; i++) {
+        Operatore *o = &d->op[i];
+        o->gen++;
+        o->seat = -1;
+        o->stato = OP_ATTESA_POSTO;
+        if (occupa_posto(d, i)) lavora(d, i);
+        else shm->contesa.attese_posto++;
+    }
+
+    // Ogni utente stabilisce il suo orario di arrivo (entro 30 minuti, come utente.c)
+    // Con la popolazione il primo lotto copre l'inizio della giornata
+    d->apertura = d->ora;
+    for (int u = 0; u < utenti_agenti(d->cfg); u++)
+        heap_push(&d->heap, d->ora + rng_intero(&d->rng_utenti[u], 30), EV_ARRIVO, u, 0);
+    if (d->pop) heap_push(&d->heap, d->ora, EV_LOTTO, 0, 0);
+
+    heap_push(&d->heap, d->ora + d->giornata_min, EV_CHIUSURA, 0, 0);
+}
+
+// Ticket dall'Erogatore, ingresso in coda e risveglio di un operatore
+static void accoda(Des *d, int servizio) {
+    SharedData *shm = d->shm;
+    d->ticket++;
+    fifo_push(&d->code[servizio], d->ora);
+    shm_servizio(shm, servizio)->in_attesa++;
+
+    // Sveglio un operatore seduto e libero: prima chi è allo sportello di quel servizio,
+    // poi (col furto attivo) un collega che lo sa erogare
+    for (int giro = 0; giro < 2; giro++) {
+        for (int i = 0; i < d->cfg->nof_workers; i++) {
+            Operatore *o = &d->op[i];
+            if (o->stato != OP_LIBERO) continue;
+            int adatto = giro == 0 ? shm_sportello(shm, o->seat)->servizio == servizio
+                                   : ((servibili(d, i) >> servizio) & 1);
+            if (adatto) { lavora(d, i); return; }
+        }
+    }
+}
+
+static void ev_arrivo(Des *d, int u) {
+    SharedData *shm = d->shm;
+    Rng *rng = &d->rng_utenti[u];
+    int r = rng_intero(rng, 100);
+    if (r >= d->p_serv[u] || !shm->ufficio_aperto) return;
+
+    int servizio = rng_intero(rng, d->cfg->num_servizi);
+    if (!servizio_attivo(shm, servizio)) return;
+    accoda(d, servizio);
+}
+
+// Prossima finestra di arrivi: il lotto precedente è già tutto uscito dall'heap
+static void ev_lotto(Des *d) {
+    double da = d->ora - d->apertura;
+    double a = popolazione_lotto(d->pop, da, &d->lotto);
+    for (int i = 0; i < d->lotto.n; i++)
+        heap_push(&d->heap, d->apertura + d->lotto.minuto[i], EV_ARRIVO_POP, i, 0);
+    if (a < d->giornata_min) heap_push(&d->heap, d->apertura + a, EV_LOTTO, 0, 0);
+}
+
+static void ev_arrivo_pop(Des *d, int i) {
+    int u = d->lotto.utente[i], servizio = d->lotto.servizio[i];
+    int esito = !d->shm->ufficio_aperto ? ARRIVO_UFFICIO_CHIUSO
+              : !servizio_attivo(d->shm, servizio) ? ARRIVO_SERVIZIO_CHIUSO : ARRIVO_IN_CODA;
+    popolazione_esito(d->pop, u, esito, servizio, esito == ARRIVO_IN_CODA ? d->ticket + 1 : -1, ora_ns(d));
+    if (esito == ARRIVO_IN_CODA) accoda(d, servizio);
+}
+
+static void ev_fine_servizio(Des *d, int id) {
+    SharedData *shm = d->shm;
+    Operatore *o = &d->op[id];
+    long ns = shm->cfg.nano_secs_per_min;
+
+    SlotOperatore *slot = &shm->slot_operatori[id];
+    shm->stats_giornaliere.utenti_serviti++;
+    shm->stats_giornaliere.servizi_erogati[o->servizio]++;
+    shm->stats_giornaliere.tempo_servizio_totale += (long)(o->durata * ns);
+    shm->stats_giornaliere.tempo_attesa_totale += (long)(o->attesa * ns);
+    ServizioCondiviso *sv = shm_servizio(shm, o->servizio);
+    isto_registra(&sv->attesa, (long)(o->attesa * ns));
+    isto_registra(&sv->servizio, (long)(o->durata * ns));
+    sv->in_attesa--;
+
+    // Contributi per operatore (utilizzo e furti nel report finale)
+    slot->stats.utenti_serviti++;
+    slot->ns_servizio += (long)(o->durata * ns);
+    if (o->servizio != shm_sportello(shm, o->seat)->servizio) slot->rubati++;
+
+    o->stato = OP_LIBERO;
+    lavora(d, id);
+}
+
+// Risveglio dal polling a coda vuota: un altro giro del loop se nel frattempo nessuno
+// mi ha dato lavoro (altrimenti l'evento è superato: lavora ne ha già programmato un altro)
+static void ev_polling(Des *d, int id) {
+    Operatore *o = &d->op[id];
+    if (o->stato == OP_LIBERO && d->ora == o->polling && d->shm->ufficio_aperto) lavora(d, id);
+}
+
+static void ev_fine_pausa(Des *d, int id) {
+    SharedData *shm = d->shm;
+    Operatore *o = &d->op[id];
+
+    // Al ritorno ricompeto per la mia sedia: se è stata presa torno a cercarne una come
+    // operatore.c (cerca_sportello): libera subito o, più tardi, consegnata da libera_posto
+    if (sportello_riprendi(shm, o->seat, id + 1, ora_ns(d))) {
+        o->seduto_da = d->ora;
+        o->stato = OP_LIBERO;
+        lavora(d, id);
+        return;
+    }
+    shm->contesa.cas_falliti++;
+    o->seat = -1;
+    if (!shm->ufficio_aperto) { // A ufficio chiuso cerca_sportello non cerca: turno finito
+        o->stato = OP_FUORI;
+        forse_fine_giornata(d);
+        return;
+    }
+    o->stato = OP_ATTESA_POSTO;
+    if (occupa_posto(d, id)) lavora(d, id);
+    else shm->contesa.attese_posto++;
+}
+
+static void ev_chiusura(Des *d) {
+    d->shm->chiusura_ns = ora_ns(d);
+    d->shm->ufficio_aperto = 0;
+    d->chiuso_alle = d->ora;
+    if (!d->o->silenzioso) printf("--- Giorno %d Fine (Ufficio Chiuso) ---\n", d->giorno);
+    if (d->pop) popolazione_rientro(d->pop);
+
+    // Chi aspetta una sedia va a casa; chi è libero smette se la sua coda è vuota
+    for (int i = 0; i < d->cfg->nof_workers; i++) {
+        Operatore *o = &d->op[i];
+        if (o->stato == OP_ATTESA_POSTO) o->stato = OP_FUORI;
+        else if (o->stato == OP_LIBERO) lavora(d, i); // Coda residua entro la grazia o fuori
+    }
+    forse_fine_giornata(d); // Nessuno in servizio o in pausa: la giornata finisce subito
+}
+
+// --- CHECKPOINT ---
+// Stato privato del motore dopo l'immagine della SHM: scalari, poi in fila gli eventi
+// in attesa (l'array dell'heap così com'è: stesso ordine di estrazione), gli operatori,
+// P_SERV e flussi degli utenti, il contenuto delle code
+typedef struct {
+    double ora;
+    int giorno, ticket;
+    long eventi;
+    unsigned long seq;          // Contatore di inserimento dell'heap
+    int n_eventi;
+    int n_coda[MAX_SERVIZI];
+} StatoDes;
+
+static void des_checkpoint(Des *d) {
+    const Config *cfg = d->cfg;
+    StatoDes st = {d->ora, d->giorno, d->ticket, d->eventi, d->heap.seq, d->heap.n, {0}};
+    size_t dim = sizeof(st) + d->heap.n * sizeof(Evento) + cfg->nof_workers * sizeof(Operatore)
+               + utenti_agenti(cfg) * (sizeof(int) + sizeof(Rng));
+    for (int s = 0; s < cfg->num_servizi; s++) {
+        st.n_coda[s] = d->code[s].n;
+        dim += d->code[s].n * sizeof(double);
+    }
+    char *buf = malloc(dim), *p = buf;
+    if (!buf) { perror("malloc"); exit(1); }
+    memcpy(p, &st, sizeof(st)); p += sizeof(st);
+    memcpy(p, d->heap.v, d->heap.n * sizeof(Evento)); p += d->heap.n * sizeof(Evento);
+    memcpy(p, d->op, cfg->nof_workers * sizeof(Operatore)); p += cfg->nof_workers * sizeof(Operatore);
+    memcpy(p, d->p_serv, utenti_agenti(cfg) * sizeof(int)); p += utenti_agenti(cfg) * sizeof(int);
+    memcpy(p, d->rng_utenti, utenti_agenti(cfg) * sizeof(Rng)); p += utenti_agenti(cfg) * sizeof(Rng);
+    for (int s = 0; s < cfg->num_servizi; s++)
+        for (int i = 0; i < d->code[s].n; i++, p += sizeof(double))
+            memcpy(p, &d->code[s].v[(d->code[s].testa + i) % d->code[s].cap], sizeof(double));
+    checkpoint_scrivi(d->o->file_checkpoint, "des", d->giorno - 1, d->shm, &d->rng_sportelli, buf, dim);
+    free(buf);
+}
+
+// Ripresa: segmento e contabilità del Direttore da checkpoint_ripristina, poi lo stato del motore
+static int des_ripristina(Des *d, const Checkpoint *c) {
+    const Config *cfg = d->cfg;
+    StatoDes st;
+    const char *p = c->motore;
+    if (!p || c->t->dim_motore < sizeof(st)) return -1;
+    memcpy(&st, p, sizeof(st)); p += sizeof(st);
+    size_t dim = sizeof(st) + st.n_eventi * sizeof(Evento) + cfg->nof_workers * sizeof(Operatore)
+               + utenti_agenti(cfg) * (sizeof(int) + sizeof(Rng));
+    for (int s = 0; s < cfg->num_servizi; s++) dim += st.n_coda[s] * sizeof(double);
+    if (dim != c->t->dim_motore) return -1;
+
+    checkpoint_ripristina(d->shm, c, &d->rng_sportelli);
+    d->ora = st.ora;
+    d->giorno = st.giorno;
+    d->ticket = st.ticket;
+    d->eventi = st.eventi;
+    d->heap.n = d->heap.cap = st.n_eventi;
+    d->heap.seq = st.seq;
+    d->heap.v = malloc((st.n_eventi > 0 ? st.n_eventi : 1) * sizeof(Evento));
+    if (!d->heap.v) { perror("malloc"); exit(1); }
+    memcpy(d->heap.v, p, st.n_eventi * sizeof(Evento)); p += st.n_eventi * sizeof(Evento);
+    memcpy(d->op, p, cfg->nof_workers * sizeof(Operatore)); p += cfg->nof_workers * sizeof(Operatore);
+    memcpy(d->p_serv, p, utenti_agenti(cfg) * sizeof(int)); p += utenti_agenti(cfg) * sizeof(int);
+    memcpy(d->rng_utenti, p, utenti_agenti(cfg) * sizeof(Rng)); p += utenti_agenti(cfg) * sizeof(Rng);
+    for (int s = 0; s < cfg->num_servizi; s++) {
+        for (int i = 0; i < st.n_coda[s]; i++, p += sizeof(double)) {
+            double t;
+            memcpy(&t, p, sizeof(double));
+            fifo_push(&d->code[s], t);
+        }
+    }
+    return 0;
+}
+
+// Ritorna 1 se la simulazione deve terminare
+static int ev_fine_giornata(Des *d) {
+    SharedData *shm = d->shm;
+
+    // Tutti gli operatori sono usciti (forse_fine_giornata): nessun servizio da interrompere
+    d->fine_programmata = 0;
+
+    int rimasti_in_coda = chiudi_giornata(shm);
+    esporta_giornata(shm, d->giorno);
+    if (!d->o->silenzioso) {
+        print_stats(shm, d->giorno, 0);
+        printf("  Fasi (minuti simulati): giornata %.0f, smaltimento %.1f\n",
+               d->giornata_min, d->ora - d->chiuso_alle);
+    }
+
+    if (rimasti_in_coda > d->cfg->explode_threshold) {
+        printf("\n[CRITICAL] Troppi utenti in coda (%d > %d). Terminazione Explode!\n",
+               rimasti_in_coda, d->cfg->explode_threshold);
+        return 1;
+    }
+    if (d->giorno >= d->cfg->sim_duration) return 1;
+
+    d->giorno++;
+    heap_push(&d->heap, d->ora, EV_APERTURA, 0, 0);
+    if (d->o->file_checkpoint && (d->giorno - 1) % d->o->ogni_giorni == 0) des_checkpoint(d);
+    return 0;
+}
+
+int des_esegui(const Config *cfg, const Opzioni *o) {
+    if (cfg->nano_secs_per_min <= 0) {
+        fprintf(stderr, "[Direttore] NANO_SECS deve essere positivo\n");
+        return 1;
+    }
+
+    printf("[Direttore] Motore DES: %d giorni, %d utenti, %d servizi, %d sportelli, soglia %d, SEED=%lu\n",
+           cfg->sim_duration, cfg->nof_users, cfg->num_servizi, cfg->num_sportelli, cfg->explode_threshold, cfg->seme);
+
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    Des d;
+    memset(&d, 0, sizeof(d));
+    d.cfg = cfg;
+    d.o = o;
+    // Stesso layout del segmento del motore ipc (allineato alle linee di cache)
+    size_t dimensione = shm_dimensione(cfg);
+    d.shm = aligned_alloc(LINEA_CACHE, dimensione);
+    d.op = calloc(cfg->nof_workers > 0 ? cfg->nof_workers : 1, sizeof(Operatore));
+    int agenti = utenti_agenti(cfg);
+    d.p_serv = calloc(agenti > 0 ? agenti : 1, sizeof(int));
+    d.rng_utenti = calloc(agenti > 0 ? agenti : 1, sizeof(Rng));
+    if (!d.shm || !d.op || !d.p_serv || !d.rng_utenti) { perror("calloc"); return 1; }
+    memset(d.shm, 0, dimensione);
+    d.shm->cfg = *cfg;
+    shm_layout(d.shm, cfg);
+    for (int i = 0; i < cfg->num_sportelli; i++) shm_sportello(d.shm, i)->servizio = -1;
+    rng_init(&d.rng_sportelli, cfg->seme, FLUSSO_SPORTELLI);
+    if (cfg->arrivi != ARRIVI_AGENTI) d.pop = popolazione_crea(cfg);
+
+    // Giornata e tetto del periodo di grazia in minuti simulati
+    d.giornata_min = cfg->minuti_giornata;
+    d.chiusura_min = cfg->minuti_chiusura;
+    d.polling_min = POLLING_OPERATORE_US * 1000.0 / cfg->nano_secs_per_min;
+
+    // Stessi flussi dei motori reali: skill e competenze degli operatori, P_SERV degli utenti
+    for (int i = 0; i < cfg->nof_workers; i++) {
+        rng_init(&d.op[i].rng, cfg->seme, FLUSSO_OPERATORE(i));
+        d.op[i].skill = rng_intero(&d.op[i].rng, cfg->num_servizi);
+        d.op[i].competenze = competenze_casuali(d.op[i].skill, cfg->nof_skills, cfg->num_servizi, &d.op[i].rng);
+        d.shm->slot_operatori[i].competenze = d.op[i].competenze;
+        d.op[i].pause_rimanenti = cfg->nof_pause;
+        d.op[i].seat = -1;
+    }
+    for (int u = 0; u < agenti; u++) {
+        rng_init(&d.rng_utenti[u], cfg->seme, FLUSSO_UTENTE(u));
+        d.p_serv[u] = p_serv_casuale(cfg, &d.rng_utenti[u]);
+    }
+
+    // --- LOOP DEGLI EVENTI ---
+    // Con --resume riparto dagli eventi in attesa nel checkpoint (il primo è l'apertura)
+    if (o->ripresa) {
+        if (des_ripristina(&d, o->ripresa) < 0) {
+            fprintf(stderr, "[Direttore] Checkpoint senza stato del motore DES compatibile\n");
+            return 1;
+        }
+    } else {
+        // Contabilità del Direttore da zero: con --scenarios più simulazioni nello stesso processo
+        memset(&memoria_sportelli, 0, sizeof(memoria_sportelli));
+        riprendi_contabilita(d.shm);
+        d.giorno = 1;
+        heap_push(&d.heap, 0, EV_APERTURA, 0, 0);
+    }
+
+    if (o->file_esporta && esporta_avvia(o->file_esporta, cfg) < 0) return 1;
+
+    int fine = 0;
+    while (!fine && d.heap.n > 0) {
+        Evento e = heap_pop(&d.heap);
+        d.ora = e.t;
+        d.eventi++;
+
+        // Eventi di un operatore con generazione superata (servizio interrotto, nuovo giorno)
+        if ((e.tipo == EV_FINE_SERVIZIO || e.tipo == EV_FINE_PAUSA || e.tipo == EV_POLLING) && e.gen != d.op[e.id].gen)
+            continue;
+
+        switch (e.tipo) {
+            case EV_APERTURA:      ev_apertura(&d); break;
+            case EV_CHIUSURA:      ev_chiusura(&d); break;
+            case EV_FINE_GIORNATA: fine = ev_fine_giornata(&d); break;
+            case EV_ARRIVO:        ev_arrivo(&d, e.id); break;
+            case EV_FINE_SERVIZIO: ev_fine_servizio(&d, e.id); break;
+            case EV_FINE_PAUSA:    ev_fine_pausa(&d, e.id); break;
+            case EV_LOTTO:         ev_lotto(&d); break;
+            case EV_ARRIVO_POP:    ev_arrivo_pop(&d, e.id); break;
+            case EV_POLLING:       ev_polling(&d, e.id); break;
+        }
+    }
+
+    int esito = esporta_termina() < 0; // File di --export incompleto: il processo esce con 1
+    printf("\n--- FINE SIMULAZIONE ---\n");
+    print_stats(d.shm, 0, 1);
+    if (d.pop) popolazione_report(d.pop);
+    pubblica_risultato(d.shm, d.giorno, o->scenari ? &o->scenari[0].esito : NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    double secs = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+    printf("\n[Direttore] DES: %d giorni simulati, %ld eventi, %d ticket in %.3f s reali\n",
+           d.giorno, d.eventi, d.ticket, secs);
+
+    for (int i = 0; i < cfg->num_servizi; i++) free(d.code[i].v);
+    free(d.heap.v);
+    free(d.op);
+    free(d.p_serv);
+    free(d.rng_utenti);
+    popolazione_libera(d.pop);
+    lotto_libera(&d.lotto);
+    free(d.shm);
+    return esito;
+}
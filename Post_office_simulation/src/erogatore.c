@@ -1,4 +1,5 @@
 #include "common.h"
+#include "agenti.h"
 
 /*
  * EROGATORE.C (Il Server di Ticket)
@@ -10,17 +11,14 @@
  * Ho scelto le Message Queue perché permettono lo scambio di dati strutturati (struct)
  * e garantiscono nativamente l'ordinamento FIFO delle richieste, senza dover implementare
  * un mutex esplicito per gestire l'accesso concorrente al contatore dei ticket.
+ * * Da quando esiste il distributore lock-free in SHM (TICKET_SHM, default) l'Erogatore
+ * viene avviato solo nella modalità di compatibilità --tickets=msg.
  */
 
-int main(void) {
-    // 1. Collegamento alla Coda
-    // Non uso IPC_CREAT perché la coda deve essere stata creata dal Direttore
-    // Se non esiste, è un errore fatale
-    int msg_id = msgget(KEY_MSG, 0666);
-    if (msg_id == -1) exit(1);
-
+void erogatore_esegui(int msg_id) {
     MsgTicket msg;
     int global_ticket_counter = 1;
+    profilo_usa(PR_EROGATORE, 0);
 
     // 2. Loop Infinito (Server Loop)
     // Non c'è una condizione di uscita esplicita basata su variabili (es. stop_simulation)
@@ -34,7 +32,7 @@ int main(void) {
         // 
         // Nota sulla dimensione: passo "sizeof(MsgTicket) - sizeof(long)" 
         // perché il campo mtype (long) non viene contato nel payload del messaggio.
-        ssize_t bytes = msgrcv(msg_id, &msg, sizeof(MsgTicket) - sizeof(long), 1, 0);
+        ssize_t bytes = msg_ricevi(msg_id, &msg, sizeof(MsgTicket) - sizeof(long), 1, 0);
 
         if (bytes == -1) {
             // GESTIONE TERMINAZIONE "ELEGANTE"
@@ -61,9 +59,27 @@ int main(void) {
         msg.mtype = msg.pid_richiedente; 
 
         // Invio (non bloccante di default, a meno che la coda non sia piena)
-        msgsnd(msg_id, &msg, sizeof(MsgTicket) - sizeof(long), 0);
+        msg_invia(msg_id, &msg, sizeof(MsgTicket) - sizeof(long), 0);
     }
+}
+
+#ifndef SENZA_MAIN
+int main(void) {
+    // 1. Collegamento alla Coda
+    // Non uso IPC_CREAT perché la coda deve essere stata creata dal Direttore
+    // (id passato nel namespace IPC). Se non esiste, è un errore fatale
+    int shm_id, sem_id, msg_id;
+    ipc_ids(&shm_id, &sem_id, &msg_id);
+    if (msg_id == -1) exit(1);
+    profilo_attach(); // Solo in make profilo
+
+    // La SHM mi serve solo per contare le mie msgsnd/msgrcv (contesa.operazioni_ipc)
+    SharedData *shm = shm_id != -1 ? shmat(shm_id, NULL, 0) : (void *)-1;
+    if (shm != (void *)-1) ipc_contatore = &shm->contesa.operazioni_ipc;
+
+    erogatore_esegui(msg_id);
     
-    // shmdt non serve qui perché non ho fatto shmat
+    if (shm != (void *)-1) { ipc_contatore = NULL; shmdt(shm); }
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include <pthread.h>
+#include "common.h"
+#include "esporta.h"
+
+/*
+ * ESPORTA.C (Statistiche giornaliere su file: --export=FILE)
+ * * Il report a console è testo libero: su 10000 giorni va letto a forza di grep, e stamparlo
+ * rallenta il Direttore. Qui ogni giornata chiusa diventa una riga di numeri
+ * * Il Direttore non fa I/O sul cammino critico: copia la riga nel blocco corrente (un memcpy
+ * di qualche centinaio di byte) e, a blocco pieno, lo passa al thread di scrittura e continua
+ * sull'altro. Due blocchi: il Direttore aspetta solo se il thread è indietro di un blocco
+ * intero (RIGHE_BLOCCO giorni), cioè se il disco è davvero più lento della simulazione
+ * * Il blocco in memoria è già a colonne: il formato binario lo scrive così com'è, il CSV
+ * lo rilegge per righe
+ */
+
+typedef struct {
+    int n;                      // Righe piene
+    int pieno;                  // Consegnato al thread, da scrivere
+    long *v;                    // v[colonna * RIGHE_BLOCCO + riga]
+} Blocco;
+
+static FILE *file_esporta = NULL;
+static const char *nome_esporta = NULL;
+static int csv = 0;
+static int n_colonne = 0;
+static Blocco blocchi[2];
+static int corrente = 0;        // Blocco che il Direttore sta riempiendo
+static long respinti_prima = 0; // Cumulativo di utenti_respinti alla chiusura precedente
+static long righe_scritte = 0;
+static pthread_t scrittore;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cambiato = PTHREAD_COND_INITIALIZER;
+static int fine_esportazione = 0;
+static int errore_esporta = 0;  // errno del primo fallimento di scrittura (0 = nessuno)
+
+// 0 se il blocco è finito tutto nel buffer di stdio, -1 altrimenti (errno impostato)
+static int scrivi_blocco(const Blocco *b) {
+    if (!csv) {
+        if (fwrite(&b->n, sizeof(int), 1, file_esporta) != 1) return -1;
+        for (int c = 0; c < n_colonne; c++)
+            if (fwrite(&b->v[c * RIGHE_BLOCCO], sizeof(long), b->n, file_esporta) != (size_t)b->n) return -1;
+    } else {
+        for (int r = 0; r < b->n; r++)
+            for (int c = 0; c < n_colonne; c++)
+                if (fprintf(file_esporta, c + 1 < n_colonne ? "%ld," : "%ld\n", b->v[c * RIGHE_BLOCCO + r]) < 0)
+                    return -1;
+    }
+    return 0;
+}
+
+static void *scrivi(void *arg) {
+    (void)arg;
+    for (int i = 0; ; i ^= 1) {
+        pthread_mutex_lock(&lock);
+        while (!blocchi[i].pieno && !fine_esportazione) pthread_cond_wait(&cambiato, &lock);
+        int da_scrivere = blocchi[i].pieno;
+        pthread_mutex_unlock(&lock);
+        if (!da_scrivere) break; // Fine, e nessun blocco in sospeso
+
+        // Un blocco alla volta su disco: chi legge il file lo vede crescere. Dopo il primo errore
+        // (disco pieno, quota) non scrivo più, ma continuo a liberare i blocchi al Direttore
+        if (!errore_esporta) {
+            if (scrivi_blocco(&blocchi[i]) < 0 || fflush(file_esporta) == EOF)
+                errore_esporta = errno ? errno : EIO;
+            else righe_scritte += blocchi[i].n;
+        }
+
+        pthread_mutex_lock(&lock);
+        blocchi[i].pieno = 0;
+        blocchi[i].n = 0;
+        pthread_cond_broadcast(&cambiato);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+int esporta_avvia(const char *file, const Config *cfg) {
+    const char *punto = strrchr(file, '.');
+    csv = punto && !strcmp(punto, ".csv");
+    file_esporta = fopen(file, csv ? "w" : "wb");
+    if (!file_esporta) { perror("Apertura file di esportazione"); return -1; }
+    nome_esporta = file;
+    n_colonne = esporta_colonne(cfg);
+    for (int i = 0; i < 2; i++) {
+        blocchi[i] = (Blocco){0, 0, calloc((size_t)n_colonne * RIGHE_BLOCCO, sizeof(long))};
+        if (!blocchi[i].v) { perror("calloc"); exit(1); }
+    }
+    corrente = 0;
+    respinti_prima = 0;
+    righe_scritte = 0;
+    fine_esportazione = 0;
+    errore_esporta = 0;
+
+    char nome[LUNGHEZZA_COLONNA];
+    int err = 0;
+    if (csv) {
+        for (int c = 0; c < n_colonne; c++) {
+            esporta_nome(cfg, c, nome);
+            err |= fprintf(file_esporta, c + 1 < n_colonne ? "%s," : "%s\n", nome) < 0;
+        }
+    } else {
+        TestataEsporta h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, ESPORTA_MAGIC, sizeof(h.magic));
+        h.n_colonne = n_colonne;
+        h.righe_blocco = RIGHE_BLOCCO;
+        h.cfg = *cfg;
+        err |= fwrite(&h, sizeof(h), 1, file_esporta) != 1;
+        for (int c = 0; c < n_colonne; c++) {
+            memset(nome, 0, sizeof(nome));
+            esporta_nome(cfg, c, nome);
+            err |= fwrite(nome, sizeof(nome), 1, file_esporta) != 1;
+        }
+    }
+    // L'intestazione va su disco subito: un file senza nomi delle colonne è inutile
+    if (err || fflush(file_esporta) == EOF) {
+        fprintf(stderr, "[Direttore] Esportazione %s: %s\n", file, strerror(errno));
+        fclose(file_esporta);
+        file_esporta = NULL;
+        for (int i = 0; i < 2; i++) { free(blocchi[i].v); blocchi[i].v = NULL; }
+        return -1;
+    }
+
+    if (pthread_create(&scrittore, NULL, scrivi, NULL) != 0) {
+        perror("pthread_create esportazione"); exit(1);
+    }
+    return 0;
+}
+
+// Passa il blocco corrente al thread e prende l'altro (aspetta solo se è ancora da scrivere)
+static void consegna(void) {
+    pthread_mutex_lock(&lock);
+    blocchi[corrente].pieno = 1;
+    pthread_cond_broadcast(&cambiato);
+    corrente ^= 1;
+    while (blocchi[corrente].pieno) pthread_cond_wait(&cambiato, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void esporta_giornata(SharedData *shm, int giorno) {
+    if (!file_esporta) return;
+    const Config *cfg = &shm->cfg;
+    const Stats *g = &shm->stats_giornaliere;
+    Blocco *b = &blocchi[corrente];
+    long *v = &b->v[b->n];
+    long respinti = __atomic_load_n(&shm->utenti_respinti, __ATOMIC_RELAXED);
+
+    long fisse[NUM_COL_FISSE] = {
+        giorno, g->utenti_serviti, g->servizi_non_erogati, g->tempo_attesa_totale,
+        g->tempo_servizio_totale, g->pause_effettuate, g->operatori_attivi,
+        respinti - respinti_prima, shm->sportelli_aperti
+    };
+    respinti_prima = respinti;
+    int c = 0;
+    for (; c < NUM_COL_FISSE; c++) v[c * RIGHE_BLOCCO] = fisse[c];
+    for (int s = 0; s < cfg->num_servizi; s++, c++) v[c * RIGHE_BLOCCO] = g->servizi_erogati[s];
+    for (int s = 0; s < cfg->num_servizi; s++, c++) v[c * RIGHE_BLOCCO] = shm_servizio(shm, s)->in_attesa;
+    for (int i = 0; i < cfg->num_sportelli; i++, c++) v[c * RIGHE_BLOCCO] = shm_sportello(shm, i)->servizio;
+
+    if (++b->n == RIGHE_BLOCCO) consegna();
+}
+
+int esporta_termina(void) {
+    if (!file_esporta) return 0;
+    pthread_mutex_lock(&lock);
+    if (blocchi[corrente].n > 0) blocchi[corrente].pieno = 1; // Ultimo blocco, anche parziale
+    fine_esportazione = 1;
+    pthread_cond_broadcast(&cambiato);
+    pthread_mutex_unlock(&lock);
+    pthread_join(scrittore, NULL);
+
+    printf("[Direttore] Esportazione: %ld giornate, %d colonne (%s)\n", righe_scritte, n_colonne,
+           csv ? "CSV" : "binario a colonne");
+    // fclose può fallire anche lei (ultimo write rinviato dal kernel): va controllata
+    if (fclose(file_esporta) == EOF && !errore_esporta) errore_esporta = errno ? errno : EIO;
+    file_esporta = NULL;
+    for (int i = 0; i < 2; i++) { free(blocchi[i].v); blocchi[i].v = NULL; }
+    if (!errore_esporta) return 0;
+    fprintf(stderr, "[Direttore] Esportazione %s: %s (file incompleto)\n", nome_esporta, strerror(errore_esporta));
+    return -1;
+}
@@ -1,6 +1,34 @@
+#include <spawn.h>
+#include <sys/prctl.h>
 #include "common.h"
+#include "direttore.h"
+#include "pool.h"
+#include "traccia.h"
+#include "esporta.h"
 
-int shm_id, sem_id, msg_id;
+// Inizializzati a -1: se la cleanup scatta prima del setup non tocco risorse altrui
+int shm_id = -1, sem_id = -1, msg_id = -1;
+
+// Cleanup partita dal gestore di SIGINT: lì sono ammesse solo funzioni async-signal-safe
+static volatile sig_atomic_t da_segnale = 0;
+// Esito del processo: diverso da 0 se il file di --export è rimasto incompleto
+static int codice_uscita = 0;
+
+// Motore "thread": gli attori girano nel Direttore (NULL nel motore a processi)
+static Pool *pool = NULL;
+// Popolazione che genera gli arrivi (ARRIVALS diverso da 0): thread del Direttore
+static Popolazione *popolazione = NULL;
+
+// Ambiente dei figli: gli id IPC di questa esecuzione (vedi ENV_IPC in common.h)
+static char env_ipc[64];
+
+// Ogni cambio di ufficio_aperto / stop_simulation passa di qui:
+// broadcast sul futex di stato per processi e thread, risveglio degli utenti del pool
+static void notifica_stato(SharedData *shm) {
+    stato_pubblica(shm);
+    sveglia_attese_posto(shm);
+    if (pool) pool_notifica(pool);
+}
 
 /* * FUNZIONE CLEANUP
  * Deve garantire che non rimangano risorse IPC appese
@@ -9,9 +37,18 @@ int shm_id, sem_id, msg_id;
 void cleanup() {
     // 1. Rimuovo le risorse IPC. Uso IPC_RMID per marcarle per la distruzione
     // Se non lo faccio, rimangono in /dev/shm o ipcs finché non riavvio la macchina
-    shmctl(shm_id, IPC_RMID, NULL); 
-    semctl(sem_id, 0, IPC_RMID);    
-    msgctl(msg_id, IPC_RMID, NULL); 
+    if (shm_id != -1) shmctl(shm_id, IPC_RMID, NULL); 
+    if (sem_id != -1) semctl(sem_id, 0, IPC_RMID);    
+    if (msg_id != -1) msgctl(msg_id, IPC_RMID, NULL); 
+    // Dal gestore di SIGINT niente mutex, pthread_join e stdio: se il segnale ha interrotto il
+    // Direttore mentre li teneva, si bloccherebbe per sempre. Tolgo solo il segmento della
+    // traccia; il file di --export resta ai blocchi già scritti (aggrega salta quello troncato)
+    if (da_segnale) traccia_rimuovi();
+    else {
+        traccia_termina(); // Segmento della traccia (no-op se --trace non è attivo)
+        if (esporta_termina() < 0) codice_uscita = 1; // Ultime giornate di --export (no-op se non è attivo)
+    }
+    profilo_termina(); // Segmento del profilo IPC (no-op fuori da make profilo)
     
     // 2. Strategia di chiusura processi:
     // - Ignoro SIGTERM per me stesso (altrimenti mi uccido da solo con kill(0))
@@ -25,40 +62,185 @@ void cleanup() {
     //   Fondamentale per evitare processi zombie nella tabella dei processi del sistema
     while(wait(NULL) > 0);
 
+    if (da_segnale) {
+        static const char bye[] = "\n[Direttore] Pulizia completata. Bye!\n";
+        (void)write(STDOUT_FILENO, bye, sizeof(bye) - 1);
+        _exit(0);
+    }
     printf("\n[Direttore] Pulizia completata. Bye!\n");
-    exit(0);
+    exit(codice_uscita);
 }
 
 // Gestore segnali: intercetto CTRL+C per non uscire brutalmente ma fare pulizia
-void handle_sig(int sig) { (void)sig; cleanup(); }
+void handle_sig(int sig) { (void)sig; da_segnale = 1; cleanup(); }
 
-// Parsing Configurazione: leggo il file .conf per settare i parametri dinamici
-void load_config(const char *filename, Config *cfg) {
-    FILE *f = fopen(filename, "r");
-    if (!f) { perror("Errore apertura config"); exit(1); }
-    
-    char line[128], key[64];
-    int val;
-    
-    // Valori di default (Fallback nel caso il file sia incompleto)
+// Clienti per lotto delle statistiche operatore: tra 1 e LOTTO_MAX
+static void limita_lotto(Config *cfg) {
+    if(cfg->lotto_statistiche >= 1 && cfg->lotto_statistiche <= LOTTO_MAX) return;
+    fprintf(stderr, "[Direttore] STATS_BATCH=%d fuori da [1, %d]: limitato\n", cfg->lotto_statistiche, LOTTO_MAX);
+    cfg->lotto_statistiche = cfg->lotto_statistiche < 1 ? 1 : LOTTO_MAX;
+}
+
+// Valori di default (Fallback nel caso il file sia incompleto)
+void config_default(Config *cfg) {
     cfg->sim_duration = 5; cfg->explode_threshold = 50; 
     cfg->nof_users = 20; cfg->nof_workers = 5; cfg->nano_secs_per_min = 100000;
     cfg->nof_pause = 3; cfg->p_serv_min = 10; cfg->p_serv_max = 90;
+    cfg->modalita_ticket = TICKET_SHM;
+    cfg->nof_skills = 1; cfg->politica_furto = FURTO_NESSUNO; // Modello originale mono-competenza
+    cfg->politica_sportelli = ALLOC_CASUALE;
+    cfg->lotto_statistiche = LOTTO_DEFAULT;
+    cfg->seme = 0; // SEED assente: lo sceglie il main dall'orologio (e lo stampa)
+    cfg->num_sportelli = NUM_SPORTELLI_DEFAULT;
+    cfg->num_servizi = NUM_SERVIZI_DEFAULT;
+    cfg->minuti_giornata = MINUTI_GIORNATA_DEFAULT;
+    cfg->minuti_chiusura = MINUTI_CHIUSURA_DEFAULT;
+    cfg->arrivi = ARRIVI_AGENTI;
+    cfg->tasso_arrivi = 1.0;
+    cfg->num_fasce = 0;
+    memcpy(cfg->servizi, SERVIZI_DEFAULT, sizeof(SERVIZI_DEFAULT));
+}
 
-    while(fgets(line, sizeof(line), f)) {
-        if(sscanf(line, "%[^=]=%d", key, &val) == 2) {
-            // Mappo le stringhe del file nelle variabili della struct
-            if(!strcmp(key, "SIM_DURATION")) cfg->sim_duration = val;
-            else if(!strcmp(key, "EXPLODE_THRESHOLD")) cfg->explode_threshold = val;
-            else if(!strcmp(key, "NOF_USERS")) cfg->nof_users = val;
-            else if(!strcmp(key, "NOF_WORKERS")) cfg->nof_workers = val;
-            else if(!strcmp(key, "NANO_SECS")) cfg->nano_secs_per_min = val;
-            else if(!strcmp(key, "NOF_PAUSE")) cfg->nof_pause = val;
-            else if(!strcmp(key, "P_SERV_MIN")) cfg->p_serv_min = val;
-            else if(!strcmp(key, "P_SERV_MAX")) cfg->p_serv_max = val;
+// Una riga del .conf (le righe che non sono "CHIAVE=valore" vengono ignorate)
+void config_riga(Config *cfg, const char *line, int *servizi_letti) {
+    char key[64], nome[LUNGHEZZA_NOME];
+    int val, minuti;
+    // SERVICE=Nome,minuti: la prima riga sostituisce i servizi di default, le altre si aggiungono
+    if(sscanf(line, "SERVICE=%23[^,],%d", nome, &minuti) == 2) {
+        if(*servizi_letti == MAX_SERVIZI || minuti < 1) {
+            fprintf(stderr, "[Direttore] SERVICE=%s,%d ignorato (massimo %d servizi, minuti >= 1)\n",
+                    nome, minuti, MAX_SERVIZI);
+            return;
+        }
+        snprintf(cfg->servizi[*servizi_letti].nome, LUNGHEZZA_NOME, "%s", nome);
+        cfg->servizi[(*servizi_letti)++].minuti = minuti;
+        cfg->num_servizi = *servizi_letti;
+    }
+    // ARRIVAL_RATE=x (decimale) e ARRIVAL_PROFILE=p1,p2,... (pesi delle fasce della giornata)
+    else if(sscanf(line, "ARRIVAL_RATE=%lf", &cfg->tasso_arrivi) == 1) {}
+    else if(!strncmp(line, "ARRIVAL_PROFILE=", 16)) {
+        const char *p = line + 16;
+        char *fine;
+        cfg->num_fasce = 0;
+        for(double peso = strtod(p, &fine); fine != p; peso = strtod(p, &fine)) {
+            if(cfg->num_fasce == MAX_FASCE) {
+                fprintf(stderr, "[Direttore] ARRIVAL_PROFILE: oltre %d fasce ignorate\n", MAX_FASCE);
+                break;
+            }
+            cfg->fasce[cfg->num_fasce++] = peso < 0 ? 0 : (float)peso;
+            p = fine + (*fine == ',');
         }
     }
+    else if(sscanf(line, "%63[^=]=%d", key, &val) == 2) {
+        // Mappo le stringhe del file nelle variabili della struct
+        if(!strcmp(key, "SIM_DURATION")) cfg->sim_duration = val;
+        else if(!strcmp(key, "EXPLODE_THRESHOLD")) cfg->explode_threshold = val;
+        else if(!strcmp(key, "NOF_USERS")) cfg->nof_users = val;
+        else if(!strcmp(key, "NOF_WORKERS")) cfg->nof_workers = val;
+        else if(!strcmp(key, "NANO_SECS")) cfg->nano_secs_per_min = val;
+        else if(!strcmp(key, "NOF_PAUSE")) cfg->nof_pause = val;
+        else if(!strcmp(key, "P_SERV_MIN")) cfg->p_serv_min = val;
+        else if(!strcmp(key, "P_SERV_MAX")) cfg->p_serv_max = val;
+        else if(!strcmp(key, "NOF_SKILLS")) cfg->nof_skills = val;
+        else if(!strcmp(key, "STEAL_POLICY")) cfg->politica_furto = val;
+        else if(!strcmp(key, "ALLOC_POLICY")) cfg->politica_sportelli = val;
+        else if(!strcmp(key, "NOF_COUNTERS")) cfg->num_sportelli = val;
+        else if(!strcmp(key, "STATS_BATCH")) cfg->lotto_statistiche = val;
+        else if(!strcmp(key, "DAY_MINUTES")) cfg->minuti_giornata = val;
+        else if(!strcmp(key, "CLOSE_MINUTES")) cfg->minuti_chiusura = val;
+        else if(!strcmp(key, "ARRIVALS")) cfg->arrivi = val;
+        else if(!strcmp(key, "SEED")) cfg->seme = strtoul(strchr(line, '=') + 1, NULL, 10); // 64 bit
+    }
+}
+
+// Limiti della SHM e valori fuori dominio, dopo aver letto tutte le righe
+void config_valida(Config *cfg) {
+    // Gli slot statistiche degli operatori in SHM sono a dimensione fissa
+    if(cfg->nof_workers > MAX_OPERATORI) {
+        fprintf(stderr, "[Direttore] NOF_WORKERS=%d oltre il massimo (%d): limitato\n",
+                cfg->nof_workers, MAX_OPERATORI);
+        cfg->nof_workers = MAX_OPERATORI;
+    }
+    if(cfg->num_sportelli < 1 || cfg->num_sportelli > MAX_SPORTELLI) {
+        fprintf(stderr, "[Direttore] NOF_COUNTERS=%d fuori da [1, %d]: limitato\n", cfg->num_sportelli, MAX_SPORTELLI);
+        cfg->num_sportelli = cfg->num_sportelli < 1 ? 1 : MAX_SPORTELLI;
+    }
+    limita_lotto(cfg);
+    if(cfg->minuti_giornata < 1) {
+        fprintf(stderr, "[Direttore] DAY_MINUTES=%d non valido: %d\n", cfg->minuti_giornata, MINUTI_GIORNATA_DEFAULT);
+        cfg->minuti_giornata = MINUTI_GIORNATA_DEFAULT;
+    }
+    if(cfg->minuti_chiusura < 0) cfg->minuti_chiusura = 0; // 0: solo i servizi già iniziati
+    if(cfg->nof_skills < 1) cfg->nof_skills = 1;
+    if(cfg->nof_skills > cfg->num_servizi) cfg->nof_skills = cfg->num_servizi;
+    if(cfg->politica_furto < FURTO_NESSUNO || cfg->politica_furto > FURTO_CASUALE) {
+        fprintf(stderr, "[Direttore] STEAL_POLICY=%d non valida: furto disattivato\n", cfg->politica_furto);
+        cfg->politica_furto = FURTO_NESSUNO;
+    }
+    if(cfg->politica_sportelli < ALLOC_CASUALE || cfg->politica_sportelli > ALLOC_CARICO) {
+        fprintf(stderr, "[Direttore] ALLOC_POLICY=%d non valida: sportelli casuali\n", cfg->politica_sportelli);
+        cfg->politica_sportelli = ALLOC_CASUALE;
+    }
+    if(cfg->arrivi < ARRIVI_AGENTI || cfg->arrivi > ARRIVI_FASCE) {
+        fprintf(stderr, "[Direttore] ARRIVALS=%d non valido: un attore per utente\n", cfg->arrivi);
+        cfg->arrivi = ARRIVI_AGENTI;
+    }
+    if(cfg->tasso_arrivi < 0) {
+        fprintf(stderr, "[Direttore] ARRIVAL_RATE=%g negativo: nessun arrivo Poisson\n", cfg->tasso_arrivi);
+        cfg->tasso_arrivi = 0;
+    }
+    if(cfg->arrivi == ARRIVI_FASCE && cfg->num_fasce < 1) {
+        fprintf(stderr, "[Direttore] ARRIVALS=%d senza ARRIVAL_PROFILE: intensità costante\n", ARRIVI_FASCE);
+        cfg->arrivi = ARRIVI_POISSON;
+    }
+}
+
+// Parsing Configurazione: leggo il file .conf per settare i parametri dinamici
+void load_config(const char *filename, Config *cfg) {
+    FILE *f = fopen(filename, "r");
+    if (!f) { perror("Errore apertura config"); exit(1); }
+    
+    char line[512]; // ARRIVAL_PROFILE può avere fino a MAX_FASCE pesi
+    int servizi_letti = 0;
+    config_default(cfg);
+    while(fgets(line, sizeof(line), f)) config_riga(cfg, line, &servizi_letti);
     fclose(f);
+    config_valida(cfg);
+}
+
+// Percentile p (0-100) dell'istogramma: limite superiore del bucket, mai oltre il massimo
+static long isto_percentile(const Istogramma *h, long n, double p) {
+    long soglia = (long)(p / 100.0 * n + 0.999999), visti = 0;
+    if (soglia < 1) soglia = 1;
+    for (int i = 0; i < ISTO_BUCKET; i++) {
+        visti += h->conteggio[i];
+        if (visti >= soglia) return isto_valore(i) < h->max ? isto_valore(i) : h->max;
+    }
+    return h->max;
+}
+
+static void stampa_isto(const char *nome, const char *tipo, const Istogramma *h) {
+    long n = 0;
+    for (int i = 0; i < ISTO_BUCKET; i++) n += h->conteggio[i];
+    if (!n) return;
+    printf("  %-14s %-8s p50 %9.3f  p90 %9.3f  p99 %9.3f  max %9.3f ms (n=%ld)\n", nome, tipo,
+           isto_percentile(h, n, 50) / 1e6, isto_percentile(h, n, 90) / 1e6,
+           isto_percentile(h, n, 99) / 1e6, h->max / 1e6, n);
+}
+
+// Una riga della precisione delle attese; ritorna il ritardo medio in minuti simulati
+static double stampa_deriva(const char *chi, const Deriva *d, int ns_per_min) {
+    if (!d->attese) return 0;
+    double medio = (double)d->ns_ritardo / d->attese;
+    printf("  %-10s attese %8ld  richiesto medio %10.3f ms  ritardo medio %8.3f ms (%6.2f%% di un minuto)  max %8.3f ms\n",
+           chi, d->attese, d->ns_richiesti / 1e6 / d->attese, medio / 1e6, 100.0 * medio / ns_per_min,
+           d->ritardo_max / 1e6);
+    return medio / ns_per_min;
+}
+
+static void isto_unisci(Istogramma *dst, const Istogramma *src) {
+    for (int i = 0; i < ISTO_BUCKET; i++) dst->conteggio[i] += src->conteggio[i];
+    if (src->max > dst->max) dst->max = src->max;
 }
 
 // Stampa reportistica: Legge dalla SHM
@@ -68,179 +250,927 @@ void print_stats(SharedData *shm, int day, int simulation_end) {
     int div = simulation_end ? shm->cfg.sim_duration : 1; 
     
     printf("\n=== STATISTICHE %s ===\n", simulation_end ? "TOTALI" : "GIORNALIERE");
-    printf("Utenti serviti: %d (Media: %.2f)\n", s->utenti_serviti, (float)s->utenti_serviti/div);
-    printf("Servizi NON erogati: %d (Persi)\n", s->servizi_non_erogati);
+    printf("Utenti serviti: %ld (Media: %.2f)\n", s->utenti_serviti, (double)s->utenti_serviti/div);
+    printf("Servizi NON erogati: %ld (Persi)\n", s->servizi_non_erogati);
     
     double avg_wait = s->utenti_serviti ? (double)s->tempo_attesa_totale / s->utenti_serviti : 0;
     
-    printf("Tempo medio attesa (stimato): %.0f ns\n", avg_wait);
-    printf("Pause effettuate: %d\n", s->pause_effettuate);
+    printf("Tempo medio attesa: %.0f ns\n", avg_wait);
+    printf("Pause effettuate: %ld\n", s->pause_effettuate);
 
     printf("-- Dettaglio Servizi --\n");
-    for(int i=0; i<NUM_SERVICES; i++) {
-        printf("  %s: %d\n", SERVICE_NAMES[i], s->servizi_erogati[i]);
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        printf("  %s: %ld\n", shm->cfg.servizi[i].nome, s->servizi_erogati[i]);
     }
     
-    // Mapping visuale degli sportelli (Solo report giornaliero)
+    // Distribuzioni misurate: attesa in coda e durata del servizio, per servizio e complessive
+    static Istogramma tutte_attese, tutti_servizi;
+    memset(&tutte_attese, 0, sizeof(Istogramma));
+    memset(&tutti_servizi, 0, sizeof(Istogramma));
+    printf("-- Latenze (p50/p90/p99/max) --\n");
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        ServizioCondiviso *sv = shm_servizio(shm, i);
+        Istogramma *attesa = simulation_end ? &sv->attesa : &sv->attesa_giorno;
+        Istogramma *servizio = simulation_end ? &sv->servizio : &sv->servizio_giorno;
+        stampa_isto(shm->cfg.servizi[i].nome, "attesa", attesa);
+        stampa_isto(shm->cfg.servizi[i].nome, "servizio", servizio);
+        isto_unisci(&tutte_attese, attesa);
+        isto_unisci(&tutti_servizi, servizio);
+    }
+    stampa_isto("Tutti", "attesa", &tutte_attese);
+    stampa_isto("Tutti", "servizio", &tutti_servizi);
+
+    // Throughput delle vie di erogazione ticket (Solo report finale)
+    // "Sostenibili" = 1 / costo medio per ticket visto dall'utente
+    if(simulation_end) {
+        static const char *vie[NUM_VIE_TICKET] = {"shm (lock-free)", "msg (Erogatore)"};
+        printf("-- Erogazione Ticket --\n");
+        for(int v=0; v<NUM_VIE_TICKET; v++) {
+            if(!shm->ticket_emessi[v]) continue;
+            double ns_medi = (double)shm->ticket_ns[v] / shm->ticket_emessi[v];
+            printf("  %s: %ld ticket, %.0f ns/ticket (%.0f ticket/s sostenibili)\n",
+                   vie[v], shm->ticket_emessi[v], ns_medi, ns_medi > 0 ? 1e9 / ns_medi : 0);
+        }
+    }
+
+    // Contesa sulla sincronizzazione (Solo report finale)
+    if(simulation_end) {
+        Contesa *c = &shm->contesa;
+        printf("-- Contesa --\n");
+        printf("  SEM_MUTEX: %ld acquisizioni (%ld contese), %.3f per utente servito\n",
+               c->mutex_acquisizioni, c->mutex_contese,
+               s->utenti_serviti ? (double)c->mutex_acquisizioni / s->utenti_serviti : 0);
+        long scarichi = 0;
+        for(int i=0; i<shm->cfg.nof_workers; i++) scarichi += shm->slot_operatori[i].scarichi;
+        if(scarichi) printf("  Scarichi statistiche operatori: %ld (lotti da %d), %.3f per utente servito\n",
+               scarichi, shm->cfg.lotto_statistiche, s->utenti_serviti ? (double)scarichi / s->utenti_serviti : 0);
+        printf("  CAS sportelli falliti: %ld\n", c->cas_falliti);
+        printf("  Attese di uno sportello: %ld (consegne dirette da chi si alza: %ld)\n",
+               c->attese_posto, c->consegne_posto);
+        printf("  Ritentativi seqlock (snapshot): %ld\n", c->seqlock_ritentativi);
+        printf("  Operazioni IPC: %ld (semop, msgsnd, msgrcv), %.1f per utente servito\n", c->operazioni_ipc,
+               s->utenti_serviti ? (double)c->operazioni_ipc / s->utenti_serviti : 0);
+        if(shm->utenti_respinti) printf("  Utenti respinti (coda piena): %ld\n", shm->utenti_respinti);
+    }
+
+    // Utilizzo per operatore (Solo report finale): tempo a servire / tempo seduto allo sportello
+    if(simulation_end) {
+        static const char *politiche[] = {"nessuno", "coda più lunga", "casuale"};
+        long tot_servizio = 0, tot_posto = 0, tot_rubati = 0;
+        printf("-- Operatori (competenze: %d, furto: %s) --\n",
+               shm->cfg.nof_skills, politiche[shm->cfg.politica_furto]);
+        for(int i=0; i<shm->cfg.nof_workers; i++) {
+            SlotOperatore *o = &shm->slot_operatori[i];
+            char nomi[128] = "";
+            for(int k=0; k<shm->cfg.num_servizi; k++) {
+                if(!((o->competenze >> k) & 1)) continue;
+                if(strlen(nomi) + LUNGHEZZA_NOME + 1 >= sizeof(nomi)) { strcat(nomi, "+..."); break; }
+                if(nomi[0]) strcat(nomi, "+");
+                strcat(nomi, shm->cfg.servizi[k].nome);
+            }
+            printf("  [%3d] %-40s serviti %6ld (rubati %5ld)  utilizzo %5.1f%%  ritardo %7.3f ms\n", i, nomi,
+                   o->stats.utenti_serviti, o->rubati,
+                   o->ns_al_posto ? 100.0 * o->ns_servizio / o->ns_al_posto : 0,
+                   o->deriva.attese ? o->deriva.ns_ritardo / 1e6 / o->deriva.attese : 0);
+            tot_servizio += o->ns_servizio;
+            tot_posto += o->ns_al_posto;
+            tot_rubati += o->rubati;
+        }
+        printf("  Utilizzo complessivo: %.1f%%, clienti rubati: %ld\n",
+               tot_posto ? 100.0 * tot_servizio / tot_posto : 0, tot_rubati);
+    }
+
+    // Precisione delle attese (Solo report finale, motori reali): di quanto i risvegli arrivano
+    // dopo la scadenza, anche in frazione di minuto simulato. Se la frazione è grande
+    // la scala NANO_SECS è troppo aggressiva per questa macchina
+    if(simulation_end) {
+        Deriva op = {0, 0, 0, 0};
+        for(int i=0; i<shm->cfg.nof_workers; i++) {
+            const Deriva *d = &shm->slot_operatori[i].deriva;
+            op.attese += d->attese;
+            op.ns_richiesti += d->ns_richiesti;
+            op.ns_ritardo += d->ns_ritardo;
+            if(d->ritardo_max > op.ritardo_max) op.ritardo_max = d->ritardo_max;
+        }
+        if(op.attese || shm->deriva_utenti.attese || shm->deriva_direttore.attese) {
+            int ns = shm->cfg.nano_secs_per_min;
+            printf("-- Precisione delle attese (NANO_SECS=%d, scadenze assolute) --\n", ns);
+            double peggiore = stampa_deriva("Direttore", &shm->deriva_direttore, ns);
+            double m = stampa_deriva("Operatori", &op, ns);
+            if(m > peggiore) peggiore = m;
+            m = stampa_deriva("Utenti", &shm->deriva_utenti, ns);
+            if(m > peggiore) peggiore = m;
+            if(peggiore > 0.1)
+                printf("  Ritardo medio oltre il 10%% di un minuto simulato: NANO_SECS troppo piccolo per questa macchina\n");
+        }
+    }
+
+    // Resa degli sportelli: clienti serviti per sportello aperto al giorno, il metro
+    // con cui si confrontano le politiche di apertura (--alloc)
+    static const char *allocazioni[] = {"casuale", "carico"};
+    if(simulation_end) {
+        printf("-- Sportelli (politica: %s) --\n", allocazioni[shm->cfg.politica_sportelli]);
+        printf("  Aperti in media: %.2f/giorno, serviti per sportello aperto: %.2f/giorno\n",
+               (double)shm->sportelli_giorni / div,
+               shm->sportelli_giorni ? (double)s->utenti_serviti / shm->sportelli_giorni : 0);
+        printf("  Tempo libero (aperti senza operatore): %.1f%%\n",
+               shm->ns_aperti_totale ? 100.0 * shm->ns_liberi_totale / shm->ns_aperti_totale : 0);
+    }
+
+    // Mapping visuale degli sportelli (Solo report giornaliero), con il tempo passato
+    // aperti ma senza nessuno seduto (pause, operatori mancanti)
     if(!simulation_end) {
-        printf("-- Stato Sportelli --\n");
-        for(int i=0; i<MAX_SPORTELLI; i++) {
-            if(shm->sportelli_mapping[i] != -1) {
-                printf("  [%d] %s -> %s\n", i, SERVICE_NAMES[shm->sportelli_mapping[i]], 
-                       shm->sportelli_occupati[i] ? "OCCUPATO" : "LIBERO");
+        double giornata = shm->chiusura_ns > shm->apertura_ns ? shm->chiusura_ns - shm->apertura_ns : 0;
+        printf("-- Stato Sportelli (politica: %s, aperti: %d, serviti per sportello: %.2f) --\n",
+               allocazioni[shm->cfg.politica_sportelli], shm->sportelli_aperti,
+               shm->sportelli_aperti ? (double)s->utenti_serviti / shm->sportelli_aperti : 0);
+        for(int i=0; i<shm->cfg.num_sportelli; i++) {
+            Sportello *sp = shm_sportello(shm, i);
+            if(sp->servizio != -1) {
+                printf("  [%d] %s -> %s (libero %.1f%%)\n", i, shm->cfg.servizi[sp->servizio].nome,
+                       sp->occupato ? "OCCUPATO" : "LIBERO", giornata ? 100.0 * sp->ns_libero / giornata : 0);
             }
         }
     }
     printf("=========================\n");
 }
 
-int main(int argc, char *argv[]) {
-    // Setup Signal Handler per uscita pulita su CTRL+C
-    signal(SIGINT, handle_sig);
+// Consegna l'esito al processo delle repliche: percentili di attesa su tutti i servizi
+// Una sola write sotto PIPE_BUF: atomica, e il padre la legge dopo la mia terminazione
+// Con --scenarios lo stesso esito resta al Direttore per il confronto finale
+void pubblica_risultato(SharedData *shm, int giorni, Risultato *esito) {
+    if (fd_risultato < 0 && !esito) return;
+    Risultato r;
+    memset(&r, 0, sizeof(r));
+    r.giorni = giorni;
+    r.totali = shm->stats_totali;
+    r.sportelli_giorni = shm->sportelli_giorni;
+    r.ns_sportelli_liberi = shm->ns_liberi_totale;
+    r.ns_sportelli_aperti = shm->ns_aperti_totale;
 
-    // Inizializzo il generatore random per la configurazione degli sportelli
-    srand(time(NULL));
+    static Istogramma tutte_attese;
+    memset(&tutte_attese, 0, sizeof(Istogramma));
+    long n = 0;
+    for(int i=0; i<shm->cfg.num_servizi; i++) isto_unisci(&tutte_attese, &shm_servizio(shm, i)->attesa);
+    for(int i=0; i<ISTO_BUCKET; i++) n += tutte_attese.conteggio[i];
+    if(n) {
+        r.attesa_p50 = isto_percentile(&tutte_attese, n, 50);
+        r.attesa_p90 = isto_percentile(&tutte_attese, n, 90);
+        r.attesa_p99 = isto_percentile(&tutte_attese, n, 99);
+    }
+    if (esito) *esito = r;
+    if (fd_risultato < 0) return;
+    if (write(fd_risultato, &r, sizeof(r)) != (ssize_t)sizeof(r)) perror("write risultato");
+    close(fd_risultato);
+    fd_risultato = -1;
+}
 
-    const char *conf_file = (argc > 1) ? argv[1] : "conf/config_timeout.conf";
-    Config cfg_local;
-    load_config(conf_file, &cfg_local);
-    
-    printf("[Direttore] Avvio simulazione: %d giorni, %d utenti, soglia %d\n", 
-            cfg_local.sim_duration, cfg_local.nof_users, cfg_local.explode_threshold);
+// dst += segno * src, campo per campo
+static void stats_somma(Stats *dst, const Stats *src, int segno) {
+    dst->utenti_serviti += segno * src->utenti_serviti;
+    dst->servizi_non_erogati += segno * src->servizi_non_erogati;
+    dst->tempo_attesa_totale += segno * src->tempo_attesa_totale;
+    dst->tempo_servizio_totale += segno * src->tempo_servizio_totale;
+    dst->pause_effettuate += segno * src->pause_effettuate;
+    dst->operatori_attivi += segno * src->operatori_attivi;
+    for(int i=0; i<MAX_SERVIZI; i++)
+        dst->servizi_erogati[i] += segno * src->servizi_erogati[i];
+}
 
-    // --- 1. FASE DI SETUP IPC ---
-    // Creo le risorse con permessi 0666 (RW per tutti)
-    shm_id = shmget(KEY_SHM, sizeof(SharedData), IPC_CREAT | 0666);
-    if (shm_id < 0) { perror("shmget"); exit(1); }
+// Somma coerente degli slot operatore (lettore del seqlock, nessun mutex):
+// rileggo lo slot finché seq è pari e invariato tra inizio e fine copia
+static void snapshot_operatori(SharedData *shm, Stats *somma, int con_lotti) {
+    memset(somma, 0, sizeof(Stats));
+    for(int i=0; i<shm->cfg.nof_workers; i++) {
+        SlotOperatore *slot = &shm->slot_operatori[i];
+        Stats copia;
+        for(;;) {
+            unsigned int inizio = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if(!(inizio & 1)) {
+                memcpy(&copia, &slot->stats, sizeof(Stats));
+                // Metriche live: anche i serviti dei lotti non ancora scaricati
+                if(con_lotti) {
+                    copia.utenti_serviti += __atomic_load_n(&slot->in_lotto, __ATOMIC_RELAXED);
+                    for(int s=0; s<shm->cfg.num_servizi; s++)
+                        copia.servizi_erogati[s] += __atomic_load_n(&slot->in_lotto_servizio[s], __ATOMIC_RELAXED);
+                }
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == inizio) break;
+            }
+            shm->contesa.seqlock_ritentativi++;
+            sched_yield();
+        }
+        stats_somma(somma, &copia, 1);
+    }
+}
 
-    // Creo array di semafori: Mutex + Start + 1 per ogni servizio (coda)
-    sem_id = semget(KEY_SEM, 2 + NUM_SERVICES, IPC_CREAT | 0666);
-    if (sem_id < 0) { perror("semget"); exit(1); }
+// Cumulativi di ieri sera: le statistiche del giorno si ricavano per differenza
+// (un solo Direttore per processo; riprendi_contabilita li ricostruisce dopo un checkpoint)
+static Stats stats_ieri;
+static long respinti_ieri;
+static Istogramma *isto_ieri;   // Due per servizio: attesa e servizio
 
-    msg_id = msgget(KEY_MSG, IPC_CREAT | 0666);
-    if (msg_id < 0) { perror("msgget"); exit(1); }
-    
-    // Attach e azzeramento memoria (fondamentale per pulire esecuzioni precedenti sporche)
-    SharedData *shm = (SharedData *)shmat(shm_id, NULL, 0);
-    if (shm == (void*)-1) { perror("shmat"); cleanup(); }
-    memset(shm, 0, sizeof(SharedData)); 
-    shm->cfg = cfg_local; // Pubblico la config in SHM per i figli
+// Statistiche di oggi = cumulativo attuale - cumulativo di ieri sera
+// I rinunciatari per coda piena contano come servizi non erogati
+static void raccogli_giornata(SharedData *shm) {
+    Stats oggi;
+    snapshot_operatori(shm, &oggi, 0);
+    shm->stats_giornaliere = oggi;
+    stats_somma(&shm->stats_giornaliere, &stats_ieri, -1);
+    stats_ieri = oggi;
 
-    // Inizializzazione Semafori (SETVAL)
-    semctl(sem_id, SEM_MUTEX, SETVAL, 1); // MUTEX LIBERO (1) -> Binary Semaphore
-    semctl(sem_id, SEM_START, SETVAL, 0); // BARRIERA CHIUSA (0) -> Nessuno parte finché non lo dico io
-    for(int i=0; i<NUM_SERVICES; i++) semctl(sem_id, SEM_QUEUE_BASE+i, SETVAL, 0); // Code inizialmente vuote
+    long respinti = __atomic_load_n(&shm->utenti_respinti, __ATOMIC_RELAXED);
+    shm->stats_giornaliere.servizi_non_erogati += respinti - respinti_ieri;
+    respinti_ieri = respinti;
+}
 
-    
+// --- METRICHE LIVE (bin/monitor) ---
+static long tick_ns = 100000000L; // --metrics-tick=MS: periodo di pubblicazione (0 = spente)
 
-    // --- 2. FASE DI FORKING ---
-    // Uso il pattern fork() + exec() per rispettare la modularità richiesta.
-    
-    // Processo Erogatore Ticket
-    if (fork() == 0) { 
+// Pubblica lo snapshot dell'ufficio: unico scrittore è il thread principale del Direttore,
+// che legge gli slot operatore col seqlock e il resto con load atomici, senza SEM_MUTEX
+static void pubblica_live(SharedData *shm, int giorno, int fine) {
+    static long serviti_prima, t_prima;
+    if (tick_ns <= 0) return;
+
+    Stats somma;
+    snapshot_operatori(shm, &somma, 1);
+    long ora = adesso_ns();
+    if (somma.utenti_serviti < serviti_prima) t_prima = 0; // Scenario nuovo: contatori da zero
+
+    SnapshotLive *s = &shm->live.s;
+    seqlock_scrivi_inizio(&shm->live.seq);
+    s->versione++;
+    s->t_ns = ora;
+    s->giorno = giorno;
+    s->ufficio_aperto = shm->ufficio_aperto;
+    s->fine = fine;
+    s->nof_workers = shm->cfg.nof_workers;
+    s->nof_users = shm->cfg.nof_users;
+    s->sim_duration = shm->cfg.sim_duration;
+    s->num_servizi = shm->cfg.num_servizi;
+    s->num_sportelli = shm->cfg.num_sportelli;
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        s->code[i] = __atomic_load_n(&shm_servizio(shm, i)->in_attesa, __ATOMIC_RELAXED);
+        s->serviti_servizio[i] = somma.servizi_erogati[i];
+    }
+    for(int i=0; i<shm->cfg.num_sportelli; i++) {
+        Sportello *sp = shm_sportello(shm, i);
+        s->sportelli_mapping[i] = sp->servizio;
+        s->sportelli_occupati[i] = __atomic_load_n(&sp->occupato, __ATOMIC_RELAXED) != 0;
+    }
+    s->serviti = somma.utenti_serviti;
+    s->non_erogati = shm->stats_totali.servizi_non_erogati;
+    s->respinti = __atomic_load_n(&shm->utenti_respinti, __ATOMIC_RELAXED);
+    s->ticket = 0;
+    for(int v=0; v<NUM_VIE_TICKET; v++) s->ticket += __atomic_load_n(&shm->ticket_emessi[v], __ATOMIC_RELAXED);
+    s->serviti_al_secondo = t_prima && ora > t_prima ? (somma.utenti_serviti - serviti_prima) * 1e9 / (ora - t_prima) : 0;
+    seqlock_scrivi_fine(&shm->live.seq);
+
+    serviti_prima = somma.utenti_serviti;
+    t_prima = ora;
+}
+
+// Attesa fino a scadenza (la fine della giornata) spezzata in tick: a ogni tick uno snapshot
+// Scadenza e tick sono assoluti (griglia partita ora), quindi né il costo delle pubblicazioni
+// né i ritardi dei risvegli allungano la giornata
+static void attendi_pubblicando(SharedData *shm, long scadenza, int giorno) {
+    long tick = adesso_ns();
+    for (;;) {
+        pubblica_live(shm, giorno, 0);
+        long ora = adesso_ns();
+        if (ora >= scadenza) break;
+        long sveglia = scadenza;
+        if (tick_ns > 0) {
+            while (tick <= ora) tick += tick_ns;
+            if (tick < scadenza) sveglia = tick;
+        }
+        deriva_registra(&shm->deriva_direttore, sveglia - ora, dormi_fino(sveglia));
+    }
+}
+
+// Chiusura guidata dagli operatori: invece di un'attesa fissa dormo sul futex
+// operatori_in_turno finché l'ultimo non ha finito il servizio in corso (e la coda residua,
+// entro CLOSE_MINUTES), con uno snapshot live a ogni tick
+// Il tetto di sicurezza (grazia + una pausa + il servizio più lungo, con margine per lo
+// scheduler) evita che un operatore morto blocchi il Direttore: ritorna chi è ancora in turno
+static unsigned int attendi_operatori(SharedData *shm, int giorno) {
+    const Config *cfg = &shm->cfg;
+    int minuti_max = 0;
+    for (int s = 0; s < cfg->num_servizi; s++)
+        if (cfg->servizi[s].minuti > minuti_max) minuti_max = cfg->servizi[s].minuti;
+    long scadenza = shm->chiusura_ns + grazia_ns(cfg)
+                  + 2L * (10 + 2 * minuti_max) * cfg->nano_secs_per_min + 100000000L;
+    for (;;) {
+        pubblica_live(shm, giorno, 0);
+        unsigned int in_turno = __atomic_load_n(&shm->operatori_in_turno, __ATOMIC_ACQUIRE);
+        long resto = scadenza - adesso_ns();
+        if (!in_turno || resto <= 0) return in_turno;
+        long passo = tick_ns > 0 && tick_ns < resto ? tick_ns : resto;
+        struct timespec ts = {passo / 1000000000L, passo % 1000000000L};
+        futex_attendi(&shm->operatori_in_turno, in_turno, &ts);
+    }
+}
+
+// oggi = cum - prec, poi prec = cum
+// Il massimo del giorno non si ottiene per differenza: lo stimo dal bucket più alto
+// non vuoto (limitato dal massimo assoluto), con la precisione dell'istogramma
+static void isto_differenza(Istogramma *oggi, const Istogramma *cum, Istogramma *prec) {
+    long max_cum = __atomic_load_n(&cum->max, __ATOMIC_RELAXED);
+    oggi->max = 0;
+    for(int i=0; i<ISTO_BUCKET; i++) {
+        long c = __atomic_load_n(&cum->conteggio[i], __ATOMIC_RELAXED);
+        oggi->conteggio[i] = c - prec->conteggio[i];
+        prec->conteggio[i] = c;
+        if (oggi->conteggio[i]) oggi->max = isto_valore(i) < max_cum ? isto_valore(i) : max_cum;
+    }
+}
+
+// Chiusura contabile della giornata: conta i residui in coda come "non erogati"
+// e accumula le statistiche giornaliere nei totali. Ritorna il numero di utenti rimasti
+// Va chiamata a ufficio chiuso, dopo aver raccolto le statistiche del giorno (o dal motore DES)
+int chiudi_giornata(SharedData *shm) {
+    Stats *g = &shm->stats_giornaliere, *t = &shm->stats_totali;
+
+    // Istogrammi di oggi = cumulativi - cumulativi di ieri sera (due per servizio)
+    if(!isto_ieri && !(isto_ieri = calloc(2 * shm->cfg.num_servizi, sizeof(Istogramma)))) { perror("calloc"); exit(1); }
+    int rimasti_in_coda = 0;
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        ServizioCondiviso *sv = shm_servizio(shm, i);
+        isto_differenza(&sv->attesa_giorno, &sv->attesa, &isto_ieri[2 * i]);
+        isto_differenza(&sv->servizio_giorno, &sv->servizio, &isto_ieri[2 * i + 1]);
+        rimasti_in_coda += sv->in_attesa;
+        g->servizi_non_erogati += sv->in_attesa;
+    }
+
+    stats_somma(t, g, 1);
+
+    // Tempo libero degli sportelli: chi è ancora libero alla chiusura lo è stato fino a lì
+    // Svuoto le bitmask, così fino all'assegnazione di domani nessuno li occupa più
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        unsigned long liberi = __atomic_exchange_n(&shm_servizio(shm, i)->sportelli_liberi, 0, __ATOMIC_ACQ_REL);
+        for(; liberi; liberi &= liberi - 1) {
+            Sportello *sp = shm_sportello(shm, __builtin_ctzl(liberi));
+            __atomic_fetch_add(&sp->ns_libero, periodo_libero(shm, sp->libero_da, shm->chiusura_ns), __ATOMIC_RELAXED);
+        }
+    }
+    for(int i=0; i<shm->cfg.num_sportelli; i++)
+        if(shm_sportello(shm, i)->servizio != -1) shm->ns_liberi_totale += shm_sportello(shm, i)->ns_libero;
+    shm->ns_aperti_totale += shm->sportelli_aperti * (shm->chiusura_ns - shm->apertura_ns);
+
+    return rimasti_in_coda;
+}
+
+// Il checkpoint è scritto a fine giornata, subito dopo chiudi_giornata: i cumulativi
+// dell'immagine sono proprio quelli di "ieri sera". Su un segmento appena azzerato
+// (scenario nuovo, altra simulazione DES nello stesso processo) "ieri" torna a zero
+void riprendi_contabilita(SharedData *shm) {
+    snapshot_operatori(shm, &stats_ieri, 0);
+    respinti_ieri = shm->utenti_respinti;
+    free(isto_ieri); // I servizi possono essere cambiati
+    if(!(isto_ieri = calloc(2 * shm->cfg.num_servizi, sizeof(Istogramma)))) { perror("calloc"); exit(1); }
+    for(int i=0; i<shm->cfg.num_servizi; i++) {
+        isto_ieri[2 * i] = shm_servizio(shm, i)->attesa;
+        isto_ieri[2 * i + 1] = shm_servizio(shm, i)->servizio;
+    }
+}
+
+// Tempo trascorso in ms da t0 (per le latenze delle fasi di avvio)
+static double ms_da(long t0) { return (adesso_ns() - t0) / 1e6; }
+
+// Avvia un eseguibile dei figli: posix_spawn (vfork + exec in glibc) non copia le
+// tabelle delle pagine del Direttore, quindi il costo non cresce con la sua memoria
+static void lancia(char *const args[]) {
+    // Come l'execve originale nessuna variabile ereditata: solo il namespace IPC, più i
+    // segmenti della traccia (--trace) e del profilo IPC (make profilo) quando esistono
+    char *env[4] = { env_ipc };
+    int n_env = 1;
+    if (traccia_env()) env[n_env++] = (char *)traccia_env();
+    if (profilo_env()) env[n_env++] = (char *)profilo_env();
+    pid_t pid;
+    int err = posix_spawn(&pid, args[0], NULL, NULL, args, env);
+    if (err) {
+        fprintf(stderr, "[Direttore] posix_spawn %s fallita: %s\n", args[0], strerror(err));
+        cleanup();
+    }
+}
+
+// --- AVVIO DEGLI ATTORI (motore a processi) ---
+// Ogni attore resta un eseguibile separato (modularità richiesta), lanciato con posix_spawn
+// Utenti: con "zygote" lancio un bin/utente per CPU che fa l'attach una volta sola e poi
+// genera i suoi utenti con fork() (niente exec per utente); con "spawn" un posix_spawn ciascuno
+static void avvia_processi(const Config *cfg, int zygote) {
+    // Processo Erogatore Ticket (solo per la via di compatibilità su Message Queue)
+    if (cfg->modalita_ticket == TICKET_MSG) {
         char *args[] = { "./bin/erogatore", NULL };
-        execve("./bin/erogatore", args, NULL); 
-        perror("Exec erogatore fallita"); exit(1); 
+        lancia(args);
     }
 
     // Processi Operatori
-    for(int i=0; i<cfg_local.nof_workers; i++) {
-        if (fork() == 0) { 
-            char *args[] = { "./bin/operatore", NULL };
-            execve("./bin/operatore", args, NULL); 
-            exit(1); 
+    for(int i=0; i<cfg->nof_workers; i++) {
+        // L'indice identifica lo slot statistiche dell'operatore in SHM
+        char idx[12]; sprintf(idx, "%d", i);
+        char *args[] = { "./bin/operatore", idx, NULL };
+        lancia(args);
+    }
+
+    if (zygote) {
+        long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        int n_zygoti = n_cpu < 1 ? 1 : (n_cpu < cfg->nof_users ? (int)n_cpu : cfg->nof_users);
+        for(int z=0, primo=0; z<n_zygoti; z++) {
+            // Divido gli utenti in intervalli contigui di indici, di dimensione quasi uguale
+            int quanti = cfg->nof_users / n_zygoti + (z < cfg->nof_users % n_zygoti);
+            char opt[40]; sprintf(opt, "--zygote=%d:%d", primo, quanti);
+            char *args[] = { "./bin/utente", opt, NULL };
+            lancia(args);
+            primo += quanti;
         }
+        return;
     }
 
-    // Processi Utenti (passo la probabilità P come argomento stringa)
-    for(int i=0; i<cfg_local.nof_users; i++) {
-        if (fork() == 0) { 
-            int p = cfg_local.p_serv_min + (rand() % (cfg_local.p_serv_max - cfg_local.p_serv_min + 1));
-            char p_str[10]; sprintf(p_str, "%d", p);
-            char *args[] = { "./bin/utente", p_str, NULL };
-            execve("./bin/utente", args, NULL); 
-            exit(1); 
+    // Processi Utenti (passo l'indice: da lì l'utente deriva flusso casuale e P_SERV)
+    for(int i=0; i<cfg->nof_users; i++) {
+        char idx[12]; sprintf(idx, "%d", i);
+        char *args[] = { "./bin/utente", idx, NULL };
+        lancia(args);
+    }
+}
+
+// Barriera di prontezza: attendo che tutti i figli abbiano fatto l'attach (segnala_pronto)
+// Dormo sul futex con un timeout breve solo per accorgermi di un figlio morto prima del via
+// La stessa attesa conta gli attori fermi a fine scenario (attendi_scenario)
+static void attendi_attori(unsigned int *contatore, unsigned int attesi, const char *cosa) {
+    struct timespec timeout = {0, 100000000L};
+    for (;;) {
+        unsigned int pronti = __atomic_load_n(contatore, __ATOMIC_ACQUIRE);
+        if (pronti >= attesi) return;
+        futex_attendi(contatore, pronti, &timeout);
+        int stato;
+        pid_t morto = waitpid(-1, &stato, WNOHANG);
+        if (morto > 0) {
+            fprintf(stderr, "[Direttore] Il processo %d è terminato prima del tempo (%u/%u %s)\n",
+                    morto, __atomic_load_n(contatore, __ATOMIC_RELAXED), attesi, cosa);
+            cleanup();
         }
     }
+}
 
-    // Aspetto che il sistema operativo abbia creato le strutture dati dei processi
-    sleep(1); 
-    printf("[Direttore] Processi creati. Apro la barriera (Start)!\n");
-    
-    // Apro il tornello: Sblocco il primo processo che farà scattare la cascata
-    struct sembuf start_op = {SEM_START, 1, 0};
-    semop(sem_id, &start_op, 1); 
+// Fine simulazione: attendo che gli attori escano dai loro loop (si contano in attori_fermi)
+// Qui niente waitpid: un figlio che termina adesso non è un errore. Il tetto di 1 s copre
+// un attore bloccato o già morto, che altrimenti terrebbe fermo il Direttore per sempre
+static void attendi_uscita(SharedData *shm) {
+    struct timespec timeout = {0, 100000000L};
+    for (int giri = 0; giri < 10; giri++) {
+        unsigned int fermi = __atomic_load_n(&shm->attori_fermi, __ATOMIC_ACQUIRE);
+        if (fermi >= shm->attori) return;
+        futex_attendi(&shm->attori_fermi, fermi, &timeout);
+    }
+    fprintf(stderr, "[Direttore] Attori ancora attivi a fine simulazione: %u/%u fermi\n",
+            __atomic_load_n(&shm->attori_fermi, __ATOMIC_RELAXED), shm->attori);
+}
 
-    // --- 3. LOOP DI SIMULAZIONE ---
-    for(int day=1; day<=cfg_local.sim_duration; day++) {
+// Giornate di uno scenario, da primo_giorno fino a SIM_DURATION o all'Explode
+// Ritorna l'ultimo giorno simulato
+static int esegui_giornate(SharedData *shm, const Config *cfg, const Opzioni *o, Rng *rng_sportelli,
+                           int primo_giorno, RingTraccia *ring) {
+    int giorni = 0;
+    for(int day=primo_giorno; day<=cfg->sim_duration; day++) {
+        // Nella rete si apre tutti insieme: aspetto che il coordinatore conceda il giorno
+        if (o->rete && !rete_attendi_giorno(o->ufficio, day)) break;
+        giorni = day;
         
-        printf("\n--- Giorno %d Inizio ---\n", day);
+        if (!o->silenzioso) printf("\n--- Giorno %d Inizio ---\n", day);
+        long t_fase = adesso_ns();
 
         // SEZIONE CRITICA: Modifico lo stato dell'ufficio
-        P(sem_id, SEM_MUTEX); 
-        memset(&shm->stats_giornaliere, 0, sizeof(Stats)); // Reset stats di oggi
+        // Le statistiche di oggi non vanno azzerate: le ricavo a fine giornata dagli slot
+        mutex_lock(shm, sem_id); 
         
         // Assegno i servizi agli sportelli randomicamente
-        for(int i=0; i<MAX_SPORTELLI; i++) {
-            // 70% probabilità che uno sportello sia aperto
-            shm->sportelli_mapping[i] = (rand() % 100 < 70) ? (rand() % NUM_SERVICES) : -1;
-            shm->sportelli_occupati[i] = 0; // Resetto occupazione fisica
-        }
+        assegna_sportelli(shm, rng_sportelli);
+        shm->apertura_ns = adesso_ns(); // Da qui conta il tempo libero degli sportelli
         shm->ufficio_aperto = 1; // Flag "Aperto"
         V(sem_id, SEM_MUTEX);
+        notifica_stato(shm);
+        traccia_scrivi(ring, TR_APERTURA, 0, -1, -1, day, 0);
+        long ns_apertura = adesso_ns() - t_fase;
 
-        // La giornata lavorativa dura 2 secondi reali
-        sleep(2); 
+        // La giornata lavorativa dura DAY_MINUTES simulati dall'apertura, con le metriche live a ogni tick
+        attendi_pubblicando(shm, shm->apertura_ns + giornata_ns(cfg), day);
 
         // CHIUSURA UFFICIO
-        P(sem_id, SEM_MUTEX);
-        shm->ufficio_aperto = 0; // Segnalo chiusura (Utenti e Operatori se ne accorgono in polling)
+        mutex_lock(shm, sem_id);
+        shm->chiusura_ns = adesso_ns();
+        shm->ufficio_aperto = 0; // Segnalo chiusura (Utenti e Operatori svegliati dal futex)
         V(sem_id, SEM_MUTEX);
+        notifica_stato(shm);
+        traccia_scrivi(ring, TR_CHIUSURA, 0, -1, -1, day, 0);
 
-        printf("--- Giorno %d Fine (Ufficio Chiuso) ---\n", day);
-        
-        // Attesa per permettere agli operatori di finire l'ultimo servizio in corso
-        usleep(500000); 
+        if (!o->silenzioso) printf("--- Giorno %d Fine (Ufficio Chiuso) ---\n", day);
+        long ns_giornata = shm->chiusura_ns - shm->apertura_ns;
 
-        // AGGIORNAMENTO STATISTICHE (Sezione Critica)
-        P(sem_id, SEM_MUTEX);
-        
-        // Controllo code residue
-        int rimasti_in_coda = 0;
-        for(int i=0; i<NUM_SERVICES; i++) {
-            rimasti_in_coda += shm->utenti_in_attesa[i];
-            shm->stats_giornaliere.servizi_non_erogati += shm->utenti_in_attesa[i];
-        }
-        
-        // Accumulo le statistiche giornaliere nel totale
-        shm->stats_totali.utenti_serviti += shm->stats_giornaliere.utenti_serviti;
-        shm->stats_totali.servizi_non_erogati += shm->stats_giornaliere.servizi_non_erogati;
-        // ... (copia altri campi) ...
-        shm->stats_totali.operatori_attivi += shm->stats_giornaliere.operatori_attivi;
-        for(int i=0; i<NUM_SERVICES; i++) 
-            shm->stats_totali.servizi_erogati[i] += shm->stats_giornaliere.servizi_erogati[i];
-        
-        V(sem_id, SEM_MUTEX); // Fine Sezione Critica
+        // Gli operatori finiscono l'ultimo servizio in corso: la giornata si chiude appena
+        // sono tutti fuori, senza aspettare un periodo fisso
+        unsigned int in_turno = attendi_operatori(shm, day);
+        if (in_turno)
+            fprintf(stderr, "[Direttore] Giorno %d: %u operatori ancora in turno oltre il periodo di grazia\n",
+                    day, in_turno);
+        t_fase = adesso_ns();
+        long ns_smaltimento = t_fase - shm->chiusura_ns;
 
-        print_stats(shm, day, 0); 
+        // AGGIORNAMENTO STATISTICHE (niente stop-the-world)
+        // Snapshot seqlock degli slot operatore, poi code residue e accumulo nel totale
+        raccogli_giornata(shm);
+        int rimasti_in_coda = chiudi_giornata(shm);
+        traccia_scrivi(ring, TR_FINE_GIORNATA, 0, -1, -1, day, rimasti_in_coda);
+        long ns_raccolta = adesso_ns() - t_fase;
+
+        esporta_giornata(shm, day); // Riga del giorno al thread di scrittura (no-op senza --export)
+        if (!o->silenzioso) {
+            print_stats(shm, day, 0);
+            printf("  Fasi: apertura %.3f ms, giornata %.1f ms, smaltimento %.1f ms, raccolta %.3f ms\n",
+                   ns_apertura / 1e6, ns_giornata / 1e6, ns_smaltimento / 1e6, ns_raccolta / 1e6);
+        }
 
         // CHECK TERMINAZIONE ANTICIPATA (EXPLODE)
-        if(rimasti_in_coda > cfg_local.explode_threshold) {
+        if(rimasti_in_coda > cfg->explode_threshold) {
             printf("\n[CRITICAL] Troppi utenti in coda (%d > %d). Terminazione Explode!\n", 
-                   rimasti_in_coda, cfg_local.explode_threshold);
+                   rimasti_in_coda, cfg->explode_threshold);
             break;
         }
+
+        // Fotografia di fine giornata (attori fermi a ufficio chiuso, statistiche già raccolte)
+        if(o->file_checkpoint && day < cfg->sim_duration && day % o->ogni_giorni == 0)
+            checkpoint_scrivi(o->file_checkpoint, o->engine, day, shm, rng_sportelli, NULL, 0);
+    }
+    if (o->rete) rete_fine(o->ufficio);
+    return giorni;
+}
+
+// Segmento pronto per la Config cfg: azzerato, impaginato, code vuote, sportelli chiusi
+static void prepara_segmento(SharedData *shm, size_t dimensione, const Config *cfg) {
+    memset(shm, 0, dimensione); 
+    shm->cfg = *cfg; // Pubblico la config in SHM per i figli
+    shm_layout(shm, cfg);
+    for(int i=0; i<cfg->num_servizi; i++) coda_init(&shm_servizio(shm, i)->coda);
+    for(int i=0; i<cfg->num_sportelli; i++) shm_sportello(shm, i)->servizio = -1;
+}
+
+// Cambio di scenario (--scenarios) senza toccare risorse IPC e processi:
+// 1. stop_simulation con altri_scenari = 1: gli attori finiscono lo scenario e si fermano
+// 2. con tutti fermi riazzero il segmento per la nuova Config (tranne le parole futex
+//    su cui qualcuno può dormire e la versione delle metriche live) e i semafori delle code
+// 3. nuova generazione di "scenario": gli attori riprendono identità e rifanno la barriera
+static void cambia_scenario(SharedData *shm, size_t dimensione, const Config *dim, const Config *cfg) {
+    unsigned int attori = shm->attori, scenario = shm->scenario, generazione = shm->generazione_stato;
+    shm->stop_simulation = 1;
+    notifica_stato(shm);
+    attendi_attori(&shm->attori_fermi, attori, "fermi");
+
+    MetricheLive live = shm->live;
+    prepara_segmento(shm, dimensione, cfg);
+    shm->live = live;
+    shm->attori = attori;
+    shm->generazione_stato = generazione;
+    semctl(sem_id, SEM_MUTEX, SETVAL, 1);
+    for(int i=0; i<dim->num_servizi; i++) semctl(sem_id, SEM_QUEUE_BASE+i, SETVAL, 0);
+    memset(&memoria_sportelli, 0, sizeof(memoria_sportelli));
+    riprendi_contabilita(shm);
+
+    __atomic_store_n(&shm->scenario, scenario + 1, __ATOMIC_RELEASE);
+    futex(&shm->scenario, FUTEX_WAKE, INT_MAX);
+    attendi_attori(&shm->processi_pronti, attori, "pronti");
+}
+
+// Esegue una simulazione completa. Con privato=1 (repliche) le risorse IPC sono
+// IPC_PRIVATE: ogni replica ha il suo namespace e più simulazioni convivono sulla macchina
+// Con --scenarios esegue in serie o->scenari (cfg è il primo) sulle stesse risorse e attori
+// Nel motore ipc/thread non ritorna: termina con la cleanup
+int simula(Config *cfg, const Opzioni *o, int privato) {
+    // Setup Signal Handler per uscita pulita su CTRL+C
+    signal(SIGINT, handle_sig);
+
+    // Motore a eventi discreti: nessuna risorsa IPC, nessun processo figlio
+    if(!strcmp(o->engine, "des")) return des_esegui(cfg, o);
+    int in_thread = !strcmp(o->engine, "thread");
+    timer_preciso(); // Anche per i thread del motore thread, creati dopo
+
+    // Risorse e attori bastano per lo scenario più grande: servizi e sportelli (layout del
+    // segmento, semafori), operatori e utenti (processi da avviare), Erogatore se serve a uno
+    int n_scenari = o->scenari ? o->n_scenari : 1;
+    // Gli utenti da avviare sono solo gli agenti: gli arrivi della popolazione non hanno attori
+    // (nella rete la popolazione è del coordinatore, che porta ARRIVALS diverso da 0)
+    Config dim = *cfg;
+    dim.nof_users = utenti_agenti(cfg);
+    for(int k=1; k<n_scenari; k++) {
+        const Config *c = &o->scenari[k].cfg;
+        if(c->num_servizi > dim.num_servizi) dim.num_servizi = c->num_servizi;
+        if(c->num_sportelli > dim.num_sportelli) dim.num_sportelli = c->num_sportelli;
+        if(c->nof_workers > dim.nof_workers) dim.nof_workers = c->nof_workers;
+        if(utenti_agenti(c) > dim.nof_users) dim.nof_users = utenti_agenti(c);
+        if(c->modalita_ticket == TICKET_MSG) dim.modalita_ticket = TICKET_MSG;
+    }
+
+    // Gli utenti generati dagli zygote sono miei nipoti: se uno zygote muore li adotto io,
+    // così la wait della cleanup li raccoglie comunque
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+    
+    if (o->scenari) printf("\n========== SCENARIO 1/%d: %s ==========\n", n_scenari, o->scenari[0].nome);
+    printf("[Direttore] Avvio simulazione: %d giorni, %d utenti, %d servizi, %d sportelli, soglia %d, SEED=%lu\n", 
+            cfg->sim_duration, cfg->nof_users, cfg->num_servizi, cfg->num_sportelli, cfg->explode_threshold, cfg->seme);
+    Rng rng_sportelli; // Flusso del Direttore per la mappa mattutina degli sportelli
+    rng_init(&rng_sportelli, cfg->seme, FLUSSO_SPORTELLI);
+
+    // --- 1. FASE DI SETUP IPC ---
+    long t_avvio = adesso_ns();
+    // Creo le risorse con permessi 0666 (RW per tutti)
+    // Segmento dimensionato sulla Config: servizi e sportelli dichiarati nel .conf
+    size_t dimensione = shm_dimensione(&dim);
+    shm_id = shmget(privato ? IPC_PRIVATE : KEY_SHM, dimensione, IPC_CREAT | 0666);
+    if (shm_id < 0) { perror("shmget"); exit(1); }
+
+    // Creo array di semafori: Mutex + Start + 1 per ogni servizio (coda)
+    sem_id = semget(privato ? IPC_PRIVATE : KEY_SEM, TOTAL_SEMS(&dim), IPC_CREAT | 0666);
+    if (sem_id < 0) { perror("semget"); exit(1); }
+
+    msg_id = msgget(privato ? IPC_PRIVATE : KEY_MSG, IPC_CREAT | 0666);
+    if (msg_id < 0) { perror("msgget"); exit(1); }
+    snprintf(env_ipc, sizeof(env_ipc), "%s=%d:%d:%d", ENV_IPC, shm_id, sem_id, msg_id);
+    
+    // Attach e azzeramento memoria (fondamentale per pulire esecuzioni precedenti sporche)
+    SharedData *shm = (SharedData *)shmat(shm_id, NULL, 0);
+    if (shm == (void*)-1) { perror("shmat"); cleanup(); }
+    prepara_segmento(shm, dimensione, cfg);
+    ipc_contatore = &shm->contesa.operazioni_ipc; // Anche gli attori del motore a thread
+    if (o->rete) rete_registra(o->ufficio, shm_id, sem_id); // Gli arrivi li consegna il coordinatore
+
+    // Ripresa: il segmento torna com'era a fine giornata, code della notte comprese
+    int primo_giorno = 1;
+    if (o->ripresa) primo_giorno = checkpoint_ripristina(shm, o->ripresa, &rng_sportelli);
+    shm->attori = dim.nof_workers + dim.nof_users;
+
+    // Inizializzazione Semafori (SETVAL)
+    semctl(sem_id, SEM_MUTEX, SETVAL, 1); // MUTEX LIBERO (1) -> Binary Semaphore
+    semctl(sem_id, SEM_START, SETVAL, 0); // BARRIERA CHIUSA (0) -> Nessuno parte finché non lo dico io
+    // Code inizialmente vuote, oppure con i ticket rimasti nelle code del checkpoint
+    for(int i=0; i<dim.num_servizi; i++) {
+        CodaTicket *c = &shm_servizio(shm, i)->coda;
+        semctl(sem_id, SEM_QUEUE_BASE+i, SETVAL, i < cfg->num_servizi ? (int)(c->coda - c->testa) : 0);
     }
 
-    printf("\n--- FINE SIMULAZIONE ---\n");
-    print_stats(shm, 0, 1); // Report finale
+    
+
+    // Traccia binaria: il segmento deve esistere prima che i figli facciano l'attach
+    Traccia *traccia = NULL;
+    if (o->file_traccia && !(traccia = traccia_avvia(o->file_traccia, cfg))) cleanup();
+    RingTraccia *ring = traccia_ring_direttore(traccia);
+    profilo_avvia(&dim); // Idem per il profilo IPC (make profilo)
+    if (o->file_esporta && esporta_avvia(o->file_esporta, cfg) < 0) { codice_uscita = 1; cleanup(); }
+
+    // --- 2. FASE DI AVVIO DEGLI ATTORI ---
+    double ms_ipc = ms_da(t_avvio);
+    long t_fase = adesso_ns();
+    // Nel motore "thread" gli stessi attori diventano thread del Direttore
+    if (in_thread) {
+        pool = pool_avvia(shm, sem_id, msg_id, (int)o->n_thread, traccia);
+        printf("[Direttore] Thread avviati (%ld nel pool utenti). Apro la barriera (Start)!\n", o->n_thread);
+        printf("[Direttore] Avvio: IPC %.2f ms, thread %.2f ms, totale %.2f ms\n",
+               ms_ipc, ms_da(t_fase), ms_da(t_avvio));
+    } else {
+        avvia_processi(&dim, o->zygote);
+        double ms_spawn = ms_da(t_fase);
+        t_fase = adesso_ns();
+        attendi_attori(&shm->processi_pronti, shm->attori, "pronti");
+        printf("[Direttore] Processi creati e pronti. Apro la barriera (Start)!\n");
+        printf("[Direttore] Avvio: IPC %.2f ms, spawn %.2f ms (%d processi), attach %.2f ms, totale %.2f ms\n",
+               ms_ipc, ms_spawn, shm->attori, ms_da(t_fase), ms_da(t_avvio));
+    }
+    
+    pubblica_live(shm, 0, 0); // Giorno 0: attori pronti, ufficio non ancora aperto
+    if (cfg->arrivi != ARRIVI_AGENTI && !o->rete) {
+        popolazione = popolazione_crea(cfg);
+        popolazione_avvia(popolazione, shm, sem_id, ring);
+    }
+
+    // Apro il tornello: Sblocco il primo processo che farà scattare la cascata
+    struct sembuf start_op = {SEM_START, 1, 0};
+    semop(sem_id, &start_op, 1); 
+
+    // --- 3. LOOP DI SIMULAZIONE ---
+    // Uno scenario dopo l'altro (uno solo senza --scenarios): tra due scenari restano
+    // segmento, semafori, coda messaggi e attori, cambiano Config e statistiche
+    int giorni = 0;
+    long t_preparazione = t_avvio;
+    for(int k=0; ; k++) {
+        shm->altri_scenari = k + 1 < n_scenari;
+        long t_giornate = adesso_ns();
+        giorni = esegui_giornate(shm, cfg, o, &rng_sportelli, primo_giorno, ring);
+
+        printf("\n--- FINE SIMULAZIONE ---\n");
+        print_stats(shm, 0, 1); // Report finale
+        if (popolazione) popolazione_report(popolazione);
+        // Alla raccolta delle repliche (no-op senza --replications) e al confronto degli scenari
+        pubblica_risultato(shm, giorni, o->scenari ? &o->scenari[k].esito : NULL);
+        if (o->scenari) {
+            o->scenari[k].ms_preparazione = (t_giornate - t_preparazione) / 1e6;
+            o->scenari[k].secondi = (adesso_ns() - t_giornate) / 1e9;
+        }
+        if (!shm->altri_scenari) break;
+
+        cfg = &o->scenari[k + 1].cfg;
+        printf("\n========== SCENARIO %d/%d: %s ==========\n", k + 2, n_scenari, o->scenari[k + 1].nome);
+        printf("[Direttore] Avvio simulazione: %d giorni, %d utenti, %d servizi, %d sportelli, soglia %d, SEED=%lu\n", 
+                cfg->sim_duration, cfg->nof_users, cfg->num_servizi, cfg->num_sportelli, cfg->explode_threshold, cfg->seme);
+        t_preparazione = adesso_ns();
+        if (popolazione) {
+            popolazione_ferma(popolazione);
+            popolazione_libera(popolazione);
+            popolazione = NULL;
+        }
+        cambia_scenario(shm, dimensione, &dim, cfg);
+        rng_init(&rng_sportelli, cfg->seme, FLUSSO_SPORTELLI);
+        if (cfg->arrivi != ARRIVI_AGENTI) {
+            popolazione = popolazione_crea(cfg);
+            popolazione_avvia(popolazione, shm, sem_id, ring);
+        }
+        printf("[Direttore] Cambio di scenario: %.2f ms (risorse IPC e %d attori riusati)\n",
+               ms_da(t_preparazione), shm->attori);
+    }
+    pubblica_live(shm, giorni, 1);   // Ultimo snapshot: bin/monitor termina
+    if (o->scenari) scenari_confronto(o);
     
     shm->stop_simulation = 1; // Dico ai figli di uscire dai loro while
-    sleep(1); // Do tempo ai figli di leggere il flag
+    notifica_stato(shm);
+    if (popolazione) popolazione_ferma(popolazione);
+    // Figli e thread vanno attesi tutti: dopo lo shmdt qui sotto la SHM sparirebbe
+    // anche sotto i loro piedi (e il tempo di parete del bench non deve contare pause a vuoto)
+    if (pool) pool_termina(pool);
+    else attendi_uscita(shm);
+    traccia_termina(); // Ultimi record e chiusura del file
+    if (esporta_termina() < 0) codice_uscita = 1;
+    profilo_report(shm); // Attori fermi: i contatori del profilo IPC non cambiano più
 
     // Stacco la mia referenza alla SHM prima di distruggerla
+    ipc_contatore = NULL;
     shmdt(shm); 
     
     cleanup(); // Chiamo la pulizia finale
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+    // Parsing argomenti: opzioni "--chiave=valore" e, come posizionale, il file di config
+    const char *conf_file = "conf/config_timeout.conf";
+    Opzioni o = { "ipc", 4 * sysconf(_SC_NPROCESSORS_ONLN), 1, NULL, NULL, 1, NULL, NULL, 0, NULL, 0, 0, NULL, 0 };
+    int riprendi = 0;                                  // --resume: riparte dall'ultimo checkpoint
+    const char *tickets = "shm";
+    const char *steal = NULL;                          // NULL: vale STEAL_POLICY del .conf
+    const char *alloc = NULL;                          // NULL: vale ALLOC_POLICY del .conf
+    int lotto = 0;                                     // --stats-batch=N: 0 = STATS_BATCH del .conf
+    const char *spawn = "zygote";
+    const char *seme_cli = NULL;                       // --seed=S: sovrascrive SEED del .conf
+    int repliche = 0;                                  // --replications=N: N simulazioni indipendenti
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);         // --jobs=J: repliche in parallelo
+    const char *file_scenari = NULL;                   // --scenarios=FILE: più Config in serie
+    const char *arrivi = NULL;                         // --arrivals=MODELLO: NULL = ARRIVALS del .conf
+    const char *instrada = "nearest";                  // --routing=POLITICA (solo con --offices)
+    for(int i=1; i<argc; i++) {
+        if(!strncmp(argv[i], "--engine=", 9)) o.engine = argv[i] + 9;
+        else if(!strncmp(argv[i], "--threads=", 10)) o.n_thread = atol(argv[i] + 10);
+        else if(!strncmp(argv[i], "--tickets=", 10)) tickets = argv[i] + 10;
+        else if(!strncmp(argv[i], "--steal=", 8)) steal = argv[i] + 8;
+        else if(!strncmp(argv[i], "--alloc=", 8)) alloc = argv[i] + 8;
+        else if(!strncmp(argv[i], "--stats-batch=", 14)) lotto = atoi(argv[i] + 14);
+        else if(!strncmp(argv[i], "--spawn=", 8)) spawn = argv[i] + 8;
+        else if(!strncmp(argv[i], "--trace=", 8)) o.file_traccia = argv[i] + 8;
+        else if(!strncmp(argv[i], "--replications=", 15)) repliche = atoi(argv[i] + 15);
+        else if(!strncmp(argv[i], "--jobs=", 7)) jobs = atol(argv[i] + 7);
+        else if(!strncmp(argv[i], "--seed=", 7)) seme_cli = argv[i] + 7;
+        else if(!strncmp(argv[i], "--metrics-tick=", 15)) tick_ns = atol(argv[i] + 15) * 1000000L;
+        else if(!strncmp(argv[i], "--checkpoint=", 13)) o.file_checkpoint = argv[i] + 13;
+        else if(!strncmp(argv[i], "--checkpoint-every=", 19)) o.ogni_giorni = atoi(argv[i] + 19);
+        else if(!strcmp(argv[i], "--resume")) riprendi = 1;
+        else if(!strncmp(argv[i], "--scenarios=", 12)) file_scenari = argv[i] + 12;
+        else if(!strncmp(argv[i], "--arrivals=", 11)) arrivi = argv[i] + 11;
+        else if(!strncmp(argv[i], "--offices=", 10)) o.rete = argv[i] + 10;
+        else if(!strncmp(argv[i], "--routing=", 10)) instrada = argv[i] + 10;
+        else if(!strncmp(argv[i], "--export=", 9)) o.file_esporta = argv[i] + 9;
+        else if(!strcmp(argv[i], "--quiet")) o.silenzioso = 1;
+        else if(argv[i][0] != '-') conf_file = argv[i];
+        else { fprintf(stderr, "Opzione sconosciuta: %s\n", argv[i]); exit(1); }
+    }
+
+    // Con --resume la Config arriva dal checkpoint: il .conf non serve
+    // Con --scenarios le Config sono quelle del file, una per scenario
+    Config cfg_local;
+    Scenario *scenari = NULL;
+    int n_config = 1;
+    if(file_scenari) n_config = o.n_scenari = scenari_carica(file_scenari, &scenari);
+    else if(riprendi) memset(&cfg_local, 0, sizeof(cfg_local));
+    else load_config(conf_file, &cfg_local);
+
+    // Le opzioni da riga di comando valgono per tutte le Config
+    // Senza SEED ne scelgo uno dall'orologio: viene stampato, quindi l'esecuzione resta riproducibile
+    // Gli scenari senza SEED condividono lo stesso (numeri casuali comuni: le differenze
+    // tra scenari vengono dai parametri, non dal caso)
+    unsigned long seme_orologio = (unsigned long)time(NULL) ^ ((unsigned long)getpid() << 32);
+    for(int k=0; k<n_config; k++) {
+        Config *c = scenari ? &scenari[k].cfg : &cfg_local;
+        if(!strcmp(tickets, "msg")) c->modalita_ticket = TICKET_MSG;
+        else if(strcmp(tickets, "shm")) { fprintf(stderr, "Via ticket sconosciuta: %s\n", tickets); exit(1); }
+        if(steal) {
+            if(!strcmp(steal, "off")) c->politica_furto = FURTO_NESSUNO;
+            else if(!strcmp(steal, "longest")) c->politica_furto = FURTO_PIU_LUNGA;
+            else if(!strcmp(steal, "random")) c->politica_furto = FURTO_CASUALE;
+            else { fprintf(stderr, "Politica di furto sconosciuta: %s\n", steal); exit(1); }
+        }
+        if(alloc) {
+            if(!strcmp(alloc, "random")) c->politica_sportelli = ALLOC_CASUALE;
+            else if(!strcmp(alloc, "load")) c->politica_sportelli = ALLOC_CARICO;
+            else { fprintf(stderr, "Politica degli sportelli sconosciuta: %s\n", alloc); exit(1); }
+        }
+
+        if(arrivi) {
+            if(!strcmp(arrivi, "agents")) c->arrivi = ARRIVI_AGENTI;
+            else if(!strcmp(arrivi, "pserv")) c->arrivi = ARRIVI_PSERV;
+            else if(!strcmp(arrivi, "poisson")) c->arrivi = ARRIVI_POISSON;
+            else if(!strcmp(arrivi, "profile")) c->arrivi = ARRIVI_FASCE;
+            else { fprintf(stderr, "Modello di arrivo sconosciuto: %s\n", arrivi); exit(1); }
+            config_valida(c);
+        }
+        // La popolazione vive nel Direttore e non entra nella fotografia di fine giornata
+        if(c->arrivi != ARRIVI_AGENTI && (o.file_checkpoint || riprendi)) {
+            fprintf(stderr, "--checkpoint e --resume richiedono gli arrivi degli agenti (ARRIVALS=0)\n");
+            exit(1);
+        }
+
+        if(lotto) { c->lotto_statistiche = lotto; limita_lotto(c); }
+
+        c->traccia = o.file_traccia != NULL;
+        if(seme_cli) c->seme = strtoul(seme_cli, NULL, 10);
+        if(!c->seme) c->seme = seme_orologio;
+    }
+
+    if(o.file_traccia && !strcmp(o.engine, "des")) { fprintf(stderr, "--trace richiede il motore ipc o thread\n"); exit(1); }
+    if(strcmp(o.engine, "ipc") && strcmp(o.engine, "thread") && strcmp(o.engine, "des")) {
+        fprintf(stderr, "Motore sconosciuto: %s\n", o.engine); exit(1);
+    }
+    o.zygote = !strcmp(spawn, "zygote");
+    if(!o.zygote && strcmp(spawn, "spawn")) { fprintf(stderr, "Avvio sconosciuto: %s\n", spawn); exit(1); }
+    if(o.ogni_giorni < 1) o.ogni_giorni = 1;
+
+    // Scenari in serie sulle stesse risorse IPC e sugli stessi attori, con confronto finale
+    if(scenari) {
+        if(o.rete || o.file_esporta) { fprintf(stderr, "--scenarios non è compatibile con --offices e --export\n"); exit(1); }
+        if(riprendi || o.file_checkpoint || o.file_traccia || repliche > 0) {
+            fprintf(stderr, "--scenarios non è compatibile con --resume, --checkpoint, --trace e --replications\n");
+            exit(1);
+        }
+        if(!strcmp(o.engine, "thread")) { fprintf(stderr, "--scenarios richiede il motore ipc o des\n"); exit(1); }
+        o.scenari = scenari;
+        return scenari_esegui(&o);
+    }
+
+    // Ripresa: la Config (seme compreso) è quella del checkpoint, le opzioni del .conf e di
+    // riga di comando che la modificano non contano. Il motore deve essere compatibile:
+    // ipc e thread condividono il significato della SHM, il DES ha in più il suo stato privato
+    Checkpoint ripresa;
+    if(riprendi) {
+        if(!o.file_checkpoint) o.file_checkpoint = CHECKPOINT_DEFAULT;
+        if(checkpoint_apri(o.file_checkpoint, &ripresa) < 0) exit(1);
+        if(!strcmp(ripresa.t->engine, "des") != !strcmp(o.engine, "des")) {
+            fprintf(stderr, "Il checkpoint %s è del motore %s, non utilizzabile con --engine=%s\n",
+                    o.file_checkpoint, ripresa.t->engine, o.engine);
+            exit(1);
+        }
+        cfg_local = ripresa.t->cfg;
+        cfg_local.traccia = o.file_traccia != NULL;
+        o.ripresa = &ripresa;
+        printf("[Direttore] Ripresa da %s: giorno %d di %d completato (motore %s), SEED=%lu\n",
+               o.file_checkpoint, ripresa.t->giorno, cfg_local.sim_duration, ripresa.t->engine, cfg_local.seme);
+    }
+
+    // Rete di uffici: il Direttore fa da coordinatore, ogni ufficio è una simulazione completa
+    if(o.rete) {
+        if(!strcmp(instrada, "nearest")) o.instradamento = INSTRADA_VICINO;
+        else if(!strcmp(instrada, "shortest")) o.instradamento = INSTRADA_CODA;
+        else if(!strcmp(instrada, "wait")) o.instradamento = INSTRADA_ATTESA;
+        else { fprintf(stderr, "Politica di instradamento sconosciuta: %s\n", instrada); exit(1); }
+        if(!strcmp(o.engine, "des")) { fprintf(stderr, "--offices richiede il motore ipc o thread\n"); exit(1); }
+        if(o.file_checkpoint || o.file_traccia || o.file_esporta || repliche > 0) {
+            fprintf(stderr, "--offices non è compatibile con --resume, --checkpoint, --trace, --export e --replications\n");
+            exit(1);
+        }
+        return rete_esegui(&cfg_local, &o);
+    }
+
+    // Modalità Monte Carlo: N simulazioni indipendenti, J alla volta, ognuna in un processo
+    // (e process group) proprio con risorse IPC private; il padre aggrega le Stats
+    if(repliche > 0) {
+        if(o.file_traccia || o.file_esporta) { fprintf(stderr, "--trace e --export non sono compatibili con --replications\n"); exit(1); }
+        if(o.file_checkpoint) { fprintf(stderr, "--checkpoint e --resume non sono compatibili con --replications\n"); exit(1); }
+        return repliche_esegui(&cfg_local, &o, repliche, jobs > 0 ? (int)jobs : 1);
+    }
+
+    return simula(&cfg_local, &o, 0);
+}
@@ -0,0 +1,106 @@
+#include "common.h"
+
+/*
+ * MONITOR.C (Osservatore esterno delle metriche live)
+ * * Uso: ./bin/monitor [--shm=ID] [--intervallo=MS] [--stream]
+ * Si collega alla SHM del Direttore in SOLA LETTURA (SHM_RDONLY) e legge lo snapshot
+ * pubblicato a ogni tick (shm->live) con il protocollo seqlock: nessun semaforo,
+ * nessuna scrittura, quindi la simulazione non si accorge di essere osservata
+ * * Output: cruscotto testuale ridisegnato a ogni snapshot, oppure con --stream una riga
+ * JSON per snapshot (stesso formato JSON Lines di bin/bench) da passare ad altri strumenti
+ * * Termina con l'ultimo snapshot (fine simulazione) o quando il segmento viene rimosso
+ */
+
+#define LARGHEZZA_BARRA 50
+
+static void stampa_json(const SnapshotLive *s, int ritentativi) {
+    printf("{\"versione\":%lu,\"t_ns\":%ld,\"giorno\":%d,\"aperto\":%d,\"fine\":%d,"
+           "\"serviti\":%ld,\"serviti_s\":%.1f,\"non_erogati\":%ld,\"respinti\":%ld,\"ticket\":%ld,"
+           "\"ritentativi\":%d,\"code\":[",
+           s->versione, s->t_ns, s->giorno, s->ufficio_aperto, s->fine, s->serviti,
+           s->serviti_al_secondo, s->non_erogati, s->respinti, s->ticket, ritentativi);
+    for (int i = 0; i < s->num_servizi; i++) printf("%s%d", i ? "," : "", s->code[i]);
+    printf("],\"sportelli\":[");
+    for (int i = 0; i < s->num_sportelli; i++)
+        printf("%s[%d,%d]", i ? "," : "", s->sportelli_mapping[i], s->sportelli_occupati[i]);
+    printf("]}\n");
+}
+
+// I nomi dei servizi vengono dalla Config in SHM (scritta una volta prima del via)
+static void stampa_cruscotto(const SnapshotLive *s, const Config *cfg, long t0, int ritentativi) {
+    printf("\033[H\033[2J"); // Cursore in alto e schermo pulito
+    printf("bin/monitor  snapshot #%lu  giorno %d/%d  %s  t=+%.2f s  (ritentativi seqlock: %d)\n",
+           s->versione, s->giorno, s->sim_duration,
+           s->fine ? "FINE" : (s->ufficio_aperto ? "APERTO" : "CHIUSO"), (s->t_ns - t0) / 1e9, ritentativi);
+    printf("Operatori: %d  Utenti: %d\n", s->nof_workers, s->nof_users);
+    printf("Serviti: %ld (%.1f/s)  Non erogati (giorni chiusi): %ld  Respinti: %ld  Ticket: %ld\n",
+           s->serviti, s->serviti_al_secondo, s->non_erogati, s->respinti, s->ticket);
+
+    printf("-- Code (in attesa o allo sportello) --\n");
+    for (int i = 0; i < s->num_servizi; i++) {
+        int n = s->code[i] > 0 ? s->code[i] : 0;
+        printf("  %-14s %5d |", cfg->servizi[i].nome, n);
+        for (int k = 0; k < n && k < LARGHEZZA_BARRA; k++) putchar('#');
+        if (n > LARGHEZZA_BARRA) putchar('+');
+        printf("  (serviti %ld)\n", s->serviti_servizio[i]);
+    }
+
+    printf("-- Sportelli --\n");
+    for (int i = 0; i < s->num_sportelli; i++) {
+        if (s->sportelli_mapping[i] == -1) continue;
+        printf("  [%d] %-14s %s\n", i, cfg->servizi[s->sportelli_mapping[i]].nome,
+               s->sportelli_occupati[i] ? "OCCUPATO" : "LIBERO");
+    }
+    fflush(stdout);
+}
+
+// Il Direttore ha rimosso il segmento (IPC_RMID) e sono rimasto l'unico collegato?
+static int segmento_rimosso(int shm_id) {
+    struct shmid_ds ds;
+    if (shmctl(shm_id, IPC_STAT, &ds) < 0) return 1;
+    return (ds.shm_perm.mode & SHM_DEST) && ds.shm_nattch <= 1;
+}
+
+int main(int argc, char *argv[]) {
+    int shm_id = -1, stream = 0;
+    long intervallo_ms = 250;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--shm=", 6)) shm_id = atoi(argv[i] + 6);
+        else if (!strncmp(argv[i], "--intervallo=", 13)) intervallo_ms = atol(argv[i] + 13);
+        else if (!strcmp(argv[i], "--stream")) stream = 1;
+        else { fprintf(stderr, "Uso: %s [--shm=ID] [--intervallo=MS] [--stream]\n", argv[0]); return 1; }
+    }
+    if (intervallo_ms < 1) intervallo_ms = 1;
+    struct timespec pausa = {intervallo_ms / 1000, (intervallo_ms % 1000) * 1000000L};
+
+    // Senza --shm cerco la simulazione con la chiave fissa, aspettando che il Direttore la crei
+    int avvisato = 0;
+    while (shm_id < 0 && (shm_id = shmget(KEY_SHM, 0, 0)) < 0) {
+        if (!avvisato++) fprintf(stderr, "[Monitor] In attesa della simulazione (chiave %d)...\n", KEY_SHM);
+        nanosleep(&pausa, NULL);
+    }
+    const SharedData *shm = shmat(shm_id, NULL, SHM_RDONLY);
+    if (shm == (void *)-1) { perror("shmat"); return 1; }
+
+    unsigned long ultima = 0;
+    long t0 = 0;
+    SnapshotLive s;
+    for (;;) {
+        int ritentativi = metriche_leggi(&shm->live, &s);
+        if (s.versione != ultima) {
+            if (!t0) t0 = s.t_ns;
+            ultima = s.versione;
+            if (stream) { stampa_json(&s, ritentativi); fflush(stdout); }
+            else stampa_cruscotto(&s, &shm->cfg, t0, ritentativi);
+            if (s.fine) break;
+        }
+        if (segmento_rimosso(shm_id)) {
+            fprintf(stderr, "[Monitor] Segmento rimosso: simulazione terminata\n");
+            break;
+        }
+        nanosleep(&pausa, NULL);
+    }
+
+    shmdt(shm);
+    return 0;
+}
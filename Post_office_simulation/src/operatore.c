@@ -1,138 +1,385 @@
+#include <stddef.h>
 #include "common.h"
+#include "agenti.h"
 
 /*
  * OPERATORE.C (Il "Consumatore")
  * * Questo processo simula il lavoratore allo sportello
  * * Punti Critici gestiti:
- * 1. Race Conditions sulla scelta del posto (risolto con Mutex)
+ * 1. Race Conditions sulla scelta del posto (risolto con CAS sul singolo sportello)
  * 2. Prevenzione Deadlock in chiusura (risolto con IPC_NOWAIT).
- * 3. Attesa attiva su sportello occupato (Polling lento con usleep)
+ * 3. Attesa di uno sportello libero senza polling (futex dello slot e consegna diretta)
+ * * L'identità allo sportello è il TID (uguale al PID quando l'operatore è un processo),
+ * così il turno funziona anche come thread del Direttore (--engine=thread)
+ * * Niente SEM_MUTEX nel percorso caldo:
+ * - sportello: bitmask dei liberi per servizio, una fetch_and sul bit (perde solo chi arriva
+ *   secondo sullo stesso posto); chi si alza lo consegna a un collega in attesa, se c'è
+ * - statistiche: accumulate in un lotto locale e scaricate nello slot privato in SHM
+ *   (unico scrittore, seqlock per il Direttore) ogni STATS_BATCH clienti, prima della pausa,
+ *   a fine turno e, a ufficio chiuso, a ogni cliente: il Direttore legge a fine giornata
+ *   quando i lotti sono già tutti scaricati
+ * - in_attesa del servizio: decremento atomico
+ * * Multi-competenza: l'operatore sa erogare NOF_SKILLS servizi (la specializzazione
+ * principale più altri a caso). Si siede a uno sportello di una delle sue competenze e,
+ * se la coda dello sportello è vuota, può rubare un cliente da un'altra coda compatibile
+ * secondo la politica configurata (FURTO_*)
  */
 
-int main(void) {
-    // 1. Attach alle risorse IPC create dal Direttore
-    int shm_id = shmget(KEY_SHM, sizeof(SharedData), 0666);
-    SharedData *shm = (SharedData *)shmat(shm_id, NULL, 0);
-    int sem_id = semget(KEY_SEM, 0, 0666);
+// Servizi che l'operatore può servire dallo sportello "seat" (senza furto: solo quello dello sportello)
+static unsigned int servibili(SharedData *shm, unsigned int competenze, int seat) {
+    unsigned int proprio = 1u << shm_sportello(shm, seat)->servizio;
+    return shm->cfg.politica_furto == FURTO_NESSUNO ? proprio : (competenze | proprio);
+}
 
-    srand(getpid());
-    
-    int my_skill = rand() % NUM_SERVICES; // La specializzazione dell'operatore
+// C'è ancora qualcuno in coda tra i servizi che posso servire?
+static int lavoro_residuo(SharedData *shm, unsigned int servizi) {
+    for (int s = 0; s < shm->cfg.num_servizi; s++)
+        if (((servizi >> s) & 1) && __atomic_load_n(&shm_servizio(shm, s)->in_attesa, __ATOMIC_RELAXED) > 0) return 1;
+    return 0;
+}
+
+// Dopo la chiusura si prendono clienti dalla coda residua solo entro CLOSE_MINUTES
+static int entro_grazia(SharedData *shm) {
+    return adesso_ns() < shm->chiusura_ns + grazia_ns(&shm->cfg);
+}
+
+// Fine del turno di oggi: chi porta il contatore a 0 sveglia il Direttore in chiusura
+static void esci_dal_turno(SharedData *shm) {
+    if (__atomic_sub_fetch(&shm->operatori_in_turno, 1, __ATOMIC_RELEASE) == 0)
+        futex(&shm->operatori_in_turno, FUTEX_WAKE, INT_MAX);
+}
+
+// Lotto di statistiche non ancora pubblicate: vive nello stack dell'operatore,
+// quindi aggiornarlo non tocca linee di cache condivise
+typedef struct {
+    Stats stats;
+    long ns_servizio, ns_al_posto, rubati;
+    Deriva deriva;
+    int n;                      // Clienti nel lotto (campioni sotto)
+    struct {
+        int servizio;
+        long attesa, durata;
+    } campioni[LOTTO_MAX];
+} Lotto;
+
+// Scarica il lotto: una sola sezione seqlock per tutti i campi, poi gli istogrammi
+// (condivisi coi colleghi, incrementi atomici) uno dopo l'altro
+static void scarica(SharedData *shm, SlotOperatore *slot, Lotto *l) {
+    seqlock_scrivi_inizio(&slot->seq);
+    slot->stats.utenti_serviti += l->stats.utenti_serviti;
+    for (int s = 0; s < shm->cfg.num_servizi; s++) slot->stats.servizi_erogati[s] += l->stats.servizi_erogati[s];
+    slot->stats.tempo_servizio_totale += l->stats.tempo_servizio_totale;
+    slot->stats.tempo_attesa_totale += l->stats.tempo_attesa_totale;
+    slot->stats.pause_effettuate += l->stats.pause_effettuate;
+    slot->stats.operatori_attivi += l->stats.operatori_attivi;
+    slot->ns_servizio += l->ns_servizio;
+    slot->ns_al_posto += l->ns_al_posto;
+    slot->rubati += l->rubati;
+    slot->deriva.attese += l->deriva.attese;
+    slot->deriva.ns_richiesti += l->deriva.ns_richiesti;
+    slot->deriva.ns_ritardo += l->deriva.ns_ritardo;
+    if (l->deriva.ritardo_max > slot->deriva.ritardo_max) slot->deriva.ritardo_max = l->deriva.ritardo_max;
+    slot->scarichi++;
+    slot->in_lotto = 0; // Dentro la sezione: il Direttore non li conta mai due volte
+    for (int s = 0; s < shm->cfg.num_servizi; s++) slot->in_lotto_servizio[s] = 0;
+    seqlock_scrivi_fine(&slot->seq);
+
+    for (int i = 0; i < l->n; i++) {
+        ServizioCondiviso *sv = shm_servizio(shm, l->campioni[i].servizio);
+        isto_registra(&sv->attesa, l->campioni[i].attesa);
+        isto_registra(&sv->servizio, l->campioni[i].durata);
+    }
+    memset(l, 0, offsetof(Lotto, campioni)); // I campioni oltre n non contano
+}
+
+// Aggiunge al lotto il tempo passato seduto da "dal" a ora e lo scarica (pausa o fine turno)
+static void alzati(SharedData *shm, SlotOperatore *slot, Lotto *l, long dal) {
+    l->ns_al_posto += adesso_ns() - dal;
+    scarica(shm, slot, l);
+}
+
+// --- ATTESA E CONSEGNA DEGLI SPORTELLI ---
+// Chi non trova posto si iscrive sui servizi che sa erogare (bit nell'operatori_in_attesa
+// di ciascuno) e dorme sul futex "posto" del proprio slot. Chi si alza pubblica lo sportello
+// e, se qualcuno aspetta, se lo riprende e glielo consegna scrivendone l'indice nello slot
+// Protocollo tipo Dekker (tutto SEQ_CST): chi libera pubblica e poi guarda gli iscritti,
+// chi aspetta si iscrive e poi ricontrolla i liberi, quindi almeno uno dei due vede l'altro
+
+// Rilascia lo sportello (occupato già azzerato): al primo collega in attesa oppure ai liberi
+static void lascia_sportello(SharedData *shm, int seat) {
+    ServizioCondiviso *sv = shm_servizio(shm, shm_sportello(shm, seat)->servizio);
+    unsigned long bit = 1UL << seat;
+    sportello_pubblica(shm, seat, adesso_ns());
+    for (int w = 0; w < (shm->cfg.nof_workers + 63) / 64; w++) {
+        unsigned long iscritti = __atomic_load_n(&sv->operatori_in_attesa[w], __ATOMIC_SEQ_CST);
+        for (; iscritti; iscritti &= iscritti - 1) {
+            // Riprendo il posto per consegnarlo: se qualcuno l'ha già preso ho finito
+            if (!(__atomic_fetch_and(&sv->sportelli_liberi, ~bit, __ATOMIC_SEQ_CST) & bit)) return;
+            int *posto = &shm->slot_operatori[w * 64 + __builtin_ctzl(iscritti)].posto;
+            int atteso = POSTO_IN_ATTESA;
+            if (__atomic_compare_exchange_n(posto, &atteso, seat + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                __atomic_fetch_add(&shm->contesa.consegne_posto, 1, __ATOMIC_RELAXED);
+                futex((unsigned int *)posto, FUTEX_WAKE, 1);
+                return;
+            }
+            // Non aspettava più (iscrizione in via di ritiro): lo rimetto tra i liberi
+            __atomic_fetch_or(&sv->sportelli_liberi, bit, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+// Primo giro: sportelli della specializzazione principale; secondo: le altre competenze
+static int prendi_posto(SharedData *shm, int principale, unsigned int competenze, pid_t me) {
+    int seat = sportello_prendi(shm, 1u << principale, me, adesso_ns());
+    return seat != -1 ? seat : sportello_prendi(shm, competenze, me, adesso_ns());
+}
+
+// Cerca uno sportello finché l'ufficio è aperto: ritorna lo sportello occupato oppure -1
+static int cerca_sportello(SharedData *shm, int indice, int principale, unsigned int competenze, pid_t me) {
+    SlotOperatore *slot = &shm->slot_operatori[indice];
+    unsigned long mio_bit = 1UL << (indice % 64);
+    while (__atomic_load_n(&shm->ufficio_aperto, __ATOMIC_SEQ_CST) && !shm->stop_simulation) {
+        int seat = prendi_posto(shm, principale, competenze, me);
+        if (seat != -1) return seat;
+
+        // Iscrizione: prima lo stato del futex, poi i bit, poi ricontrollo i liberi
+        __atomic_store_n(&slot->posto, POSTO_IN_ATTESA, __ATOMIC_SEQ_CST);
+        for (unsigned int m = competenze; m; m &= m - 1)
+            __atomic_fetch_or(&shm_servizio(shm, __builtin_ctz(m))->operatori_in_attesa[indice / 64], mio_bit, __ATOMIC_SEQ_CST);
+        seat = prendi_posto(shm, principale, competenze, me);
+
+        // Dormo finché un collega non mi consegna il suo sportello o il Direttore cambia stato
+        // (sveglia_attese_posto); FUTEX_WAIT ritorna subito se "posto" è già cambiato
+        if (seat == -1 && __atomic_load_n(&shm->ufficio_aperto, __ATOMIC_SEQ_CST) && !shm->stop_simulation) {
+            __atomic_fetch_add(&shm->contesa.attese_posto, 1, __ATOMIC_RELAXED);
+            while (__atomic_load_n(&slot->posto, __ATOMIC_ACQUIRE) == POSTO_IN_ATTESA)
+                futex((unsigned int *)&slot->posto, FUTEX_WAIT, (unsigned int)POSTO_IN_ATTESA);
+        }
+
+        // Ritiro l'iscrizione. Se la CAS fallisce qualcuno ha già deciso per me:
+        // un collega mi ha consegnato uno sportello oppure il Direttore mi ha svegliato
+        int consegnato = POSTO_IN_ATTESA;
+        if (__atomic_compare_exchange_n(&slot->posto, &consegnato, POSTO_NESSUNO, 0, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE))
+            consegnato = POSTO_NESSUNO;
+        else
+            __atomic_store_n(&slot->posto, POSTO_NESSUNO, __ATOMIC_RELAXED);
+        for (unsigned int m = competenze; m; m &= m - 1)
+            __atomic_fetch_and(&shm_servizio(shm, __builtin_ctz(m))->operatori_in_attesa[indice / 64], ~mio_bit, __ATOMIC_SEQ_CST);
+
+        if (consegnato > 0) {
+            if (seat == -1) {
+                seat = consegnato - 1;
+                __atomic_store_n(&shm_sportello(shm, seat)->occupato, me, __ATOMIC_RELAXED);
+            } else {
+                lascia_sportello(shm, consegnato - 1); // Ne ho due: restituisco quello consegnato
+            }
+        }
+        if (seat != -1) return seat;
+    }
+    return -1;
+}
+
+// Turno di uno scenario: dall'identità (specializzazione, competenze) fino a stop_simulation
+static void turno(Agente *a) {
+    SharedData *shm = a->shm;
+    int sem_id = a->sem_id;
+    pid_t me = gettid();
+    SlotOperatore *slot = &shm->slot_operatori[a->indice];
+
+    // Flusso casuale dell'operatore: dipende solo da SEED e dal suo indice
+    rng_init(&a->rng, shm->cfg.seme, FLUSSO_OPERATORE(a->indice));
+    int my_skill = rng_intero(&a->rng, shm->cfg.num_servizi); // La specializzazione dell'operatore
+    unsigned int competenze = competenze_casuali(my_skill, shm->cfg.nof_skills, shm->cfg.num_servizi, &a->rng);
+    slot->competenze = competenze;  // Prima del via: nessun lettore concorrente
+    if (shm->giorno_ripresa)
+        rng_init(&a->rng, shm->cfg.seme, FLUSSO_RIPRESA(FLUSSO_OPERATORE(a->indice), shm->giorno_ripresa));
     int pause_rimanenti = shm->cfg.nof_pause;
+    int lotto_max = shm->cfg.lotto_statistiche;
+    Lotto lotto;
+    memset(&lotto, 0, offsetof(Lotto, campioni));
     
     // Sincronizzazione Start (Pattern Turnstile)
     P(sem_id, SEM_START); 
     V(sem_id, SEM_START);
 
     while (!shm->stop_simulation) {
+        // Entro nel turno PRIMA di guardare ufficio_aperto: se il Direttore ha già chiuso
+        // non troverò sportelli, altrimenti aspetterà la mia uscita
+        __atomic_add_fetch(&shm->operatori_in_turno, 1, __ATOMIC_SEQ_CST);
         
         // --- FASE 1: RICERCA DELLO SPORTELLO ---
-        int my_seat = -1;
-
-        // Loop di attesa: finché l'ufficio è aperto e non ho la sedia, continuo a cercare
-        // Questo soddisfa il requisito: resta in attesa che uno sportello si liberi
-        while (shm->ufficio_aperto && !shm->stop_simulation) {
-            
-            P(sem_id, SEM_MUTEX); // Lock per leggere array condiviso
-            for(int i=0; i<MAX_SPORTELLI; i++) {
-                if(shm->sportelli_mapping[i] == my_skill && shm->sportelli_occupati[i] == 0) {
-                    shm->sportelli_occupati[i] = getpid(); // Preso
-                    my_seat = i;
-                    shm->stats_giornaliere.operatori_attivi++;
-                    break;
-                }
-            }
-            V(sem_id, SEM_MUTEX);
-
-            if (my_seat != -1) {
-                break; // Ho trovato il posto, esco dal loop di ricerca
-            } else {
-                // Non ho trovato posto. Aspetto un po' (0.05s) e riprovo
-                // Spero che un collega vada in pausa liberando lo sportello
-                usleep(50000); 
-            }
+        // Resta in attesa (sul futex, non in polling) che uno sportello si liberi
+        int my_seat = cerca_sportello(shm, a->indice, my_skill, competenze, me);
+        long seduto_da = adesso_ns();
+        if (my_seat != -1) {
+            traccia_scrivi(a->traccia, TR_SEDUTO, a->indice, shm_sportello(shm, my_seat)->servizio, my_seat, -1, 0);
+            lotto.stats.operatori_attivi++;
         }
 
         // Se ho trovato la sedia (e l'ufficio non ha chiuso nel frattempo) inizio a lavorare
         if (my_seat != -1) {
+            int servizio_sportello = shm_sportello(shm, my_seat)->servizio;
+            unsigned int servizi = servibili(shm, competenze, my_seat);
             
             // --- FASE 2: LOOP DI LAVORO (Consumatore) ---
-            // Lavoro se l'ufficio è aperto OPPURE se c'è ancora coda da smaltire
-            while (shm->ufficio_aperto || shm->utenti_in_attesa[my_skill] > 0) {
+            // Lavoro se l'ufficio è aperto OPPURE se c'è ancora coda da smaltire entro il periodo
+            // di grazia (ma mai oltre la fine della simulazione: nel motore a thread nessuno mi uccide)
+            while ((shm->ufficio_aperto || (lavoro_residuo(shm, servizi) && entro_grazia(shm))) && !shm->stop_simulation) {
                 
-                // GESTIONE PAUSA (Opzionale)
-                if (pause_rimanenti > 0 && (rand() % 100) < 5) { 
-                    // Per andare in pausa DEVO liberare la risorsa (sedia).
-                    P(sem_id, SEM_MUTEX);
-                    shm->sportelli_occupati[my_seat] = 0; 
-                    shm->stats_giornaliere.pause_effettuate++;
-                    V(sem_id, SEM_MUTEX);
+                // GESTIONE PAUSA (Opzionale, mai a ufficio chiuso: il Direttore aspetta me)
+                if (pause_rimanenti > 0 && shm->ufficio_aperto && rng_intero(&a->rng, 100) < 5) { 
+                    // Per andare in pausa DEVO liberare la risorsa (sedia): a chi aspetta o ai liberi
+                    __atomic_store_n(&shm_sportello(shm, my_seat)->occupato, 0, __ATOMIC_RELEASE);
+                    lascia_sportello(shm, my_seat);
+                    traccia_scrivi(a->traccia, TR_PAUSA_INIZIO, a->indice, servizio_sportello, my_seat, -1, 0);
+                    lotto.stats.pause_effettuate++;
+                    alzati(shm, slot, &lotto, seduto_da);
                     
-                    usleep(shm->cfg.nano_secs_per_min * 10 / 1000); // Pausa caffè
+                    long pausa_ns = 10L * shm->cfg.nano_secs_per_min; // Pausa caffè
+                    deriva_registra(&lotto.deriva, pausa_ns, dormi_fino(adesso_ns() + pausa_ns));
                     pause_rimanenti--;
                     
                     // Al ritorno, devo ricompetere per la sedia
-                    P(sem_id, SEM_MUTEX);
-                    if(shm->sportelli_occupati[my_seat] == 0) {
-                         shm->sportelli_occupati[my_seat] = getpid(); // Ripresa
-                         V(sem_id, SEM_MUTEX);
-                    } else {
-                         V(sem_id, SEM_MUTEX);
-                         // Posto perso (rubato da un collega)! Esco e aspetto domani
-                         continue; 
+                    int ripreso = sportello_riprendi(shm, my_seat, me, adesso_ns());
+                    if (!ripreso) __atomic_fetch_add(&shm->contesa.cas_falliti, 1, __ATOMIC_RELAXED);
+                    traccia_scrivi(a->traccia, TR_PAUSA_FINE, a->indice, servizio_sportello, my_seat, -1, ripreso);
+                    if (!ripreso) {
+                         // Posto perso (consegnato o preso da un collega)! Torno a cercarne uno
+                         my_seat = -1;
+                         break; 
                     }
+                    seduto_da = adesso_ns();
                 }
 
                 // --- PRELIEVO CLIENTE (PUNTO CRITICO TECNICO) ---
                 // Uso IPC_NOWAIT per evitare Deadlock se la coda è vuota e l'ufficio chiude
-                struct sembuf s = {SEM_QUEUE_BASE + my_skill, -1, IPC_NOWAIT};
+                // Prima la coda del mio sportello; se è vuota provo a rubare da un'altra
+                int servizio = servizio_sportello;
+                int preso = sem_nowait(sem_id, SEM_QUEUE_BASE + servizio, -1) != -1;
+                if (!preso && errno == EAGAIN && shm->cfg.politica_furto != FURTO_NESSUNO) {
+                    // Lunghezze delle code candidate (ognuna sulla sua linea di cache)
+                    unsigned int candidati = servizi & ~(1u << servizio_sportello);
+                    int lunghezze[MAX_SERVIZI];
+                    for (int s = 0; s < shm->cfg.num_servizi; s++)
+                        lunghezze[s] = (candidati >> s) & 1
+                                     ? __atomic_load_n(&shm_servizio(shm, s)->in_attesa, __ATOMIC_RELAXED) : 0;
+                    int altra = scegli_coda(lunghezze, shm->cfg.num_servizi, candidati,
+                                            shm->cfg.politica_furto, &a->rng);
+                    if (altra != -1 && sem_nowait(sem_id, SEM_QUEUE_BASE + altra, -1) != -1) {
+                        servizio = altra;
+                        preso = 1;
+                    } else {
+                        errno = EAGAIN; // Anche il furto è andato a vuoto
+                    }
+                }
                 
-                if (semop(sem_id, &s, 1) != -1) {
+                if (preso) {
                     // SUCCESSO: Preso cliente
-                    struct timespec t_start, t_end;
-                    clock_gettime(CLOCK_MONOTONIC, &t_start);
+                    // Il semaforo garantisce che un ticket c'è: se la testa non è ancora
+                    // pubblicata, un utente è tra la prenotazione dello slot e la scrittura
+                    int numero_ticket;
+                    long t_ingresso;
+                    ServizioCondiviso *sv = shm_servizio(shm, servizio);
+                    while (!coda_pop(&sv->coda, &numero_ticket, &t_ingresso)) sched_yield();
+
+                    // Attesa VERA: dall'accodamento del ticket alla chiamata allo sportello
+                    long t_start = adesso_ns();
+                    long attesa = t_start - t_ingresso;
+                    traccia_scrivi(a->traccia, TR_PRELIEVO, a->indice, servizio, my_seat, numero_ticket, attesa);
 
                     // Simulo servizio
-                    int base = SERVICE_TIMES_MINUTES[my_skill];
-                    int duration_min = base + (rand() % base) - (base/2);
+                    int base = shm->cfg.servizi[servizio].minuti;
+                    int duration_min = base + rng_intero(&a->rng, base) - (base/2);
                     if(duration_min < 1) duration_min = 1;
                     long duration_ns = (long)duration_min * shm->cfg.nano_secs_per_min;
-                    usleep(duration_ns / 1000); 
+                    deriva_registra(&lotto.deriva, duration_ns, dormi_fino(t_start + duration_ns));
 
-                    clock_gettime(CLOCK_MONOTONIC, &t_end);
-                    long elapsed = (t_end.tv_sec - t_start.tv_sec)*1e9 + (t_end.tv_nsec - t_start.tv_nsec);
+                    long elapsed = adesso_ns() - t_start;
+                    traccia_scrivi(a->traccia, TR_FINE_SERVIZIO, a->indice, servizio, my_seat, numero_ticket, elapsed);
 
-                    // Aggiorno statistiche
-                    P(sem_id, SEM_MUTEX);
-                    shm->stats_giornaliere.utenti_serviti++;
-                    shm->stats_giornaliere.servizi_erogati[my_skill]++;
-                    shm->stats_giornaliere.tempo_servizio_totale += elapsed;
-                    
-                    long stima_attesa = elapsed * (10 + rand()%40) / 100; 
-                    shm->stats_giornaliere.tempo_attesa_totale += stima_attesa;
+                    // La coda "virtuale" scende subito: la leggono colleghi, Direttore ed explode
+                    __atomic_fetch_sub(&sv->in_attesa, 1, __ATOMIC_RELAXED); 
 
-                    shm->utenti_in_attesa[my_skill]--; 
-                    V(sem_id, SEM_MUTEX);
+                    // Statistiche nel lotto locale, scaricato quando è pieno o a ufficio chiuso
+                    // (nel periodo di grazia il Direttore sta per raccogliere la giornata)
+                    lotto.stats.utenti_serviti++;
+                    lotto.stats.servizi_erogati[servizio]++;
+                    lotto.stats.tempo_servizio_totale += elapsed;
+                    lotto.stats.tempo_attesa_totale += attesa;
+                    lotto.ns_servizio += elapsed;
+                    if (servizio != servizio_sportello) lotto.rubati++;
+                    lotto.campioni[lotto.n].servizio = servizio;
+                    lotto.campioni[lotto.n].attesa = attesa;
+                    lotto.campioni[lotto.n].durata = elapsed;
+                    // Il lotto in corso resta visibile a bin/monitor: due store nel mio slot,
+                    // così il throughput live non salta da un lotto all'altro
+                    __atomic_store_n(&slot->in_lotto, lotto.stats.utenti_serviti, __ATOMIC_RELAXED);
+                    __atomic_store_n(&slot->in_lotto_servizio[servizio], lotto.stats.servizi_erogati[servizio], __ATOMIC_RELAXED);
+                    if (++lotto.n >= lotto_max || !shm->ufficio_aperto) scarica(shm, slot, &lotto);
 
                 } else {
                      // FALLIMENTO: Coda vuota (EAGAIN)
                      if(errno == EAGAIN) {
-                         usleep(1000); // Breve sleep no-busy-waiting
+                         attendi_polling(POLLING_OPERATORE_US); // Breve sleep no-busy-waiting
                          if(!shm->ufficio_aperto) break; // Se chiuso, fine turno
                      }
                 }
             } // Fine While Lavoro
 
-            // A fine turno, libero ufficialmente la sedia
-            P(sem_id, SEM_MUTEX);
-            if(shm->sportelli_occupati[my_seat] == getpid()) shm->sportelli_occupati[my_seat] = 0;
-            V(sem_id, SEM_MUTEX);
+            // A fine turno, libero ufficialmente la sedia (solo se è ancora mia)
+            if (my_seat != -1) {
+                alzati(shm, slot, &lotto, seduto_da);
+                traccia_scrivi(a->traccia, TR_ALZATO, a->indice, servizio_sportello, my_seat, -1, 0);
+                // Se il Direttore ha già riassegnato gli sportelli non è più mio: non lo pubblico
+                pid_t mio = me;
+                if (__atomic_compare_exchange_n(&shm_sportello(shm, my_seat)->occupato, &mio, 0, 0,
+                                                __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                    lascia_sportello(shm, my_seat);
+            }
         }
+        esci_dal_turno(shm);
         
-        // Attendo l'apertura del giorno successivo
-        while(!shm->ufficio_aperto && !shm->stop_simulation) sleep(1);
+        // Attendo l'apertura del giorno successivo (dormo sul futex di stato)
+        attendi_stato(shm, 1);
     }
-    
-    shmdt(shm); 
+}
+
+void operatore_esegui(Agente *a) {
+    unsigned int scenario = a->shm->scenario;
+    timer_preciso();
+    profilo_usa(PR_OPERATORE, a->indice);
+    for (;;) {
+        // Con --scenarios gli operatori oltre NOF_WORKERS dello scenario restano fermi
+        if (a->indice < a->shm->cfg.nof_workers) turno(a);
+        else attendi_fine(a->shm);
+        if (!attendi_scenario(a->shm, &scenario)) return;
+        segnala_pronto(a->shm); // Pronto per lo scenario nuovo, come dopo l'attach
+    }
+}
+
+#ifndef SENZA_MAIN
+int main(int argc, char *argv[]) {
+    // L'indice dell'operatore (slot delle statistiche in SHM) arriva dal Direttore
+    if(argc < 2) return 1;
+
+    // 1. Attach alle risorse IPC create dal Direttore
+    Agente a;
+    a.indice = atoi(argv[1]);
+    int shm_id, msg_id;
+    if (ipc_ids(&shm_id, &a.sem_id, &msg_id) < 0) return 1;
+    a.shm = (SharedData *)shmat(shm_id, NULL, 0);
+    if (a.shm == (void *)-1) return 1; // Il Direttore se ne accorge (figlio morto prima del via)
+    ipc_contatore = &a.shm->contesa.operazioni_ipc;
+    a.msg_id = -1; // L'operatore non usa la coda dei ticket
+    a.traccia = traccia_ring_operatore(traccia_attach(&a.shm->cfg), a.indice);
+    profilo_attach(); // Solo in make profilo
+
+    // Sono collegato a tutto: lo comunico al Direttore (barriera di prontezza)
+    segnala_pronto(a.shm);
+
+    operatore_esegui(&a);
+
+    shmdt(a.shm); 
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include <pthread.h>
+#include "common.h"
+#include "agenti.h"
+#include "pool.h"
+
+/*
+ * POOL.C (Motore a Thread del Direttore)
+ * * Struttura dello scheduler degli Utenti (tutto protetto da un unico mutex):
+ * - pronti:        coda circolare dei task da eseguire subito
+ * - timer:         min-heap delle scadenze (attese "dormi fino alla scadenza")
+ * - parcheggiati:  task in attesa di un cambio di stato dell'ufficio
+ * Ogni task si trova in al più UNA di queste strutture, quindi tutte hanno capienza n_utenti
+ * * Prevenzione Lost Wakeup:
+ * Il controllo "la condizione è già vera?" e il parcheggio avvengono sotto il mutex,
+ * e pool_notifica prende lo stesso mutex DOPO che il Direttore ha cambiato lo stato
+ */
+
+typedef struct {
+    long long scadenza;     // CLOCK_MONOTONIC in ns
+    long long inizio;       // Quando l'attesa è stata chiesta (precisione delle attese)
+    int id;
+} Timer;
+
+struct Pool {
+    SharedData *shm;
+
+    Utente *utenti;
+    long *attesa;           // Ultimo esito di utente_passo (per i parcheggiati)
+    int n_utenti;
+    int attivi;             // Utenti non ancora terminati
+
+    int *pronti;
+    int testa, n_pronti;
+    Timer *timer;
+    int n_timer;
+    int *parcheggiati;
+    int n_parcheggiati;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    pthread_t *worker;
+    int n_worker;
+    pthread_t erogatore;
+    pthread_t *operatori;
+    Agente *ag_operatori;
+    int n_operatori;
+    int msg_id;
+};
+
+static void push_pronto(Pool *p, int id) {
+    p->pronti[(p->testa + p->n_pronti++) % p->n_utenti] = id;
+}
+
+static int pop_pronto(Pool *p) {
+    int id = p->pronti[p->testa];
+    p->testa = (p->testa + 1) % p->n_utenti;
+    p->n_pronti--;
+    return id;
+}
+
+static void push_timer(Pool *p, long long scadenza, int id) {
+    Timer t = {scadenza, adesso_ns(), id};
+    int i = p->n_timer++;
+    while (i > 0 && t.scadenza < p->timer[(i - 1) / 2].scadenza) {
+        p->timer[i] = p->timer[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    p->timer[i] = t;
+}
+
+static Timer pop_timer(Pool *p) {
+    Timer primo = p->timer[0];
+    Timer last = p->timer[--p->n_timer];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= p->n_timer) break;
+        if (c + 1 < p->n_timer && p->timer[c + 1].scadenza < p->timer[c].scadenza) c++;
+        if (last.scadenza <= p->timer[c].scadenza) break;
+        p->timer[i] = p->timer[c];
+        i = c;
+    }
+    if (p->n_timer > 0) p->timer[i] = last;
+    return primo;
+}
+
+// La condizione di stato attesa dall'utente è già soddisfatta?
+static int condizione_vera(Pool *p, long attesa) {
+    SharedData *shm = p->shm;
+    if (shm->stop_simulation) return 1;
+    return attesa == UT_ATTENDI_CHIUSURA ? !shm->ufficio_aperto : shm->ufficio_aperto;
+}
+
+// Inserisce il task nella struttura giusta in base all'esito del passo (mutex preso)
+static void programma(Pool *p, int id, long esito) {
+    if (esito == UT_FINE) {
+        if (--p->attivi == 0) pthread_cond_broadcast(&p->cond);
+        return;
+    }
+    if (esito >= 0) {
+        push_timer(p, esito, id);
+    } else if (condizione_vera(p, esito)) {
+        push_pronto(p, id);
+    } else {
+        p->attesa[id] = esito;
+        p->parcheggiati[p->n_parcheggiati++] = id;
+        return; // Nessun thread da svegliare
+    }
+    pthread_cond_signal(&p->cond);
+}
+
+static void *lavoratore(void *arg) {
+    Pool *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->attivi > 0) {
+        // Sposto nei pronti i task con scadenza superata, registrando il ritardo come bin/utente
+        long long ora = adesso_ns();
+        while (p->n_timer > 0 && p->timer[0].scadenza <= ora) {
+            Timer t = pop_timer(p);
+            deriva_registra_condivisa(&p->shm->deriva_utenti, t.scadenza - t.inizio, ora - t.scadenza);
+            push_pronto(p, t.id);
+        }
+
+        if (p->n_pronti > 0) {
+            int id = pop_pronto(p);
+            pthread_mutex_unlock(&p->lock);
+            profilo_usa(PR_UTENTE, id); // Le chiamate IPC del passo vanno all'utente
+            long esito = utente_passo(&p->utenti[id]);
+            pthread_mutex_lock(&p->lock);
+            programma(p, id, esito);
+            continue;
+        }
+
+        // Niente da fare: dormo fino alla prossima scadenza (o a un segnale)
+        if (p->n_timer > 0) {
+            struct timespec ts = {p->timer[0].scadenza / 1000000000LL, p->timer[0].scadenza % 1000000000LL};
+            pthread_cond_timedwait(&p->cond, &p->lock, &ts);
+        } else {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void *thread_erogatore(void *arg) {
+    Pool *p = arg;
+    erogatore_esegui(p->msg_id);
+    return NULL;
+}
+
+static void *thread_operatore(void *arg) {
+    operatore_esegui((Agente *)arg);
+    return NULL;
+}
+
+Pool *pool_avvia(SharedData *shm, int sem_id, int msg_id, int n_thread, Traccia *traccia) {
+    Pool *p = calloc(1, sizeof(Pool));
+    int utenti = utenti_agenti(&shm->cfg), n = utenti > 0 ? utenti : 1;
+    if (!p) { perror("calloc"); exit(1); }
+
+    p->shm = shm;
+    p->msg_id = msg_id;
+    p->n_utenti = n;
+    p->attivi = utenti;
+    p->utenti = calloc(n, sizeof(Utente));
+    p->attesa = calloc(n, sizeof(long));
+    p->pronti = calloc(n, sizeof(int));
+    p->timer = calloc(n, sizeof(Timer));
+    p->parcheggiati = calloc(n, sizeof(int));
+    if (!p->utenti || !p->attesa || !p->pronti || !p->timer || !p->parcheggiati) {
+        perror("calloc"); exit(1);
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->cond, &ca);
+    pthread_condattr_destroy(&ca);
+
+    // Gli utenti partono tutti pronti: il primo passo li blocca sulla barriera SEM_START
+    for (int i = 0; i < utenti; i++) {
+        Utente *u = &p->utenti[i];
+        u->ag.shm = shm;
+        u->ag.sem_id = sem_id;
+        u->ag.msg_id = msg_id;
+        utente_prepara(u, i);
+        u->ag.traccia = traccia_ring_utente(traccia, i);
+        push_pronto(p, i);
+    }
+
+    // Thread di sistema: stack ridotto, la logica degli attori non usa grandi buffer
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+
+    // L'Erogatore serve solo alla via di compatibilità su Message Queue
+    if (shm->cfg.modalita_ticket == TICKET_MSG) {
+        if (pthread_create(&p->erogatore, &attr, thread_erogatore, p) != 0) {
+            perror("pthread_create erogatore"); exit(1);
+        }
+        pthread_detach(p->erogatore); // Termina da solo su EIDRM quando la coda viene rimossa
+    }
+
+    p->n_operatori = shm->cfg.nof_workers;
+    p->operatori = calloc(p->n_operatori > 0 ? p->n_operatori : 1, sizeof(pthread_t));
+    p->ag_operatori = calloc(p->n_operatori > 0 ? p->n_operatori : 1, sizeof(Agente));
+    for (int i = 0; i < p->n_operatori; i++) {
+        Agente *a = &p->ag_operatori[i];
+        a->shm = shm;
+        a->sem_id = sem_id;
+        a->msg_id = -1;
+        a->indice = i;
+        a->traccia = traccia_ring_operatore(traccia, i);
+        if (pthread_create(&p->operatori[i], &attr, thread_operatore, a) != 0) {
+            perror("pthread_create operatore"); exit(1);
+        }
+    }
+
+    p->n_worker = n_thread > 0 ? n_thread : 1;
+    p->worker = calloc(p->n_worker, sizeof(pthread_t));
+    for (int i = 0; i < p->n_worker; i++) {
+        if (pthread_create(&p->worker[i], &attr, lavoratore, p) != 0) {
+            perror("pthread_create worker"); exit(1);
+        }
+    }
+    pthread_attr_destroy(&attr);
+    return p;
+}
+
+void pool_notifica(Pool *p) {
+    pthread_mutex_lock(&p->lock);
+    int rimasti = 0;
+    for (int i = 0; i < p->n_parcheggiati; i++) {
+        int id = p->parcheggiati[i];
+        if (condizione_vera(p, p->attesa[id])) push_pronto(p, id);
+        else p->parcheggiati[rimasti++] = id;
+    }
+    p->n_parcheggiati = rimasti;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_termina(Pool *p) {
+    for (int i = 0; i < p->n_worker; i++) pthread_join(p->worker[i], NULL);
+    for (int i = 0; i < p->n_operatori; i++) pthread_join(p->operatori[i], NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    free(p->worker); free(p->operatori); free(p->ag_operatori);
+    free(p->utenti); free(p->attesa); free(p->pronti); free(p->timer); free(p->parcheggiati);
+    free(p);
+}
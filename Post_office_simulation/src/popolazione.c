@@ -0,0 +1,351 @@
+#include <math.h>
+#include <pthread.h>
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * POPOLAZIONE.C (Arrivi generati dal Direttore: ARRIVALS=1,2,3 o --arrivals)
+ * * Con gli agenti ogni utente è un processo (o un task del pool) che ogni giorno decide
+ * con il suo P_SERV se uscire di casa: gli arrivi sono limitati dal numero di attori e la
+ * domanda non ha una forma nel tempo. Qui gli utenti sono record in memoria del Direttore
+ * e gli arrivi si generano a lotti con un modello:
+ * - pserv  (1): la regola degli agenti (P_SERV fisso per utente, arrivo entro 30 minuti)
+ * - poisson(2): sistema aperto, arrivi di Poisson con ARRIVAL_RATE al minuto
+ * - fasce  (3): Poisson non omogeneo, ARRIVAL_RATE x il peso della fascia (ARRIVAL_PROFILE)
+ * * Struttura di array (SoA): stato, P_SERV, servizio, ticket, istante d'arrivo e visite
+ * sono array separati, 19 byte per utente (un milione di utenti sta in meno di 20 MB),
+ * e le passate su tutta la popolazione leggono solo i campi che servono
+ * * Generazione a lotti: le estrazioni casuali si fanno a blocchi e le decisioni in cicli
+ * senza dipendenze tra iterazioni (vettorizzabili dal compilatore). Un lotto copre al più
+ * MINUTI_LOTTO minuti simulati: la memoria resta limitata anche con intensità molto alte
+ * * Gli arrivi entrano nelle stesse code che consumano gli operatori: nei motori ipc e thread
+ * li consegna un thread del Direttore (ticket dal contatore atomico, coda lock-free, una V
+ * per servizio per tutti gli arrivi scaduti insieme), nel motore des diventano eventi
+ */
+
+enum { POP_A_CASA, POP_IN_UFFICIO };
+
+#define BLOCCO 256              // Estrazioni generate insieme
+#define MINUTI_LOTTO 15         // Finestra di un lotto Poisson (minuti simulati)
+#define TENTATIVI_UTENTE 8      // Estrazioni di un utente a casa prima di rinunciare all'arrivo
+
+static const char *NOMI_ARRIVI[] = { "agenti", "pserv", "poisson", "fasce" };
+
+struct Popolazione {
+    Config cfg;
+    int n;
+    unsigned char *stato;       // POP_*
+    unsigned char *p_serv;      // P_SERV (modello pserv)
+    unsigned char *servizio;    // Ultimo servizio chiesto
+    int *ticket;                // Ultimo ticket (-1 se non l'ha preso)
+    long *t_arrivo;             // Ultimo arrivo (CLOCK_MONOTONIC, o ns equivalenti nel des)
+    unsigned int *visite;       // Arrivi in ufficio
+    Rng rng;                    // FLUSSO_POPOLAZIONE: tutte le estrazioni dei lotti
+
+    LottoArrivi ordina;         // Appoggio dell'ordinamento per minuto (modello pserv)
+    long esiti[NUM_ESITI_ARRIVO];
+    long senza_utenti;          // Arrivi Poisson senza nessun utente a casa
+    long lotti, generati, ns_generazione;
+
+    // Consegna nei motori reali (popolazione_avvia)
+    SharedData *shm;
+    int sem_id;
+    RingTraccia *ring;
+    LottoArrivi lotto;
+    pthread_t thread;
+    int fine;               // Richiesta di fine (popolazione_ferma): load/store atomici
+};
+
+static void *riserva(size_t n, size_t dim) {
+    void *p = calloc(n > 0 ? n : 1, dim);
+    if (!p) { perror("calloc popolazione"); exit(1); }
+    return p;
+}
+
+Popolazione *popolazione_crea(const Config *cfg) {
+    Popolazione *p = riserva(1, sizeof(Popolazione));
+    p->cfg = *cfg;
+    p->n = cfg->nof_users;
+    p->stato = riserva(p->n, 1);
+    p->p_serv = riserva(p->n, 1);
+    p->servizio = riserva(p->n, 1);
+    p->ticket = riserva(p->n, sizeof(int));
+    p->t_arrivo = riserva(p->n, sizeof(long));
+    p->visite = riserva(p->n, sizeof(unsigned int));
+    // P_SERV dal flusso dell'utente i, come l'agente i: stesso SEED = stessi utenti
+    for (int u = 0; u < p->n; u++) {
+        Rng r;
+        rng_init(&r, cfg->seme, FLUSSO_UTENTE(u));
+        p->p_serv[u] = (unsigned char)p_serv_casuale(cfg, &r);
+        p->ticket[u] = -1;
+    }
+    rng_init(&p->rng, cfg->seme, FLUSSO_POPOLAZIONE);
+    return p;
+}
+
+void lotto_libera(LottoArrivi *l) {
+    free(l->minuto); free(l->utente); free(l->servizio);
+    memset(l, 0, sizeof(*l));
+}
+
+void popolazione_libera(Popolazione *p) {
+    if (!p) return;
+    free(p->stato); free(p->p_serv); free(p->servizio);
+    free(p->ticket); free(p->t_arrivo); free(p->visite);
+    lotto_libera(&p->ordina);
+    lotto_libera(&p->lotto);
+    free(p);
+}
+
+static void lotto_riserva(LottoArrivi *l, int n) {
+    if (n <= l->cap) return;
+    int cap = l->cap ? l->cap : 1024;
+    while (cap < n) cap *= 2;
+    l->minuto = realloc(l->minuto, cap * sizeof(double));
+    l->utente = realloc(l->utente, cap * sizeof(int));
+    l->servizio = realloc(l->servizio, cap);
+    if (!l->minuto || !l->utente || !l->servizio) { perror("realloc lotto"); exit(1); }
+    l->cap = cap;
+}
+
+// Uniforme in [0, 1) con 53 bit
+static inline double uniforme(Rng *r) {
+    return (rng_next(r) >> 11) * 0x1p-53;
+}
+
+// Arrivi di Poisson di media l: moltiplicazione di uniformi (Knuth) per medie piccole,
+// approssimazione normale (Box-Muller) oltre, dove l'errore relativo è trascurabile
+static int poisson(Rng *r, double l) {
+    if (l <= 0) return 0;
+    if (l < 30) {
+        double soglia = exp(-l), prodotto = uniforme(r);
+        int k = 0;
+        while (prodotto > soglia) { k++; prodotto *= uniforme(r); }
+        return k;
+    }
+    double z = sqrt(-2 * log(1 - uniforme(r))) * cos(2 * M_PI * uniforme(r));
+    long k = lround(l + sqrt(l) * z);
+    return k < 0 ? 0 : k > INT_MAX / 2 ? INT_MAX / 2 : (int)k;
+}
+
+// Modello pserv: una passata su tutta la popolazione decide chi esce oggi e a che minuto
+// (un'estrazione a testa), poi l'ordinamento per minuto è un counting sort su 30 valori
+static void lotto_pserv(Popolazione *p, LottoArrivi *l) {
+    int minuti = MINUTI_ARRIVO < p->cfg.minuti_giornata ? MINUTI_ARRIVO : p->cfg.minuti_giornata;
+    int conteggio[MINUTI_ARRIVO + 1] = {0};
+    uint64_t r[BLOCCO];
+    LottoArrivi *o = &p->ordina;
+    o->n = 0;
+    for (int base = 0; base < p->n; base += BLOCCO) {
+        int m = p->n - base < BLOCCO ? p->n - base : BLOCCO;
+        for (int j = 0; j < m; j++) r[j] = rng_next(&p->rng);
+        lotto_riserva(o, o->n + m);
+        for (int j = 0; j < m; j++) {
+            int u = base + j;
+            int esce = (int)(((r[j] >> 32) * 100) >> 32) < p->p_serv[u] && p->stato[u] == POP_A_CASA;
+            int minuto = (int)(((r[j] & 0xffffffffULL) * MINUTI_ARRIVO) >> 32);
+            o->utente[o->n] = u;
+            o->minuto[o->n] = minuto;
+            o->n += esce;
+        }
+    }
+    // Chi esce dopo la chiusura (giornata più corta di 30 minuti) trova chiuso
+    for (int i = 0; i < o->n; i++) conteggio[(int)o->minuto[i] + 1]++;
+    for (int k = 0; k < MINUTI_ARRIVO; k++) conteggio[k + 1] += conteggio[k];
+    p->esiti[ARRIVO_UFFICIO_CHIUSO] += o->n - conteggio[minuti];
+    l->n = conteggio[minuti];
+    lotto_riserva(l, l->n);
+    for (int i = 0; i < o->n; i++) {
+        int minuto = (int)o->minuto[i];
+        if (minuto >= minuti) continue;
+        int k = conteggio[minuto]++;
+        l->minuto[k] = minuto;
+        l->utente[k] = o->utente[i];
+    }
+    for (int i = 0; i < l->n; i++) l->servizio[i] = (unsigned char)rng_intero(&p->rng, p->cfg.num_servizi);
+    p->generati += o->n;
+}
+
+// Utente a casa a cui assegnare un arrivo Poisson (-1 se non ne trovo)
+static int utente_a_casa(Popolazione *p) {
+    for (int t = 0; t < TENTATIVI_UTENTE && p->n > 0; t++) {
+        int u = rng_intero(&p->rng, p->n);
+        if (p->stato[u] == POP_A_CASA) return u;
+    }
+    return -1;
+}
+
+// Modelli poisson e fasce: minuto per minuto il numero di arrivi, poi gli istanti ordinati
+// dentro il minuto come somme cumulate di esponenziali normalizzate (statistiche d'ordine
+// di uniformi), senza sort. Gli utenti non vengono marcati qui: chi è estratto due volte
+// nello stesso lotto entra due volte, la probabilità è trascurabile con popolazioni grandi
+static double lotto_poisson(Popolazione *p, double da, LottoArrivi *l) {
+    double a = da + MINUTI_LOTTO < p->cfg.minuti_giornata ? da + MINUTI_LOTTO : p->cfg.minuti_giornata;
+    double e[BLOCCO + 1];
+    l->n = 0;
+    for (double m = da; m < a; m += 1) {
+        double durata = a - m < 1 ? a - m : 1;
+        int k = poisson(&p->rng, intensita_arrivi(&p->cfg, m) * durata);
+        p->generati += k;
+        // Blocchi di al più BLOCCO arrivi, ognuno distribuito uniformemente nel suo tratto del minuto
+        for (int fatti = 0; fatti < k; ) {
+            int b = k - fatti < BLOCCO ? k - fatti : BLOCCO;
+            double inizio = m + durata * fatti / k, ampiezza = durata * b / k;
+            for (int j = 0; j <= b; j++) e[j] = 1 - uniforme(&p->rng);
+            for (int j = 0; j <= b; j++) e[j] = -log(e[j]);
+            for (int j = 1; j <= b; j++) e[j] += e[j - 1];
+            lotto_riserva(l, l->n + b);
+            for (int j = 0; j < b; j++) {
+                int u = utente_a_casa(p);
+                if (u < 0) { p->senza_utenti++; continue; }
+                l->minuto[l->n] = inizio + ampiezza * e[j] / e[b];
+                l->utente[l->n] = u;
+                l->servizio[l->n++] = (unsigned char)rng_intero(&p->rng, p->cfg.num_servizi);
+            }
+            fatti += b;
+        }
+    }
+    return a;
+}
+
+double popolazione_lotto(Popolazione *p, double da, LottoArrivi *l) {
+    long t0 = adesso_ns();
+    double a = p->cfg.minuti_giornata;
+    if (p->cfg.arrivi == ARRIVI_PSERV) lotto_pserv(p, l);
+    else a = lotto_poisson(p, da, l);
+    p->lotti++;
+    p->ns_generazione += adesso_ns() - t0;
+    return a;
+}
+
+void popolazione_esito(Popolazione *p, int u, int esito, int servizio, int ticket, long t) {
+    p->esiti[esito]++;
+    if (esito == ARRIVO_UFFICIO_CHIUSO) return;
+    p->stato[u] = POP_IN_UFFICIO;
+    p->servizio[u] = (unsigned char)servizio;
+    p->ticket[u] = ticket;
+    p->t_arrivo[u] = t;
+    p->visite[u]++;
+}
+
+// A chiusura tutti tornano a casa, come gli agenti: chi è in coda conta tra i non erogati
+void popolazione_rientro(Popolazione *p) {
+    memset(p->stato, POP_A_CASA, p->n);
+}
+
+void popolazione_report(const Popolazione *p) {
+    long mai = 0, visite = 0;
+    unsigned int max = 0;
+    for (int u = 0; u < p->n; u++) {
+        visite += p->visite[u];
+        mai += !p->visite[u];
+        if (p->visite[u] > max) max = p->visite[u];
+    }
+    size_t byte = (size_t)p->n * (3 + sizeof(int) + sizeof(long) + sizeof(unsigned int));
+    printf("\n=== POPOLAZIONE (ARRIVALS=%d: %s) ===\n", p->cfg.arrivi, NOMI_ARRIVI[p->cfg.arrivi]);
+    printf("  Utenti: %d in array separati (%.1f MB), %ld lotti generati in %.3f ms (%.1f ns per arrivo)\n",
+           p->n, byte / 1048576.0, p->lotti, p->ns_generazione / 1e6,
+           p->generati ? (double)p->ns_generazione / p->generati : 0);
+    printf("  Arrivi: %ld generati, %ld in coda, %ld con il servizio chiuso, %ld con la coda piena, %ld a ufficio chiuso",
+           p->generati, p->esiti[ARRIVO_IN_CODA], p->esiti[ARRIVO_SERVIZIO_CHIUSO],
+           p->esiti[ARRIVO_CODA_PIENA], p->esiti[ARRIVO_UFFICIO_CHIUSO]);
+    if (p->senza_utenti) printf(", %ld senza utenti a casa", p->senza_utenti);
+    printf("\n  Visite per utente: media %.2f, massimo %u, mai entrati %ld (%.1f%%)\n",
+           p->n ? (double)visite / p->n : 0, max, mai, p->n ? 100.0 * mai / p->n : 0);
+}
+
+// --- CONSEGNA NEI MOTORI REALI (ipc e thread) ---
+
+// Attesa sul futex di stato che guarda anche la mia richiesta di fine (popolazione_ferma)
+static void attendi(Popolazione *p, int aperto) {
+    SharedData *shm = p->shm;
+    for (;;) {
+        unsigned int gen = __atomic_load_n(&shm->generazione_stato, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&p->fine, __ATOMIC_ACQUIRE) || shm->stop_simulation || shm->ufficio_aperto == aperto) return;
+        futex(&shm->generazione_stato, FUTEX_WAIT, gen);
+    }
+}
+
+int popolazione_accoda(Popolazione *p, SharedData *shm, RingTraccia *ring, int u, int servizio, long t) {
+    if (!servizio_attivo(shm, servizio)) {
+        popolazione_esito(p, u, ARRIVO_SERVIZIO_CHIUSO, servizio, -1, t);
+        return 0;
+    }
+    // Ticket della via lock-free, misurato come quello di prendi_ticket (utente.c):
+    // senza il costo nella media il report "ns/ticket" verrebbe diluito dai ticket del Direttore
+    long t0 = adesso_ns();
+    int ticket = __atomic_add_fetch(&shm->prossimo_ticket, 1, __ATOMIC_RELAXED);
+    long costo = adesso_ns() - t0;
+    __atomic_fetch_add(&shm->ticket_emessi[TICKET_SHM], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shm->ticket_ns[TICKET_SHM], costo, __ATOMIC_RELAXED);
+    ServizioCondiviso *sv = shm_servizio(shm, servizio);
+    __atomic_fetch_add(&sv->in_attesa, 1, __ATOMIC_RELAXED);
+    if (!coda_push(&sv->coda, ticket, t)) {
+        __atomic_fetch_sub(&sv->in_attesa, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shm->utenti_respinti, 1, __ATOMIC_RELAXED);
+        traccia_scrivi(ring, TR_RESPINTO, u, servizio, -1, ticket, 0);
+        popolazione_esito(p, u, ARRIVO_CODA_PIENA, servizio, ticket, t);
+        return 0;
+    }
+    traccia_scrivi(ring, TR_ACCODA, u, servizio, -1, ticket, 0);
+    popolazione_esito(p, u, ARRIVO_IN_CODA, servizio, ticket, t);
+    return 1;
+}
+
+// Una giornata: lotto dopo lotto, dormo fino al prossimo arrivo e consegno insieme tutti
+// quelli già scaduti, con l'istante d'arrivo previsto (l'attesa si misura da lì)
+static void consegna_giornata(Popolazione *p) {
+    SharedData *shm = p->shm;
+    LottoArrivi *l = &p->lotto;
+    long apertura = shm->apertura_ns, nsm = p->cfg.nano_secs_per_min;
+    for (double da = 0; da < p->cfg.minuti_giornata; ) {
+        double a = popolazione_lotto(p, da, l);
+        for (int i = 0; i < l->n; ) {
+            dormi_fino(apertura + (long)(l->minuto[i] * nsm));
+            if (__atomic_load_n(&p->fine, __ATOMIC_ACQUIRE) || !__atomic_load_n(&shm->ufficio_aperto, __ATOMIC_ACQUIRE)) {
+                p->esiti[ARRIVO_UFFICIO_CHIUSO] += l->n - i;
+                return;
+            }
+            int nuovi[MAX_SERVIZI] = {0};
+            long ora = adesso_ns();
+            for (; i < l->n; i++) {
+                long t = apertura + (long)(l->minuto[i] * nsm);
+                if (t > ora) break;
+                nuovi[l->servizio[i]] += popolazione_accoda(p, shm, p->ring, l->utente[i], l->servizio[i], t);
+            }
+            // Una V per servizio per tutto il gruppo (semop con incremento k)
+            for (int s = 0; s < p->cfg.num_servizi; s++)
+                if (nuovi[s]) sem_op(p->sem_id, SEM_QUEUE_BASE + s, nuovi[s]);
+        }
+        da = a;
+    }
+}
+
+static void *generatore(void *arg) {
+    Popolazione *p = arg;
+    for (;;) {
+        attendi(p, 1);
+        if (__atomic_load_n(&p->fine, __ATOMIC_ACQUIRE) || p->shm->stop_simulation) break;
+        consegna_giornata(p);
+        attendi(p, 0);
+        popolazione_rientro(p);
+        if (__atomic_load_n(&p->fine, __ATOMIC_ACQUIRE) || p->shm->stop_simulation) break;
+    }
+    return NULL;
+}
+
+void popolazione_avvia(Popolazione *p, SharedData *shm, int sem_id, RingTraccia *ring) {
+    p->shm = shm;
+    p->sem_id = sem_id;
+    p->ring = ring;
+    __atomic_store_n(&p->fine, 0, __ATOMIC_RELAXED); // Prima di pthread_create: lo vede di sicuro
+    if (pthread_create(&p->thread, NULL, generatore, p) != 0) {
+        perror("pthread_create popolazione"); exit(1);
+    }
+}
+
+void popolazione_ferma(Popolazione *p) {
+    __atomic_store_n(&p->fine, 1, __ATOMIC_RELEASE);
+    stato_pubblica(p->shm); // Sveglio il thread se dorme sul futex di stato
+    pthread_join(p->thread, NULL);
+}
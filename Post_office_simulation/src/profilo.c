@@ -0,0 +1,206 @@
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * PROFILO.C (Profilo di contesa dell'IPC: make profilo, cioè -DPROFILO_IPC)
+ * * Domanda a cui risponde: il tempo della simulazione se ne va nei semafori, nella coda
+ * di messaggi o nel polling? E dietro quale riga? I contatori aggregati della SHM
+ * (contesa.mutex_contese) dicono quante volte si è atteso, non quanto né dove
+ * * Ogni chiamata IPC passa da un wrapper di common.h che misura la durata della chiamata
+ * e la registra nel sito (file:riga) della sezione del suo attore:
+ * - segmento IPC_PRIVATE creato dal Direttore, id ai figli nell'ambiente (ENV_PROFILO)
+ * - una sezione per Direttore, Erogatore e ogni operatore; gli utenti (anche 10000 processi)
+ *   condividono SEZIONI_UTENTI sezioni, per questo i contatori sono atomici
+ * - istogrammi log2 (bucket = potenza di 2 di ns): p50 e p99 a meno di un fattore 2
+ * * A simulazione ferma il Direttore somma i siti di tutte le sezioni e stampa il report
+ * Nella build normale restano solo le funzioni del Direttore, vuote, e il puntatore al
+ * contatore delle operazioni IPC, che i wrapper usano in ogni build (vedi common.h)
+ */
+
+long *ipc_contatore = NULL;
+
+#ifdef PROFILO_IPC
+
+__thread SezioneProfilo *profilo_sezione = NULL;
+
+static Profilo *profilo = NULL;
+static int profilo_id = -1;
+
+static const char *NOMI_PR[NUM_PR] = { "P", "V", "P nowait", "mutex", "msgsnd", "msgrcv", "polling" };
+static const char *NOMI_PRR[NUM_PRR] = { "SEM_MUTEX", "SEM_START", "SEM code", "coda msg", "polling" };
+static const char *NOMI_RUOLI[NUM_RUOLI] = { "Direttore", "Erogatore", "Operatori", "Utenti" };
+
+static size_t profilo_dimensione(int n_sezioni) {
+    return sizeof(Profilo) + (size_t)n_sezioni * sizeof(SezioneProfilo);
+}
+
+void profilo_attach(void) {
+    const char *v = getenv(ENV_PROFILO);
+    if (!v) return;
+    Profilo *p = shmat(atoi(v), NULL, 0);
+    if (p != (void *)-1) profilo = p;
+}
+
+void profilo_usa(int ruolo, int indice) {
+    Profilo *p = profilo;
+    if (!p) return;
+    int k = ruolo == PR_DIRETTORE ? 0
+          : ruolo == PR_EROGATORE ? 1
+          : ruolo == PR_OPERATORE ? 2 + indice
+          : 2 + p->n_operatori + (int)((unsigned int)indice % SEZIONI_UTENTI);
+    profilo_sezione = k < p->n_sezioni ? &p->sezioni[k] : NULL;
+}
+
+void profilo_avvia(const Config *dim) {
+    int n = 2 + dim->nof_workers + SEZIONI_UTENTI;
+    profilo_id = shmget(IPC_PRIVATE, profilo_dimensione(n), IPC_CREAT | 0600);
+    if (profilo_id < 0) { perror("shmget profilo"); return; }
+    profilo = shmat(profilo_id, NULL, 0);
+    if (profilo == (void *)-1) {
+        perror("shmat profilo");
+        shmctl(profilo_id, IPC_RMID, NULL);
+        profilo = NULL; profilo_id = -1;
+        return;
+    }
+    memset(profilo, 0, profilo_dimensione(n));
+    profilo->n_sezioni = n;
+    profilo->n_operatori = dim->nof_workers;
+    for (int k = 0; k < n; k++)
+        profilo->sezioni[k].ruolo = k == 0 ? PR_DIRETTORE : k == 1 ? PR_EROGATORE
+                                  : k < 2 + dim->nof_workers ? PR_OPERATORE : PR_UTENTE;
+    profilo_usa(PR_DIRETTORE, 0);
+}
+
+const char *profilo_env(void) {
+    static char env[40];
+    if (profilo_id < 0) return NULL;
+    snprintf(env, sizeof(env), "%s=%d", ENV_PROFILO, profilo_id);
+    return env;
+}
+
+// Attesa sotto cui cade la frazione p delle chiamate (estremo superiore del bucket)
+static double percentile_us(const SitoProfilo *s, double p) {
+    long soglia = (long)(p * s->chiamate + 0.999999), visti = 0;
+    if (soglia < 1) soglia = 1;
+    for (int k = 0; k < PROFILO_BUCKET; k++) {
+        visti += s->isto[k];
+        if (visti >= soglia) {
+            double limite = (double)(2L << k);
+            return (limite < s->ns_max ? limite : s->ns_max) / 1e3;
+        }
+    }
+    return s->ns_max / 1e3;
+}
+
+static void unisci(SitoProfilo *dst, const SitoProfilo *src) {
+    dst->chiamate += src->chiamate;
+    dst->fallite += src->fallite;
+    dst->ns_totali += src->ns_totali;
+    if (src->ns_max > dst->ns_max) dst->ns_max = src->ns_max;
+    for (int k = 0; k < PROFILO_BUCKET; k++) dst->isto[k] += src->isto[k];
+}
+
+static int per_tempo(const void *a, const void *b) {
+    long ta = ((const SitoProfilo *)a)->ns_totali, tb = ((const SitoProfilo *)b)->ns_totali;
+    return (ta < tb) - (ta > tb);
+}
+
+void profilo_report(SharedData *shm) {
+    if (!profilo) return;
+
+    // Siti uniti per chiave (file, riga) su tutte le sezioni, più il totale per ruolo
+    SitoProfilo siti[PROFILO_SITI * 4];
+    int n_siti = 0;
+    long fuori = 0, chiamate = 0, ns_totali = 0;
+    long ns_ruolo[NUM_RUOLI] = {0}, ns_risorsa[NUM_PRR] = {0}, chiamate_risorsa[NUM_PRR] = {0};
+    long ns_operatori_ipc = 0, ns_operatori_polling = 0;
+    for (int z = 0; z < profilo->n_sezioni; z++) {
+        const SezioneProfilo *sez = &profilo->sezioni[z];
+        fuori += sez->fuori_tabella;
+        for (int k = 0; k < PROFILO_SITI; k++) {
+            const SitoProfilo *s = &sez->siti[k];
+            if (!s->chiave || !s->chiamate) continue;
+            chiamate += s->chiamate;
+            ns_totali += s->ns_totali;
+            ns_ruolo[sez->ruolo] += s->ns_totali;
+            ns_risorsa[s->risorsa] += s->ns_totali;
+            chiamate_risorsa[s->risorsa] += s->chiamate;
+            if (sez->ruolo == PR_OPERATORE) {
+                if (s->tipo == PR_POLLING) ns_operatori_polling += s->ns_totali;
+                else ns_operatori_ipc += s->ns_totali;
+            }
+            int i = 0;
+            while (i < n_siti && siti[i].chiave != s->chiave) i++;
+            if (i == n_siti) {
+                if (n_siti == (int)(sizeof(siti) / sizeof(siti[0]))) { fuori += s->chiamate; continue; }
+                siti[n_siti] = *s;
+                siti[n_siti].chiamate = siti[n_siti].fallite = siti[n_siti].ns_totali = siti[n_siti].ns_max = 0;
+                memset(siti[n_siti].isto, 0, sizeof(siti[n_siti].isto));
+                n_siti++;
+            }
+            unisci(&siti[i], s);
+        }
+    }
+
+    printf("\n=== PROFILO IPC (build -DPROFILO_IPC) ===\n");
+    if (!chiamate) { printf("  Nessuna chiamata IPC registrata\n"); return; }
+    printf("  %ld chiamate IPC, %.1f ms passati dentro le chiamate (somma su tutti gli attori)\n",
+           chiamate, ns_totali / 1e6);
+
+    printf("  -- Per risorsa --\n");
+    for (int r = 0; r < NUM_PRR; r++) {
+        if (!chiamate_risorsa[r]) continue;
+        printf("  %-10s chiamate %10ld  totale %10.1f ms (%5.1f%%)  medio %9.3f us\n",
+               NOMI_PRR[r], chiamate_risorsa[r], ns_risorsa[r] / 1e6, 100.0 * ns_risorsa[r] / ns_totali,
+               ns_risorsa[r] / 1e3 / chiamate_risorsa[r]);
+    }
+
+    printf("  -- Per sito di chiamata (ordinati per tempo totale) --\n");
+    printf("  %-20s %-9s %-10s %10s %8s %11s %10s %10s %10s %10s\n", "Sito", "Op", "Risorsa",
+           "chiamate", "fallite", "totale ms", "medio us", "p50 us", "p99 us", "max us");
+    qsort(siti, n_siti, sizeof(SitoProfilo), per_tempo);
+    for (int i = 0; i < n_siti; i++) {
+        const SitoProfilo *s = &siti[i];
+        char nome[32];
+        snprintf(nome, sizeof(nome), "%s:%d", s->file, s->riga);
+        printf("  %-20s %-9s %-10s %10ld %8ld %11.2f %10.3f %10.3f %10.3f %10.3f\n", nome, NOMI_PR[s->tipo],
+               NOMI_PRR[s->risorsa], s->chiamate, s->fallite, s->ns_totali / 1e6, s->ns_totali / 1e3 / s->chiamate,
+               percentile_us(s, 0.5), percentile_us(s, 0.99), s->ns_max / 1e3);
+    }
+    if (fuori) printf("  (%ld chiamate fuori tabella: più di %d siti per sezione)\n", fuori, PROFILO_SITI);
+
+    printf("  -- Per attore --\n");
+    for (int r = 0; r < NUM_RUOLI; r++)
+        if (ns_ruolo[r]) printf("  %-10s %10.1f ms (%5.1f%%)\n", NOMI_RUOLI[r], ns_ruolo[r] / 1e6, 100.0 * ns_ruolo[r] / ns_totali);
+
+    // Operatori: tempo perso nell'IPC contro il tempo passato a servire
+    long ns_servizio = 0;
+    for (int i = 0; i < shm->cfg.nof_workers; i++) ns_servizio += shm->slot_operatori[i].ns_servizio;
+    if (ns_servizio > 0)
+        printf("  Operatori: %.1f ms bloccati nell'IPC e %.1f ms in polling su %.1f ms di servizio (%.1f%% e %.1f%%)\n",
+               ns_operatori_ipc / 1e6, ns_operatori_polling / 1e6, ns_servizio / 1e6,
+               100.0 * ns_operatori_ipc / ns_servizio, 100.0 * ns_operatori_polling / ns_servizio);
+    char nome[32];
+    snprintf(nome, sizeof(nome), "%s:%d", siti[0].file, siti[0].riga);
+    printf("  Domina: %s (%s, %s), %.1f%% del tempo IPC\n", nome, NOMI_PR[siti[0].tipo],
+           NOMI_PRR[siti[0].risorsa], 100.0 * siti[0].ns_totali / ns_totali);
+    printf("=========================\n");
+}
+
+void profilo_termina(void) {
+    if (profilo) shmdt(profilo);
+    if (profilo_id != -1) shmctl(profilo_id, IPC_RMID, NULL);
+    profilo = NULL;
+    profilo_sezione = NULL;
+    profilo_id = -1;
+}
+
+#else
+
+// Build normale: il Direttore chiama comunque queste funzioni, che non fanno nulla
+void profilo_avvia(const Config *dim) { (void)dim; }
+const char *profilo_env(void) { return NULL; }
+void profilo_report(SharedData *shm) { (void)shm; }
+void profilo_termina(void) {}
+
+#endif
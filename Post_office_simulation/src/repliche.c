@@ -0,0 +1,196 @@
+#include <math.h>
+#include <fcntl.h>
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * REPLICHE.C (Modalità Monte Carlo: --replications=N --jobs=J)
+ * * Una simulazione è un solo campione casuale: per decidere quanti sportelli servono
+ * servono medie e intervalli di confidenza su molte esecuzioni indipendenti
+ * * Ogni replica è un fork del Direttore che esegue simula() per intero:
+ * - process group proprio (il kill(0) della sua cleanup non esce dalla replica)
+ * - risorse IPC_PRIVATE: namespace IPC proprio, passato ai figli con ENV_IPC
+ * - SEED = SEED base + indice della replica, report su /dev/null
+ * - a fine simulazione scrive un Risultato sulla sua pipe (pubblica_risultato)
+ * Il padre ne tiene in volo al massimo J, raccoglie gli esiti e stampa l'aggregato
+ */
+
+int fd_risultato = -1;
+
+typedef struct {
+    pid_t pid;
+    int fd;             // Lato lettura della pipe del Risultato
+    int indice;
+    long t0;
+} Corsa;
+
+// Metriche aggregate: una riga della tabella finale per ciascuna (più una per servizio)
+const char *metrica_nome(const Config *cfg, int k) {
+    static const char *nomi[] = {
+        "Utenti serviti/giorno", "Non erogati/giorno", "Attesa media (ms)",
+        "Attesa p90 (ms)", "Attesa p99 (ms)", "Servizio medio (ms)", "Pause/giorno",
+        "Sportelli aperti/giorno", "Serviti/sportello", "Sportelli liberi (%)"
+    };
+    static char buf[64];
+    if (k < NUM_METRICHE_FISSE) return nomi[k];
+    snprintf(buf, sizeof(buf), "  %s/giorno", cfg->servizi[k - NUM_METRICHE_FISSE].nome);
+    return buf;
+}
+
+double metrica_valore(const Risultato *r, int k) {
+    const Stats *s = &r->totali;
+    double giorni = r->giorni > 0 ? r->giorni : 1;
+    switch (k) {
+        case 0: return s->utenti_serviti / giorni;
+        case 1: return s->servizi_non_erogati / giorni;
+        case 2: return s->utenti_serviti ? s->tempo_attesa_totale / 1e6 / s->utenti_serviti : 0;
+        case 3: return r->attesa_p90 / 1e6;
+        case 4: return r->attesa_p99 / 1e6;
+        case 5: return s->utenti_serviti ? s->tempo_servizio_totale / 1e6 / s->utenti_serviti : 0;
+        case 6: return s->pause_effettuate / giorni;
+        case 7: return r->sportelli_giorni / giorni;
+        case 8: return r->sportelli_giorni ? (double)s->utenti_serviti / r->sportelli_giorni : 0;
+        case 9: return r->ns_sportelli_aperti ? 100.0 * r->ns_sportelli_liberi / r->ns_sportelli_aperti : 0;
+        default: return s->servizi_erogati[k - NUM_METRICHE_FISSE] / giorni;
+    }
+}
+
+// Quantile 0.975 della t di Student con gl gradi di libertà (IC bilaterale al 95%)
+static double t_student(int gl) {
+    static const double tabella[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (gl <= 30) return tabella[gl - 1];
+    if (gl <= 40) return 2.021;
+    if (gl <= 60) return 2.000;
+    if (gl <= 120) return 1.980;
+    return 1.960;
+}
+
+// CTRL+C: niente nuove simulazioni, e lo giro a quelle in volo (che stanno in un altro
+// process group, quindi dal terminale non lo ricevono) perché facciano la loro cleanup
+volatile sig_atomic_t interrotto = 0;
+static void interrompi(int sig) { (void)sig; interrotto = 1; }
+
+void intercetta_interruzione(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = interrompi; // Senza SA_RESTART: waitpid e futex ritornano con EINTR
+    sigaction(SIGINT, &sa, NULL);
+}
+
+pid_t simula_figlio(const Config *cfg, const Opzioni *o, const cpu_set_t *cpu, int *fd) {
+    int tubo[2];
+    if (pipe(tubo) < 0) { perror("pipe"); exit(1); }
+
+    fflush(stdout); // Prima della fork: il buffer non va duplicato nel figlio
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork simulazione"); exit(1); }
+    if (pid == 0) {
+        setpgid(0, 0);
+        close(tubo[0]);
+        fd_risultato = tubo[1];
+        if (cpu && sched_setaffinity(0, sizeof(*cpu), cpu) < 0) perror("sched_setaffinity");
+        int nulla = open("/dev/null", O_WRONLY);
+        if (nulla >= 0) { dup2(nulla, STDOUT_FILENO); close(nulla); }
+        Config c = *cfg;
+        Opzioni oo = *o;
+        exit(simula(&c, &oo, 1)); // Il motore ipc/thread esce dalla cleanup, il DES ritorna
+    }
+    close(tubo[1]);
+    *fd = tubo[0];
+    return pid;
+}
+
+static void avvia(Corsa *c, int indice, const Config *base, const Opzioni *o) {
+    Config cfg = *base;
+    cfg.seme += indice;
+    c->pid = simula_figlio(&cfg, o, NULL, &c->fd);
+    c->indice = indice;
+    c->t0 = adesso_ns();
+}
+
+int repliche_esegui(Config *cfg, const Opzioni *o, int n, int jobs) {
+    unsigned long seme = cfg->seme;
+    if (jobs > n) jobs = n;
+    printf("[Repliche] %d repliche del motore %s, %d in parallelo, SEED base %lu\n",
+           n, o->engine, jobs, seme);
+    intercetta_interruzione();
+
+    Risultato *esiti = calloc(n, sizeof(Risultato));
+    Corsa *in_volo = calloc(jobs, sizeof(Corsa));
+    if (!esiti || !in_volo) { perror("calloc"); exit(1); }
+
+    int avviate = 0, attive = 0, valide = 0;
+    long t_inizio = adesso_ns();
+    while (attive > 0 || (avviate < n && !interrotto)) {
+        while (attive < jobs && avviate < n && !interrotto) {
+            avvia(&in_volo[attive++], avviate, cfg, o);
+            avviate++;
+        }
+
+        int stato;
+        pid_t pid = waitpid(-1, &stato, 0);
+        if (pid < 0) {
+            if (errno != EINTR) break;
+            for (int i = 0; i < attive; i++) kill(in_volo[i].pid, SIGINT);
+            continue;
+        }
+        int i = 0;
+        while (i < attive && in_volo[i].pid != pid) i++;
+        if (i == attive) continue; // Non è una replica (nipote adottato): ignoro
+
+        Corsa c = in_volo[i];
+        in_volo[i] = in_volo[--attive];
+        Risultato r;
+        int ok = read(c.fd, &r, sizeof(r)) == (ssize_t)sizeof(r);
+        close(c.fd);
+        if (ok) {
+            esiti[valide++] = r;
+            printf("  Replica %3d/%d (SEED %lu): serviti %ld, non erogati %ld, attesa media %.3f ms, "
+                   "%d giorni, %.2f s\n", c.indice + 1, n, seme + c.indice, r.totali.utenti_serviti,
+                   r.totali.servizi_non_erogati, metrica_valore(&r, 2), r.giorni, (adesso_ns() - c.t0) / 1e9);
+        } else {
+            fprintf(stderr, "  Replica %3d/%d (SEED %lu): nessun risultato (stato %d), esclusa\n",
+                    c.indice + 1, n, seme + c.indice, WIFEXITED(stato) ? WEXITSTATUS(stato) : -1);
+        }
+        fflush(stdout);
+    }
+
+    printf("\n=== REPLICHE: %d valide su %d, %.2f s%s ===\n", valide, n, (adesso_ns() - t_inizio) / 1e9,
+           interrotto ? " (interrotte con CTRL+C)" : "");
+    if (valide > 0) {
+        printf("  %-24s %12s %12s %27s %12s %12s\n", "Metrica", "Media", "Dev.std", "IC 95%", "Min", "Max");
+        for (int k = 0; k < NUM_METRICHE_FISSE + cfg->num_servizi; k++) {
+            double somma = 0, min = metrica_valore(&esiti[0], k), max = min;
+            for (int i = 0; i < valide; i++) {
+                double v = metrica_valore(&esiti[i], k);
+                somma += v;
+                if (v < min) min = v;
+                if (v > max) max = v;
+            }
+            double media = somma / valide, scarti = 0;
+            for (int i = 0; i < valide; i++) {
+                double d = metrica_valore(&esiti[i], k) - media;
+                scarti += d * d;
+            }
+            // Varianza campionaria (n-1): con una sola replica l'intervallo non esiste
+            double dev = valide > 1 ? sqrt(scarti / (valide - 1)) : 0;
+            double semi = valide > 1 ? t_student(valide - 1) * dev / sqrt(valide) : 0;
+            char ic[40];
+            if (valide > 1) snprintf(ic, sizeof(ic), "[%.3f, %.3f]", media - semi, media + semi);
+            else snprintf(ic, sizeof(ic), "n/d");
+            printf("  %-24s %12.3f %12.3f %27s %12.3f %12.3f\n", metrica_nome(cfg, k), media, dev, ic, min, max);
+        }
+        int explode = 0;
+        for (int i = 0; i < valide; i++) explode += esiti[i].giorni < cfg->sim_duration;
+        if (explode) printf("  Repliche terminate per Explode: %d su %d\n", explode, valide);
+    }
+    printf("=========================\n");
+
+    free(esiti);
+    free(in_volo);
+    return valide == n ? 0 : 1;
+}
@@ -0,0 +1,413 @@
+#include <sys/mman.h>
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * RETE.C (Rete di uffici: --offices=K oppure --offices=p0,p1,..., --routing=POLITICA)
+ * * Un Direttore simula un ufficio, una SharedData, e lascia ferme quasi tutte le CPU di una
+ * macchina grande. Nella rete il Direttore avvia K uffici e diventa il coordinatore:
+ * - ogni ufficio è un fork che esegue simula() per intero, come una replica: process group
+ *   proprio, risorse IPC_PRIVATE, report su /dev/null, Risultato sulla sua pipe
+ * - ogni ufficio (con i suoi figli, che ereditano l'affinità) gira su un insieme di CPU proprio
+ * - gli uffici non hanno utenti attori: la popolazione (popolazione.c) vive nel coordinatore,
+ *   che instrada ogni arrivo a un ufficio e lo mette direttamente nella sua coda
+ * * Gli uffici sono in fila e ogni utente abita vicino a uno di loro (zona estratta con i pesi
+ * di --offices, uniforme se è un numero). Politiche di instradamento tra gli uffici aperti
+ * che hanno il servizio attivo:
+ * - nearest : il più vicino a casa
+ * - shortest: quello con meno persone in coda per il servizio
+ * - wait    : quello con l'attesa attesa minore (coda x durata del servizio / sportelli occupati)
+ * A parità vince il più vicino. Le code si leggono una volta per gruppo di arrivi consegnati
+ * insieme e si aggiornano in locale mentre li instrado
+ * * Le giornate sono allineate: ogni ufficio, prima di aprire, aspetta che il coordinatore
+ * conceda il giorno (barriera su un futex nel segmento di rete)
+ */
+
+static const char *NOMI_INSTRADA[] = { "nearest", "shortest", "wait" };
+
+// Stato di un ufficio visto dal coordinatore e dall'ufficio stesso
+typedef struct {
+    int shm_id, sem_id;         // Risorse IPC_PRIVATE dell'ufficio (scritte dall'ufficio)
+    int registrato;
+    int pronto;                 // Ultimo giorno per cui l'ufficio aspetta di aprire
+    int finito;                 // Ultima giornata chiusa (fine simulazione o Explode)
+} UfficioRete;
+
+// Memoria condivisa anonima creata prima delle fork: nessuna risorsa IPC da rimuovere
+typedef struct {
+    unsigned int segnali;       // Futex: gli uffici lo incrementano a ogni cambio di stato
+    unsigned int giorno;        // Futex: ultimo giorno concesso dal coordinatore
+    UfficioRete ufficio[MAX_UFFICI];
+} SegmentoRete;
+
+static SegmentoRete *rete = NULL;
+
+// --- LATO UFFICIO (chiamate da simula e esegui_giornate) ---
+
+static void segnala(void) {
+    __atomic_fetch_add(&rete->segnali, 1, __ATOMIC_RELEASE);
+    futex(&rete->segnali, FUTEX_WAKE, INT_MAX);
+}
+
+void rete_registra(int ufficio, int shm_id, int sem_id) {
+    UfficioRete *u = &rete->ufficio[ufficio];
+    u->shm_id = shm_id;
+    u->sem_id = sem_id;
+    __atomic_store_n(&u->registrato, 1, __ATOMIC_RELEASE);
+    segnala();
+}
+
+int rete_attendi_giorno(int ufficio, int giorno) {
+    __atomic_store_n(&rete->ufficio[ufficio].pronto, giorno, __ATOMIC_RELEASE);
+    segnala();
+    for (;;) {
+        unsigned int g = __atomic_load_n(&rete->giorno, __ATOMIC_ACQUIRE);
+        if ((int)g >= giorno) return 1;
+        if (g == UINT_MAX) return 0; // Il coordinatore ha chiuso la rete
+        futex(&rete->giorno, FUTEX_WAIT, g);
+    }
+}
+
+void rete_fine(int ufficio) {
+    __atomic_store_n(&rete->ufficio[ufficio].finito, 1, __ATOMIC_RELEASE);
+    segnala();
+}
+
+// --- LATO COORDINATORE ---
+
+typedef struct {
+    pid_t pid;
+    int fd;                     // Lato lettura della pipe del Risultato
+    int morto;                  // Già raccolto con waitpid
+    int cpu_da, cpu_a;          // CPU assegnate (indici nella lista delle disponibili)
+    SharedData *shm;
+    long instradati, lontani;   // Arrivi ricevuti, di cui da utenti di un'altra zona
+    Risultato esito;
+    int valido;
+} Ufficio;
+
+typedef struct {
+    const Config *cfg;
+    int k;
+    int instradamento;
+    double pesi[MAX_UFFICI];
+    Ufficio u[MAX_UFFICI];
+    int cpu[CPU_SETSIZE], n_cpu;
+    Popolazione *pop;
+    unsigned char *casa;        // Zona di ogni utente (ufficio più vicino)
+    LottoArrivi lotto;
+    long senza_uffici;          // Arrivi senza un ufficio aperto con il servizio attivo
+    // Gruppo in consegna: code e sportelli occupati letti all'inizio, V da fare alla fine
+    int coda[MAX_UFFICI][MAX_SERVIZI];
+    int serventi[MAX_UFFICI][MAX_SERVIZI];
+    int nuovi[MAX_UFFICI][MAX_SERVIZI];
+} Rete;
+
+// --offices=K oppure una lista di pesi: ritorna K (0 se la specifica non è valida)
+static int leggi_uffici(const char *spec, double *pesi) {
+    if (!strchr(spec, ',')) {
+        int k = atoi(spec);
+        if (k < 1 || k > MAX_UFFICI) return 0;
+        for (int i = 0; i < k; i++) pesi[i] = 1;
+        return k;
+    }
+    int k = 0;
+    for (const char *s = spec; *s && k < MAX_UFFICI; k++) {
+        char *fine;
+        pesi[k] = strtod(s, &fine);
+        if (fine == s || pesi[k] < 0) return 0;
+        s = *fine == ',' ? fine + 1 : fine;
+    }
+    return k;
+}
+
+static void assegna_cpu(Rete *r) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    r->n_cpu = 0;
+    for (int c = 0; c < CPU_SETSIZE; c++) if (CPU_ISSET(c, &set)) r->cpu[r->n_cpu++] = c;
+    // CPU divise in blocchi contigui; con più uffici che CPU gli uffici le condividono a turno
+    for (int i = 0; i < r->k; i++) {
+        if (r->n_cpu >= r->k) {
+            r->u[i].cpu_da = i * r->n_cpu / r->k;
+            r->u[i].cpu_a = (i + 1) * r->n_cpu / r->k;
+        } else {
+            r->u[i].cpu_da = i % r->n_cpu;
+            r->u[i].cpu_a = r->u[i].cpu_da + 1;
+        }
+    }
+}
+
+static void avvia_ufficio(Rete *r, int i, const Config *base, const Opzioni *o) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c = r->u[i].cpu_da; c < r->u[i].cpu_a; c++) CPU_SET(r->cpu[c], &set);
+    // Sportelli, operatori e competenze diversi da un ufficio all'altro
+    Config cfg = *base;
+    cfg.seme += i;
+    Opzioni oo = *o;
+    oo.ufficio = i;
+    r->u[i].pid = simula_figlio(&cfg, &oo, &set, &r->u[i].fd);
+}
+
+// Attesa di un segnale degli uffici, con un timeout breve per accorgermi di CTRL+C
+// e di un ufficio morto senza aver chiuso (lo considero finito)
+static void attendi_segnale(Rete *r, unsigned int visto) {
+    struct timespec timeout = {0, 100000000L};
+    futex_attendi(&rete->segnali, visto, &timeout);
+    for (int i = 0; i < r->k; i++) {
+        if (r->u[i].morto) continue;
+        int stato;
+        if (waitpid(r->u[i].pid, &stato, WNOHANG) == r->u[i].pid) {
+            r->u[i].morto = 1;
+            rete->ufficio[i].finito = 1;
+        }
+    }
+}
+
+static int tutti(Rete *r, int giorno) {
+    for (int i = 0; i < r->k; i++) {
+        UfficioRete *u = &rete->ufficio[i];
+        if (__atomic_load_n(&u->finito, __ATOMIC_ACQUIRE)) continue;
+        if (giorno == 0 ? !__atomic_load_n(&u->registrato, __ATOMIC_ACQUIRE)
+                        : __atomic_load_n(&u->pronto, __ATOMIC_ACQUIRE) < giorno) return 0;
+    }
+    return 1;
+}
+
+// L'ufficio apre subito dopo il via: dormo sul suo futex di stato (con timeout: può esplodere)
+static void attendi_apertura(Rete *r, int i) {
+    SharedData *shm = r->u[i].shm;
+    struct timespec timeout = {0, 100000000L};
+    while (!interrotto && shm && !rete->ufficio[i].finito) {
+        unsigned int gen = __atomic_load_n(&shm->generazione_stato, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->ufficio_aperto, __ATOMIC_ACQUIRE)) return;
+        futex_attendi(&shm->generazione_stato, gen, &timeout);
+    }
+}
+
+static int aperto(Rete *r, int i) {
+    return !rete->ufficio[i].finito && r->u[i].shm && r->u[i].shm->ufficio_aperto;
+}
+
+// Ufficio per un arrivo del servizio s da chi abita vicino all'ufficio casa (-1: nessuno)
+static int scegli_ufficio(Rete *r, int casa, int s) {
+    int scelto = -1;
+    double migliore = 0;
+    for (int i = 0; i < r->k; i++) {
+        if (!aperto(r, i) || !servizio_attivo(r->u[i].shm, s)) continue;
+        int distanza = i > casa ? i - casa : casa - i;
+        double costo = distanza;
+        if (r->instradamento == INSTRADA_CODA) costo = r->coda[i][s] + distanza * 1e-3;
+        // Servizio attivo ma nessuno seduto ai suoi sportelli: conto mezzo servente
+        else if (r->instradamento == INSTRADA_ATTESA)
+            costo = (r->coda[i][s] + 1.0) * r->cfg->servizi[s].minuti
+                  / (r->serventi[i][s] > 0 ? r->serventi[i][s] : 0.5) + distanza * 1e-3;
+        if (scelto < 0 || costo < migliore) { scelto = i; migliore = costo; }
+    }
+    return scelto;
+}
+
+// Code e sportelli occupati di ogni ufficio aperto, letti senza lock (è una stima)
+static void fotografa(Rete *r) {
+    for (int i = 0; i < r->k; i++) {
+        if (!aperto(r, i)) continue;
+        SharedData *shm = r->u[i].shm;
+        for (int s = 0; s < r->cfg->num_servizi; s++) {
+            r->coda[i][s] = __atomic_load_n(&shm_servizio(shm, s)->in_attesa, __ATOMIC_RELAXED);
+            r->serventi[i][s] = 0;
+        }
+        for (int j = 0; j < r->cfg->num_sportelli; j++) {
+            Sportello *sp = shm_sportello(shm, j);
+            if (sp->servizio >= 0 && __atomic_load_n(&sp->occupato, __ATOMIC_RELAXED)) r->serventi[i][sp->servizio]++;
+        }
+    }
+}
+
+static void instrada(Rete *r, int u, int s, long t) {
+    int i = scegli_ufficio(r, r->casa[u], s);
+    if (i < 0) {
+        // Nessuno lo può servire: conta come un arrivo a casa sua andato a vuoto
+        int esito = aperto(r, r->casa[u]) ? ARRIVO_SERVIZIO_CHIUSO : ARRIVO_UFFICIO_CHIUSO;
+        popolazione_esito(r->pop, u, esito, s, -1, t);
+        r->senza_uffici++;
+        return;
+    }
+    r->u[i].instradati++;
+    r->u[i].lontani += i != r->casa[u];
+    r->coda[i][s]++;
+    r->nuovi[i][s] += popolazione_accoda(r->pop, r->u[i].shm, NULL, u, s, t);
+}
+
+// Una giornata della rete: come consegna_giornata di popolazione.c, ma ogni arrivo va
+// all'ufficio scelto dalla politica. L'orologio è l'apertura più tarda tra gli uffici
+static void consegna_giornata(Rete *r) {
+    long apertura = 0, nsm = r->cfg->nano_secs_per_min;
+    for (int i = 0; i < r->k; i++)
+        if (aperto(r, i) && r->u[i].shm->apertura_ns > apertura) apertura = r->u[i].shm->apertura_ns;
+    LottoArrivi *l = &r->lotto;
+    for (double da = 0; da < r->cfg->minuti_giornata && !interrotto; ) {
+        double a = popolazione_lotto(r->pop, da, l);
+        for (int n = 0; n < l->n && !interrotto; ) {
+            dormi_fino(apertura + (long)(l->minuto[n] * nsm));
+            long ora = adesso_ns();
+            fotografa(r);
+            memset(r->nuovi, 0, sizeof(r->nuovi));
+            for (; n < l->n; n++) {
+                long t = apertura + (long)(l->minuto[n] * nsm);
+                if (t > ora) break;
+                instrada(r, l->utente[n], l->servizio[n], t);
+            }
+            for (int i = 0; i < r->k; i++)
+                for (int s = 0; s < r->cfg->num_servizi; s++)
+                    if (r->nuovi[i][s]) sem_op(rete->ufficio[i].sem_id, SEM_QUEUE_BASE + s, r->nuovi[i][s]);
+        }
+        da = a;
+    }
+}
+
+static void report(Rete *r, double secondi) {
+    printf("\n=== RETE: %d uffici, instradamento %s, %d CPU, %.2f s ===\n",
+           r->k, NOMI_INSTRADA[r->instradamento], r->n_cpu, secondi);
+    printf("  %-8s %-9s %6s %11s %8s %10s %12s %12s %12s %10s\n", "Ufficio", "CPU", "Zona%", "Instradati",
+           "Lontani", "Giorni", "Serviti/g", "Non erog./g", "Attesa ms", "p99 ms");
+    double peso_totale = 0;
+    for (int i = 0; i < r->k; i++) peso_totale += r->pesi[i];
+    Stats rete_tot;
+    memset(&rete_tot, 0, sizeof(rete_tot));
+    long instradati = 0, lontani = 0, p99 = 0;
+    int giorni = 0;
+    for (int i = 0; i < r->k; i++) {
+        Ufficio *u = &r->u[i];
+        char cpu[24];
+        if (u->cpu_a - u->cpu_da > 1) snprintf(cpu, sizeof(cpu), "%d-%d", r->cpu[u->cpu_da], r->cpu[u->cpu_a - 1]);
+        else snprintf(cpu, sizeof(cpu), "%d", r->cpu[u->cpu_da]);
+        instradati += u->instradati;
+        lontani += u->lontani;
+        if (!u->valido) {
+            printf("  [%3d]    %-9s %6.1f %11ld %8ld  nessun risultato\n", i, cpu,
+                   100 * r->pesi[i] / peso_totale, u->instradati, u->lontani);
+            continue;
+        }
+        const Risultato *e = &u->esito;
+        printf("  [%3d]    %-9s %6.1f %11ld %8ld %10d %12.1f %12.1f %12.3f %10.3f\n", i, cpu,
+               100 * r->pesi[i] / peso_totale, u->instradati, u->lontani, e->giorni,
+               metrica_valore(e, 0), metrica_valore(e, 1), metrica_valore(e, 2), metrica_valore(e, 4));
+        rete_tot.utenti_serviti += e->totali.utenti_serviti;
+        rete_tot.servizi_non_erogati += e->totali.servizi_non_erogati;
+        rete_tot.tempo_attesa_totale += e->totali.tempo_attesa_totale;
+        if (e->attesa_p99 > p99) p99 = e->attesa_p99;
+        if (e->giorni > giorni) giorni = e->giorni;
+    }
+    double g = giorni > 0 ? giorni : 1;
+    printf("  %-8s %-9s %6s %11ld %8ld %10d %12.1f %12.1f %12.3f %10.3f\n", "Rete", "", "100.0", instradati, lontani,
+           giorni, rete_tot.utenti_serviti / g, rete_tot.servizi_non_erogati / g,
+           rete_tot.utenti_serviti ? rete_tot.tempo_attesa_totale / 1e6 / rete_tot.utenti_serviti : 0, p99 / 1e6);
+    printf("  Non erogati nella rete: %ld in coda a fine giornata, %ld arrivi senza un ufficio aperto con il servizio\n",
+           rete_tot.servizi_non_erogati, r->senza_uffici);
+    printf("  Arrivi fuori zona: %.1f%% (p99 della rete: il peggiore tra gli uffici)\n",
+           instradati ? 100.0 * lontani / instradati : 0);
+    printf("=========================\n");
+}
+
+int rete_esegui(Config *cfg, const Opzioni *o) {
+    Rete *r = calloc(1, sizeof(Rete));
+    if (!r) { perror("calloc"); exit(1); }
+    r->cfg = cfg;
+    r->instradamento = o->instradamento;
+    r->k = leggi_uffici(o->rete, r->pesi);
+    if (r->k < 1) {
+        fprintf(stderr, "--offices=%s non valido: un numero tra 1 e %d o una lista di pesi\n", o->rete, MAX_UFFICI);
+        exit(1);
+    }
+    // Gli utenti sono del coordinatore: nessun utente attore negli uffici
+    if (cfg->arrivi == ARRIVI_AGENTI) {
+        printf("[Rete] ARRIVALS=0: gli utenti arrivano dalla popolazione con la regola P_SERV (ARRIVALS=1)\n");
+        cfg->arrivi = ARRIVI_PSERV;
+    }
+    assegna_cpu(r);
+    printf("[Rete] %d uffici su %d CPU, instradamento %s, %d utenti, SEED base %lu\n",
+           r->k, r->n_cpu, NOMI_INSTRADA[r->instradamento], cfg->nof_users, cfg->seme);
+
+    rete = mmap(NULL, sizeof(SegmentoRete), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (rete == MAP_FAILED) { perror("mmap rete"); exit(1); }
+    memset(rete, 0, sizeof(SegmentoRete));
+
+    intercetta_interruzione();
+
+    long t_inizio = adesso_ns();
+    for (int i = 0; i < r->k; i++) avvia_ufficio(r, i, cfg, o);
+
+    // Popolazione della rete: la zona di ogni utente estratta con i pesi degli uffici
+    r->pop = popolazione_crea(cfg);
+    r->casa = malloc(cfg->nof_users > 0 ? cfg->nof_users : 1);
+    if (!r->casa) { perror("malloc"); exit(1); }
+    double peso_totale = 0;
+    for (int i = 0; i < r->k; i++) peso_totale += r->pesi[i];
+    Rng rng;
+    rng_init(&rng, cfg->seme, FLUSSO_RETE);
+    for (int u = 0; u < cfg->nof_users; u++) {
+        double x = (rng_next(&rng) >> 11) * 0x1p-53 * peso_totale;
+        int i = 0;
+        while (i < r->k - 1 && x >= r->pesi[i]) x -= r->pesi[i++];
+        r->casa[u] = (unsigned char)i;
+    }
+
+    // Attach ai segmenti degli uffici appena registrati: restano validi anche dopo la loro cleanup
+    for (;;) {
+        unsigned int visto = __atomic_load_n(&rete->segnali, __ATOMIC_ACQUIRE);
+        if (tutti(r, 0) || interrotto) break;
+        attendi_segnale(r, visto);
+    }
+    for (int i = 0; i < r->k && !interrotto; i++) {
+        if (rete->ufficio[i].finito) continue;
+        SharedData *shm = shmat(rete->ufficio[i].shm_id, NULL, 0);
+        if (shm == (void *)-1) { perror("shmat ufficio"); rete->ufficio[i].finito = 1; continue; }
+        r->u[i].shm = shm;
+    }
+
+    // Giornate allineate: concedo il giorno quando tutti gli uffici vivi lo aspettano,
+    // consegno gli arrivi finché la giornata dura, poi tutti a casa
+    for (int giorno = 1; !interrotto; giorno++) {
+        for (;;) {
+            unsigned int visto = __atomic_load_n(&rete->segnali, __ATOMIC_ACQUIRE);
+            if (tutti(r, giorno) || interrotto) break;
+            attendi_segnale(r, visto);
+        }
+        int vivi = 0;
+        for (int i = 0; i < r->k; i++) vivi += !rete->ufficio[i].finito;
+        if (!vivi || interrotto) break;
+        __atomic_store_n(&rete->giorno, giorno, __ATOMIC_RELEASE);
+        futex(&rete->giorno, FUTEX_WAKE, INT_MAX);
+        for (int i = 0; i < r->k; i++) attendi_apertura(r, i);
+        consegna_giornata(r);
+        popolazione_rientro(r->pop);
+    }
+
+    // Gli uffici finiscono da soli; con CTRL+C li fermo io (sono in un altro process group)
+    __atomic_store_n(&rete->giorno, UINT_MAX, __ATOMIC_RELEASE);
+    futex(&rete->giorno, FUTEX_WAKE, INT_MAX);
+    for (int i = 0; i < r->k; i++) {
+        Ufficio *u = &r->u[i];
+        if (interrotto && !u->morto) kill(u->pid, SIGINT);
+        if (!u->morto) waitpid(u->pid, NULL, 0);
+        u->valido = read(u->fd, &u->esito, sizeof(Risultato)) == (ssize_t)sizeof(Risultato);
+        close(u->fd);
+        if (u->shm) shmdt(u->shm);
+    }
+
+    report(r, (adesso_ns() - t_inizio) / 1e9);
+    popolazione_report(r->pop);
+    int validi = 0;
+    for (int i = 0; i < r->k; i++) validi += r->u[i].valido;
+    int k = r->k;
+
+    popolazione_libera(r->pop);
+    lotto_libera(&r->lotto);
+    free(r->casa);
+    munmap(rete, sizeof(SegmentoRete));
+    rete = NULL;
+    free(r);
+    return validi == k ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * SCENARI.C (Più configurazioni in serie: --scenarios=FILE)
+ * * Confrontare N configurazioni lanciando N volte bin/direttore costa N volte l'avvio:
+ * creazione di SHM, semafori e coda messaggi, spawn e attach di tutti gli attori.
+ * Con scenari brevi l'avvio pesa più delle giornate simulate
+ * * Qui un solo Direttore esegue gli scenari uno dopo l'altro:
+ * - risorse IPC dimensionate sullo scenario più grande, create una volta sola
+ * - attori avviati una volta sola (i massimi di NOF_WORKERS e NOF_USERS): chi ha un indice
+ *   oltre quelli dello scenario in corso resta fermo fino al prossimo
+ * - tra uno scenario e l'altro il Direttore ferma gli attori, riazzera segmento e semafori,
+ *   pubblica la nuova Config e li fa ripartire (cambia_scenario in main.c)
+ * Alla fine stampa una tabella di confronto con le stesse metriche delle repliche
+ * * Formato del file: le righe "CHIAVE=valore" del .conf prima della prima sezione valgono
+ * per tutti, poi ogni sezione "[nome]" è uno scenario e le sue righe le sovrascrivono
+ * (le righe SERVICE= di una sezione sostituiscono quelle comuni)
+ * Il motore des non ha risorse da riusare: esegue gli scenari in serie nello stesso processo
+ */
+
+int scenari_carica(const char *file, Scenario **scenari) {
+    FILE *f = fopen(file, "r");
+    if (!f) { perror("Errore apertura scenari"); exit(1); }
+
+    // Le righe comuni si riapplicano a ogni scenario, sopra i valori di default
+    char riga[512];
+    char (*comuni)[512] = NULL;
+    int n_comuni = 0, n = 0, servizi_letti = 0;
+    Scenario *s = NULL;
+    while (fgets(riga, sizeof(riga), f)) {
+        char nome[LUNGHEZZA_NOME];
+        if (sscanf(riga, " [%23[^]]]", nome) == 1) {
+            if (!(s = realloc(s, (n + 1) * sizeof(Scenario)))) { perror("realloc"); exit(1); }
+            Scenario *nuovo = &s[n++];
+            memset(nuovo, 0, sizeof(Scenario));
+            snprintf(nuovo->nome, sizeof(nuovo->nome), "%s", nome);
+            config_default(&nuovo->cfg);
+            int comuni_letti = 0;
+            for (int i = 0; i < n_comuni; i++) config_riga(&nuovo->cfg, comuni[i], &comuni_letti);
+            servizi_letti = 0; // Il primo SERVICE della sezione sostituisce quelli comuni
+        } else if (!n) {
+            if (!(comuni = realloc(comuni, (n_comuni + 1) * sizeof(*comuni)))) { perror("realloc"); exit(1); }
+            memcpy(comuni[n_comuni++], riga, sizeof(riga));
+        } else {
+            config_riga(&s[n - 1].cfg, riga, &servizi_letti);
+        }
+    }
+    fclose(f);
+    free(comuni);
+
+    if (!n) { fprintf(stderr, "%s: nessuno scenario (sezioni [nome])\n", file); exit(1); }
+    for (int i = 0; i < n; i++) config_valida(&s[i].cfg);
+    *scenari = s;
+    return n;
+}
+
+int scenari_esegui(const Opzioni *o) {
+    printf("[Scenari] %d scenari in serie, motore %s\n", o->n_scenari, o->engine);
+    if (strcmp(o->engine, "des")) return simula(&o->scenari[0].cfg, o, 0);
+
+    for (int k = 0; k < o->n_scenari; k++) {
+        Scenario *s = &o->scenari[k];
+        Opzioni una = *o; // L'esito del DES finisce in una.scenari[0]
+        una.scenari = s;
+        una.n_scenari = 1;
+        printf("\n========== SCENARIO %d/%d: %s ==========\n", k + 1, o->n_scenari, s->nome);
+        long t0 = adesso_ns();
+        if (des_esegui(&s->cfg, &una)) return 1;
+        s->secondi = (adesso_ns() - t0) / 1e9;
+    }
+    scenari_confronto(o);
+    return 0;
+}
+
+void scenari_confronto(const Opzioni *o) {
+    const Scenario *s = o->scenari;
+    int n = o->n_scenari;
+    double ms_cambi = 0;
+    for (int k = 1; k < n; k++) ms_cambi += s[k].ms_preparazione;
+
+    printf("\n=== SCENARI: %d, motore %s ===\n", n, o->engine);
+    if (strcmp(o->engine, "des"))
+        printf("  Avvio di risorse e attori: %.2f ms una volta sola, cambio di scenario: %.2f ms in media\n",
+               s[0].ms_preparazione, n > 1 ? ms_cambi / (n - 1) : 0);
+    printf("  %-24s", "Metrica");
+    for (int k = 0; k < n; k++) printf(" %14.14s", s[k].nome);
+    printf("\n  %-24s", "Giorni simulati");
+    int explode = 0;
+    for (int k = 0; k < n; k++) {
+        int esploso = s[k].esito.giorni < s[k].cfg.sim_duration;
+        explode += esploso;
+        printf(" %13d%c", s[k].esito.giorni, esploso ? '*' : ' ');
+    }
+    printf("\n");
+    // Le metriche per servizio dipendono dai servizi di ogni scenario: confronto solo le fisse
+    for (int m = 0; m < NUM_METRICHE_FISSE; m++) {
+        printf("  %-24s", metrica_nome(&s[0].cfg, m));
+        for (int k = 0; k < n; k++) printf(" %14.3f", metrica_valore(&s[k].esito, m));
+        printf("\n");
+    }
+    printf("  %-24s", "Durata (s)");
+    for (int k = 0; k < n; k++) printf(" %14.2f", s[k].secondi);
+    printf("\n");
+    if (explode) printf("  * terminato per Explode prima di SIM_DURATION\n");
+    printf("=========================\n");
+}
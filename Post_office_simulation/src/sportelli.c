@@ -0,0 +1,134 @@
+#include "common.h"
+#include "direttore.h"
+
+/*
+ * SPORTELLI.C (Assegnazione mattutina degli sportelli)
+ * * Ogni mattina, a ufficio chiuso, il Direttore decide quali sportelli aprire e per quale
+ * servizio. La politica si sceglie con ALLOC_POLICY nel .conf o --alloc da riga di comando:
+ * - casuale (0): modello originale, ogni sportello è aperto al 70% con un servizio a caso
+ * - carico  (1): stima la domanda di oggi per servizio dai dati di ieri e apre gli sportelli
+ *   che massimizzano i clienti serviti attesi
+ * * La usano entrambi i motori (main.c e des.c): legge e scrive solo campi della SHM
+ * Il report confronta le politiche con i "serviti per sportello aperto"
+ */
+
+// --- POLITICA CASUALE ---
+static void politica_casuale(SharedData *shm, Rng *rng) {
+    for(int i=0; i<shm->cfg.num_sportelli; i++) {
+        // 70% probabilità che uno sportello sia aperto
+        shm_sportello(shm, i)->servizio = rng_intero(rng, 100) < 70 ? rng_intero(rng, shm->cfg.num_servizi) : -1;
+    }
+}
+
+// --- POLITICA GUIDATA DAL CARICO ---
+// Stato tra una mattina e l'altra (un solo Direttore per processo, come in raccogli_giornata)
+// Globale perché il checkpoint lo salva e lo ripristina
+MemoriaSportelli memoria_sportelli;
+
+// Arrivi attesi a priori dal modello di arrivo (P_SERV medio, o intensità Poisson),
+// con il servizio scelto in modo uniforme (vedi entra_in_ufficio e popolazione.c)
+static double arrivi_a_priori(const Config *cfg) {
+    return arrivi_attesi(cfg) / cfg->num_servizi;
+}
+
+// Aggiorna la stima degli arrivi con quelli osservati ieri: serviti + crescita della coda
+// I servizi chiusi ieri non hanno ricevuto nessuno (gli utenti non si accodano): dato
+// censurato, per loro tengo la stima precedente
+static void aggiorna_stima(SharedData *shm) {
+    MemoriaSportelli *m = &memoria_sportelli;
+    if(!m->giorni_visti++) {
+        for(int s=0; s<shm->cfg.num_servizi; s++) m->arrivi_stimati[s] = arrivi_a_priori(&shm->cfg);
+        return;
+    }
+    for(int s=0; s<shm->cfg.num_servizi; s++) {
+        if(!((m->attivi_ieri >> s) & 1)) continue;
+        long osservati = shm->stats_giornaliere.servizi_erogati[s] + shm_servizio(shm, s)->in_attesa - m->coda_ieri[s];
+        if(osservati < 0) osservati = 0;
+        m->arrivi_stimati[s] = 0.5 * m->arrivi_stimati[s] + 0.5 * osservati; // Media mobile esponenziale
+    }
+}
+
+// Clienti che k sportelli del servizio s possono servire oggi, data la domanda
+// Oltre op (operatori in grado di erogarlo) gli sportelli in più restano vuoti
+static double serviti_attesi(double domanda, int k, int op, double capacita) {
+    if(k > op) k = op;
+    return domanda < k * capacita ? domanda : k * capacita;
+}
+
+// Greedy sul guadagno marginale: ogni sportello va al servizio che con uno sportello
+// in più serve più clienti attesi. serviti_attesi è concava in k, quindi il greedy
+// trova il massimo della somma. A parità di guadagno vince il servizio con più
+// lavoro arretrato in minuti (domanda x durata del servizio) per sportello
+static void politica_carico(SharedData *shm) {
+    const Config *cfg = &shm->cfg;
+    int n = cfg->num_servizi;
+    aggiorna_stima(shm);
+
+    // Domanda di oggi = arrivi attesi + chi è rimasto in coda da ieri
+    // Capacità di uno sportello = clienti per giornata al tempo medio di servizio
+    double domanda[MAX_SERVIZI], capacita[MAX_SERVIZI];
+    double minuti_giornata = cfg->minuti_giornata;
+    int op[MAX_SERVIZI] = {0}, k[MAX_SERVIZI] = {0};
+    for(int s=0; s<n; s++) {
+        domanda[s] = memoria_sportelli.arrivi_stimati[s] + shm_servizio(shm, s)->in_attesa;
+        capacita[s] = minuti_giornata / cfg->servizi[s].minuti;
+    }
+    // Competenze pubblicate dagli operatori prima del via (0 = non ancora note: tutte)
+    for(int i=0; i<cfg->nof_workers; i++) {
+        unsigned int c = shm->slot_operatori[i].competenze;
+        for(int s=0; s<n; s++) op[s] += !c || ((c >> s) & 1);
+    }
+
+    // Più sportelli che operatori non servono a nessuno
+    int da_aprire = cfg->nof_workers < cfg->num_sportelli ? cfg->nof_workers : cfg->num_sportelli;
+    int aperti = 0;
+    for(; aperti < da_aprire; aperti++) {
+        int migliore = -1;
+        double guadagno_max = 0, arretrato_max = 0;
+        for(int s=0; s<n; s++) {
+            double g = serviti_attesi(domanda[s], k[s] + 1, op[s], capacita[s])
+                     - serviti_attesi(domanda[s], k[s], op[s], capacita[s]);
+            double arretrato = domanda[s] * cfg->servizi[s].minuti / (k[s] + 1);
+            if(g > guadagno_max + 1e-9 || (migliore != -1 && g > guadagno_max - 1e-9 && arretrato > arretrato_max)) {
+                migliore = s;
+                guadagno_max = g;
+                arretrato_max = arretrato;
+            }
+        }
+        if(migliore == -1) break; // Domanda già coperta: gli altri restano chiusi
+        shm_sportello(shm, aperti)->servizio = migliore;
+        k[migliore]++;
+    }
+    for(int i=aperti; i<cfg->num_sportelli; i++) shm_sportello(shm, i)->servizio = -1;
+
+    for(int s=0; s<n; s++) memoria_sportelli.coda_ieri[s] = shm_servizio(shm, s)->in_attesa;
+}
+
+// Assegnazione mattutina dei servizi agli sportelli (chiamata a ufficio chiuso)
+// Pubblica anche la bitmask dei servizi attivi, letta senza mutex da Utenti e motore DES,
+// e ricostruisce le bitmask degli sportelli liberi di ogni servizio
+// Va chiamata prima di azzerare stats_giornaliere: la politica a carico legge quelle di ieri
+void assegna_sportelli(SharedData *shm, Rng *rng) {
+    if(shm->cfg.politica_sportelli == ALLOC_CARICO) politica_carico(shm);
+    else politica_casuale(shm, rng);
+
+    unsigned int attivi = 0;
+    unsigned long liberi[MAX_SERVIZI] = {0};
+    int aperti = 0;
+    for(int i=0; i<shm->cfg.num_sportelli; i++) {
+        Sportello *sp = shm_sportello(shm, i);
+        sp->occupato = 0; // Resetto occupazione fisica
+        sp->libero_da = 0; // Libero dall'apertura
+        sp->ns_libero = 0;
+        if(sp->servizio == -1) continue;
+        attivi |= 1u << sp->servizio;
+        liberi[sp->servizio] |= 1UL << i;
+        aperti++;
+    }
+    for(int s=0; s<shm->cfg.num_servizi; s++)
+        __atomic_store_n(&shm_servizio(shm, s)->sportelli_liberi, liberi[s], __ATOMIC_RELEASE);
+    shm->sportelli_aperti = aperti;
+    shm->sportelli_giorni += aperti;
+    memoria_sportelli.attivi_ieri = attivi;
+    __atomic_store_n(&shm->servizi_attivi, attivi, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include "common.h"
+#include "traccia.h"
+
+/*
+ * TRACCIA.C (Registratore della traccia binaria, lato Direttore)
+ * * Un thread del Direttore svuota periodicamente tutti i ring del segmento di traccia
+ * e scrive i record su file con fwrite bufferizzata: gli attori non fanno mai I/O
+ * * Il segmento viene rimosso (IPC_RMID) da traccia_termina, che la cleanup del Direttore
+ * richiama anche in caso di CTRL+C: non prima, perché l'attach per id a un segmento già
+ * marcato per la distruzione è un'estensione di Linux, e i figli si collegano dopo
+ */
+
+static int traccia_id = -1;
+static Traccia *traccia = NULL;
+static FILE *file_traccia = NULL;
+static pthread_t registratore;
+static int fine_registrazione = 0;  // Letto dal thread: load/store atomici
+static long record_scritti = 0;
+
+// Svuota tutti i ring una volta: ritorna il numero di record scritti
+static long svuota(void) {
+    long scritti = 0;
+    RecordTraccia r;
+    for (int i = 0; i < traccia->n_ring; i++) {
+        while (traccia_leggi(&traccia->ring[i], &r)) {
+            fwrite(&r, sizeof(r), 1, file_traccia);
+            scritti++;
+        }
+    }
+    return scritti;
+}
+
+static void *registra(void *arg) {
+    (void)arg;
+    struct timespec periodo = {0, 1000000L};
+    while (!__atomic_load_n(&fine_registrazione, __ATOMIC_ACQUIRE)) {
+        record_scritti += svuota();
+        nanosleep(&periodo, NULL);
+    }
+    return NULL;
+}
+
+Traccia *traccia_avvia(const char *file, const Config *cfg) {
+    int n_ring = 1 + cfg->nof_workers + RING_UTENTI;
+    size_t dim = traccia_dimensione(n_ring);
+
+    file_traccia = fopen(file, "wb");
+    if (!file_traccia) { perror("Apertura file di traccia"); return NULL; }
+
+    traccia_id = shmget(IPC_PRIVATE, dim, IPC_CREAT | 0600);
+    if (traccia_id < 0) { perror("shmget traccia"); fclose(file_traccia); return NULL; }
+    traccia = shmat(traccia_id, NULL, 0);
+    if (traccia == (void *)-1) {
+        perror("shmat traccia");
+        shmctl(traccia_id, IPC_RMID, NULL);
+        traccia = NULL; traccia_id = -1;
+        fclose(file_traccia);
+        return NULL;
+    }
+
+    // Sequenze iniziali dei ring (il segmento nuovo è già a zero)
+    traccia->n_ring = n_ring;
+    traccia->n_operatori = cfg->nof_workers;
+    for (int i = 0; i < n_ring; i++)
+        for (unsigned int k = 0; k < CAPIENZA_TRACCIA; k++) traccia->ring[i].slot[k].seq = k;
+
+    TestataTraccia h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TRACCIA_MAGIC, sizeof(h.magic));
+    h.dimensione_record = sizeof(RecordTraccia);
+    h.n_ring = n_ring;
+    h.cfg = *cfg;
+    fwrite(&h, sizeof(h), 1, file_traccia);
+
+    if (pthread_create(&registratore, NULL, registra, NULL) != 0) {
+        perror("pthread_create registratore"); exit(1);
+    }
+    return traccia;
+}
+
+const char *traccia_env(void) {
+    static char env[40];
+    if (traccia_id < 0) return NULL;
+    snprintf(env, sizeof(env), "%s=%d", ENV_TRACCIA, traccia_id);
+    return env;
+}
+
+void traccia_termina(void) {
+    if (!traccia) return;
+    __atomic_store_n(&fine_registrazione, 1, __ATOMIC_RELEASE);
+    pthread_join(registratore, NULL);
+    record_scritti += svuota(); // Quello che è arrivato dopo l'ultimo giro
+
+    long persi = 0;
+    for (int i = 0; i < traccia->n_ring; i++) persi += traccia->ring[i].persi;
+    printf("[Direttore] Traccia: %ld record scritti, %ld persi (ring pieni)\n", record_scritti, persi);
+
+    fclose(file_traccia);
+    shmdt(traccia);
+    shmctl(traccia_id, IPC_RMID, NULL);
+    traccia = NULL; traccia_id = -1;
+}
+
+void traccia_rimuovi(void) {
+    if (traccia_id != -1) shmctl(traccia_id, IPC_RMID, NULL);
+}
@@ -1,110 +1,240 @@
 #include "common.h"
+#include "agenti.h"
 
 /*
  * UTENTE.C (Il Cliente / Produttore di Lavoro)
  * * Implementazione Requisiti:
  * 1. Probabilità P_SERV personalizzata (passata via exec)
  * 2. Scelta casuale del servizio e dell'orario di arrivo
- * 3. Controllo disponibilità sportelli (Lettura protetta)
+ * 3. Controllo disponibilità sportelli (Lettura lock-free della bitmask dei servizi)
  * 4. Logica di "Abbandono": Se l'ufficio chiude e l'utente è ancora in coda,
  *   smette semplicemente di aspettare. Il conteggio dei "Non Erogati"
  *   è delegato al Direttore che legge la coda residua.
+ * * La vita dell'utente è scritta come macchina a stati (utente_passo):
+ * ogni passo fa il lavoro "istantaneo" e restituisce l'attesa successiva,
+ * così lo stesso codice gira sia come processo sia come task del pool di thread.
  */
 
-int main(int argc, char *argv[]) {
-    // Controllo argomenti (la probabilità P_SERV arriva dal main)
-    if(argc < 2) return 1;
-    int P_SERV = atoi(argv[1]); 
+// Ottiene il numero di ticket dalla via configurata e ne misura il costo
+static int prendi_ticket(Utente *u, int servizio) {
+    SharedData *shm = u->ag.shm;
+    int via = shm->cfg.modalita_ticket;
+    int numero_ticket;
 
-    // --- 1. ATTACH RISORSE IPC ---
-    int shm_id = shmget(KEY_SHM, sizeof(SharedData), 0666);
-    SharedData *shm = (SharedData *)shmat(shm_id, NULL, 0);
-    int sem_id = semget(KEY_SEM, 0, 0666);
-    int msg_id = msgget(KEY_MSG, 0666);
-
-    // Seed random unico per processo (PID * Time) per evitare che
-    // tutti gli utenti facciano le stesse scelte nello stesso istante
-    srand(getpid() * time(NULL)); 
-    
-    // --- 2. SINCRONIZZAZIONE START (Pattern Turnstile) ---
-    // Aspetto il via del Direttore e sblocco subito il prossimo utente
-    P(sem_id, SEM_START); 
-    V(sem_id, SEM_START); 
-
-    while (!shm->stop_simulation) {
-        
-        // Stabilisce un orario -> Simulo ritardo arrivo random
-        usleep((rand() % 30) * shm->cfg.nano_secs_per_min / 1000);
-
-        // "Decide se recarsi... secondo probabilità"
-        int r = rand() % 100;
-        
-        // Controllo anche che l'ufficio non abbia chiuso durante il mio "viaggio" (sleep)
-        if (r < P_SERV && shm->ufficio_aperto) {
-            
-            // "Stabilisce il servizio"
-            int servizio = rand() % NUM_SERVICES; 
-            
-            // --- CHECK DISPONIBILITÀ (Lettore) ---
-            // Verifico se OGGI quel servizio è attivo
-            // Uso il MUTEX in lettura per evitare Race Conditions se il Direttore 
-            // sta ancora configurando gli sportelli
-            int servizio_disponibile = 0;
-            P(sem_id, SEM_MUTEX);
-            for(int i=0; i<MAX_SPORTELLI; i++) {
-                if(shm->sportelli_mapping[i] == servizio) { 
-                    servizio_disponibile = 1; 
-                    break; 
-                }
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    if (via == TICKET_SHM) {
+        // Via lock-free: una sola istruzione atomica, nessuna system call
+        numero_ticket = __atomic_add_fetch(&shm->prossimo_ticket, 1, __ATOMIC_RELAXED);
+    } else {
+        // Richiesta sincrona via Message Queue
+        // Il canale di risposta è il mio TID: coincide col PID se sono un processo,
+        // ed è comunque unico se sono un task eseguito da un thread del pool
+        pid_t canale = gettid();
+        MsgTicket m = {1, canale, servizio, 0};
+        msg_invia(u->ag.msg_id, &m, sizeof(MsgTicket)-sizeof(long), 0);
+
+        // Attendo risposta sul mio canale privato (mtype = mio TID)
+        msg_ricevi(u->ag.msg_id, &m, sizeof(MsgTicket)-sizeof(long), canale, 0);
+        numero_ticket = m.numero_ticket;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    long elapsed = (t_end.tv_sec - t_start.tv_sec)*1000000000L + (t_end.tv_nsec - t_start.tv_nsec);
+    __atomic_fetch_add(&shm->ticket_emessi[via], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shm->ticket_ns[via], elapsed, __ATOMIC_RELAXED);
+    traccia_scrivi(u->ag.traccia, TR_TICKET, gettid(), servizio, -1, numero_ticket, elapsed);
+
+    return numero_ticket;
+}
+
+// "Decide se recarsi... secondo probabilità" e, se entra, prende il ticket e si mette in coda
+static void entra_in_ufficio(Utente *u) {
+    SharedData *shm = u->ag.shm;
+
+    int r = rng_intero(&u->ag.rng, 100);
+
+    // Controllo anche che l'ufficio non abbia chiuso durante il mio "viaggio" (sleep)
+    if (r < u->p_serv && shm->ufficio_aperto) {
+
+        // "Stabilisce il servizio"
+        int servizio = rng_intero(&u->ag.rng, shm->cfg.num_servizi);
+
+        // --- CHECK DISPONIBILITÀ (Lettore) ---
+        // Verifico se OGGI quel servizio è attivo
+        // Niente MUTEX: il Direttore pubblica la bitmask dei servizi prima di aprire,
+        // quindi se vedo l'ufficio aperto vedo anche la configurazione completa
+        if(servizio_attivo(shm, servizio)) {
+            // --- FASE 1: PRENDERE IL TICKET ---
+            int numero_ticket = prendi_ticket(u, servizio);
+
+            // --- FASE 2: IN CODA (Ruolo: Produttore) ---
+
+            // Aggiorno contatore visuale (Shared Memory, incremento atomico)
+            ServizioCondiviso *sv = shm_servizio(shm, servizio);
+            __atomic_fetch_add(&sv->in_attesa, 1, __ATOMIC_RELAXED);
+
+            // Deposito il ticket nella coda del servizio (lock-free)
+            // Se la coda è piena rinuncio: conta come servizio non erogato
+            if (!coda_push(&sv->coda, numero_ticket, adesso_ns())) {
+                __atomic_fetch_sub(&sv->in_attesa, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&shm->utenti_respinti, 1, __ATOMIC_RELAXED);
+                traccia_scrivi(u->ag.traccia, TR_RESPINTO, gettid(), servizio, -1, numero_ticket, 0);
+                return;
             }
-            V(sem_id, SEM_MUTEX);
-
-            if(servizio_disponibile) {
-                // --- FASE 1: PRENDERE IL TICKET ---
-                // Richiesta sincrona via Message Queue
-                MsgTicket m = {1, getpid(), servizio, 0};
-                msgsnd(msg_id, &m, sizeof(MsgTicket)-sizeof(long), 0);
-                
-                // Attendo risposta sul mio canale privato (mtype = mio PID)
-                msgrcv(msg_id, &m, sizeof(MsgTicket)-sizeof(long), getpid(), 0);
-
-                // --- FASE 2: IN CODA (Ruolo: Produttore) ---
-                
-                // Aggiorno contatore visuale (Shared Memory)
-                P(sem_id, SEM_MUTEX);
-                shm->utenti_in_attesa[servizio]++;
-                V(sem_id, SEM_MUTEX);
-
-                // Segnalo all'Operatore che c'è lavoro
-                // Faccio V() (Signal) perché sto "producendo" un cliente in coda
-                // L'operatore farà P() (Wait) per servirmi
-                V(sem_id, SEM_QUEUE_BASE + servizio);
-
-                // N.B.:
-                // A questo punto sono logicamente in coda. Non mi blocco su un semaforo
-                // (perché non ho un canale di ritorno 1-a-1 per la fine servizio),
-                // ma entro nel loop di attesa passiva qui sotto
+            traccia_scrivi(u->ag.traccia, TR_ACCODA, gettid(), servizio, -1, numero_ticket, 0);
+
+            // Segnalo all'Operatore che c'è lavoro
+            // Faccio V() (Signal) perché sto "producendo" un cliente in coda
+            // L'operatore farà P() (Wait) per servirmi
+            V(u->ag.sem_id, SEM_QUEUE_BASE + servizio);
+
+            // N.B.:
+            // A questo punto sono logicamente in coda. Non mi blocco su un semaforo
+            // (perché non ho un canale di ritorno 1-a-1 per la fine servizio),
+            // ma passo alla fase di attesa passiva
+        }
+    }
+}
+
+void utente_prepara(Utente *u, int indice) {
+    u->ag.indice = indice;
+    rng_init(&u->ag.rng, u->ag.shm->cfg.seme, FLUSSO_UTENTE(indice));
+    u->p_serv = p_serv_casuale(&u->ag.shm->cfg, &u->ag.rng);
+    if (u->ag.shm->giorno_ripresa)
+        rng_init(&u->ag.rng, u->ag.shm->cfg.seme, FLUSSO_RIPRESA(FLUSSO_UTENTE(indice), u->ag.shm->giorno_ripresa));
+    u->fase = UT_FASE_AVVIO;
+}
+
+long utente_passo(Utente *u) {
+    SharedData *shm = u->ag.shm;
+    if (shm->stop_simulation) return UT_FINE;
+
+    switch (u->fase) {
+        case UT_FASE_AVVIO:
+            // --- SINCRONIZZAZIONE START (Pattern Turnstile) ---
+            // Aspetto il via del Direttore e sblocco subito il prossimo utente
+            P(u->ag.sem_id, SEM_START);
+            V(u->ag.sem_id, SEM_START);
+            /* fall through */
+
+        case UT_FASE_A_CASA: {
+            // Stabilisce un orario -> Simulo ritardo arrivo random
+            // L'orario è assoluto e contato dall'apertura di oggi: il ritardo con cui mi sono
+            // svegliato non lo sposta (a ufficio ancora chiuso conto da adesso)
+            u->fase = UT_FASE_ARRIVO;
+            long base = __atomic_load_n(&shm->ufficio_aperto, __ATOMIC_ACQUIRE) ? shm->apertura_ns : adesso_ns();
+            return base + rng_intero(&u->ag.rng, 30) * (long)shm->cfg.nano_secs_per_min;
+        }
+
+        case UT_FASE_ARRIVO:
+            entra_in_ufficio(u);
+
+            // --- ATTESA PASSIVA & ABBANDONO ---
+            // Finché l'ufficio è aperto, aspetto (simulo di essere in fila o servito)
+            u->fase = UT_FASE_IN_UFFICIO;
+            return UT_ATTENDI_CHIUSURA;
+
+        default:
+            // L'ufficio ha chiuso
+            // Se ero in coda e non sono stato servito, il contatore `in_attesa`
+            // non è stato decrementato dall'operatore
+            // Io "abbandono" semplicemente tornando a casa
+            // Il Direttore conterà i residui come "Servizi Non Erogati"
+            // Aspetto a casa che l'ufficio riapra il giorno dopo
+            u->fase = UT_FASE_A_CASA;
+            return UT_ATTENDI_APERTURA;
+    }
+}
+
+#ifndef SENZA_MAIN
+// Vita del processo utente dopo l'attach: esegue le attese richieste dalla macchina a stati
+static int vivi(Utente *u) {
+    SharedData *shm = u->ag.shm;
+    profilo_usa(PR_UTENTE, getpid());
+
+    unsigned int scenario = shm->scenario;
+
+    // Sono collegato a tutto: lo comunico al Direttore (barriera di prontezza)
+    segnala_pronto(shm);
+
+    for (;;) {
+        // Con --scenarios gli utenti oltre NOF_USERS dello scenario restano a casa (tutti,
+        // se lo scenario genera gli arrivi dalla popolazione del Direttore)
+        while (u->ag.indice < utenti_agenti(&shm->cfg)) {
+            long attesa = utente_passo(u);
+            if (attesa == UT_FINE) break;
+
+            // Eseguo l'attesa richiesta: sleep fino alla scadenza oppure attesa passiva (futex)
+            // di un cambio di stato dell'ufficio, senza nessun risveglio a vuoto
+            if (attesa >= 0) {
+                long richiesto = attesa - adesso_ns();
+                deriva_registra_condivisa(&shm->deriva_utenti, richiesto, dormi_fino(attesa));
             }
+            else attendi_stato(shm, attesa == UT_ATTENDI_APERTURA);
         }
-        
-        // --- ATTESA PASSIVA & ABBANDONO ---
-        // Qui gestisco sia l'attesa del servizio sia l'eventuale abbandono
-        
-        // 1. Finché l'ufficio è aperto, aspetto (simulo di essere in fila o servito)
-        //    Uso polling lento (0.1s) per non sprecare CPU
-        while(shm->ufficio_aperto && !shm->stop_simulation) usleep(100000); 
-        
-        // 2. L'ufficio ha chiuso
-        //    Se ero in coda e non sono stato servito, il contatore `utenti_in_attesa`
-        //    non è stato decrementato dall'operatore
-        //    Io "abbandono" semplicemente uscendo da questo loop e tornando a casa
-        //    Il Direttore conterà i residui come "Servizi Non Erogati"
-        
-        // 3. Aspetto a casa che l'ufficio riapra il giorno dopo
-        while(!shm->ufficio_aperto && !shm->stop_simulation) usleep(100000); 
+        if (u->ag.indice >= utenti_agenti(&shm->cfg)) attendi_fine(shm);
 
+        // Fine della simulazione, oppure nuova identità (SEED e P_SERV) per il prossimo scenario
+        if (!attendi_scenario(shm, &scenario)) break;
+        utente_prepara(u, u->ag.indice);
+        segnala_pronto(shm);
     }
-    
+
     shmdt(shm); // Stacco la memoria condivisa
     return 0;
-}
\ No newline at end of file
+}
+
+// Zygote: un solo exec e un solo attach, poi fork() degli utenti primo..primo+n-1 già collegati
+// Il figlio eredita il mapping della SHM e gli id IPC: niente exec, niente linker dinamico
+static int zygote(Utente *modello, Traccia *traccia, int primo, int n) {
+    SharedData *shm = modello->ag.shm;
+
+    for (int i = 0; i < n; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            Utente u = *modello;
+            utente_prepara(&u, primo + i);
+            u.ag.traccia = traccia_ring_utente(traccia, getpid());
+            return vivi(&u);
+        }
+        // Esco subito: il Direttore vede morire lo zygote e interrompe l'avvio
+        if (pid < 0) { perror("fork utente"); return 1; }
+    }
+
+    // Resto in vita come padre dei miei utenti (se vengo ucciso li adotta il Direttore)
+    while (wait(NULL) > 0);
+    shmdt(shm);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Controllo argomenti: l'indice dell'utente (identifica il suo flusso casuale),
+    // oppure "--zygote=PRIMO:N" per generare per fork gli utenti PRIMO..PRIMO+N-1
+    if(argc < 2) return 1;
+    int primo = 0, n_zygote = 0;
+    if (!strncmp(argv[1], "--zygote=", 9) && sscanf(argv[1] + 9, "%d:%d", &primo, &n_zygote) != 2) return 1;
+
+    Utente u;
+
+    // --- 1. ATTACH RISORSE IPC ---
+    // Id delle risorse dal Direttore (namespace IPC della sua esecuzione)
+    int shm_id;
+    if (ipc_ids(&shm_id, &u.ag.sem_id, &u.ag.msg_id) < 0) return 1;
+    u.ag.shm = (SharedData *)shmat(shm_id, NULL, 0);
+    if (u.ag.shm == (void *)-1) return 1; // Il Direttore se ne accorge (figlio morto prima del via)
+    ipc_contatore = &u.ag.shm->contesa.operazioni_ipc; // Ereditato dagli utenti dello zygote
+
+    Traccia *traccia = traccia_attach(&u.ag.shm->cfg);
+    profilo_attach(); // Solo in make profilo; anche questo lo ereditano gli utenti dello zygote
+    timer_preciso(); // Prima delle fork: gli utenti dello zygote lo ereditano
+    if (n_zygote) return zygote(&u, traccia, primo, n_zygote);
+
+    // Flusso casuale e P_SERV dall'indice: stesso SEED = stesse scelte, qualunque sia il PID
+    utente_prepara(&u, atoi(argv[1]));
+    u.ag.traccia = traccia_ring_utente(traccia, getpid());
+
+    return vivi(&u);
+}
+#endif